@@ -0,0 +1,61 @@
+// 无界面客户端：标准输入的每一行作为聊天消息发送，收到的消息打印到标准输出
+#ifdef _WIN32
+#include <winsock2.h>
+#endif
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include "chat_client.h"
+
+int main(int argc, char **argv) {
+    // 用法：chat_bot [地址|unix:路径] [端口] [昵称]
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        std::cerr << "WSAStartup failed" << std::endl;
+        return 1;
+    }
+#endif
+    std::string addr = argc >= 2 ? argv[1] : "127.0.0.1";
+    std::string port = argc >= 3 ? argv[2] : "5000";
+    std::string nick = argc >= 4 ? argv[3] : "Bot";
+
+    ChatClientNetwork client;
+    client.setDeliverCallback(
+        [](const std::vector<ChatClientNetwork::Message>& batch) {
+            // 每批一次写出
+            std::string out;
+            for (const auto& m : batch) {
+                out += ChatClientNetwork::format(m);
+                out += '\n';
+            }
+            std::fwrite(out.data(), 1, out.size(), stdout);
+            std::fflush(stdout);
+        });
+    if (!client.connectTo(addr, port, nick)) return 1;
+
+    // "/search 关键词" 检索聊天历史，"/trace on|off" 切换时延追踪，
+    // "/receipts on|off" 切换消息回执（含送达）
+    const std::string kSearchCmd = "/search ";
+    std::string line;
+    while (client.isConnected() && std::getline(std::cin, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        if (line.compare(0, kSearchCmd.size(), kSearchCmd) == 0) {
+            client.sendSearch(line.substr(kSearchCmd.size()));
+        } else if (line == "/trace on" || line == "/trace off") {
+            client.setTracing(line == "/trace on");
+        } else if (line == "/receipts on" || line == "/receipts off") {
+            client.setReceipts(line == "/receipts on", true);
+        } else {
+            client.sendText(line);
+        }
+    }
+    client.disconnect();
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return 0;
+}
@@ -1,25 +1,30 @@
 #include "chat_client.h"
 
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
+
+#include <algorithm>
+#include <random>
+
 using namespace chatproto;
 
 /**
  * 向服务端发起连接请求
- * @param addrW 服务器地址（UTF-16）
- * @param portW 服务器端口（UTF-16）
- * @param nickW 昵称（UTF-16）
+ * @param addrIn 服务器地址（UTF-8）
+ * @param portIn 服务器端口（UTF-8）
+ * @param nickIn 昵称（UTF-8）
  * @return 连接是否成功
  * @note 首先清理旧连接，然后解析地址并尝试连接，连接成功后发送 HELLO
- * 消息，启用recive线程
+ * 消息，启用收发线程
  */
-bool ChatClientNetwork::connectTo(const std::wstring& addrW,
-                                  const std::wstring& portW,
-                                  const std::wstring& nickW) {
+bool ChatClientNetwork::connectTo(const std::string& addrIn,
+                                  const std::string& portIn,
+                                  const std::string& nickIn) {
     if (connected_.load()) return true;  // 已连接则直接返回 true
 
-    // 若上一次是被动断开，接收线程可能已退出但仍处于 joinable 状态；先回收
-    if (recvThread_.joinable()) {
-        recvThread_.join();
-    }
+    // 若上一次是被动断开，收发线程可能已退出但仍处于 joinable 状态；先回收
+    joinThreads();
     // 清理残留的旧 socket（若有）
     if (sock_ != INVALID_SOCKET) {
         shutdown(sock_, SD_BOTH);
@@ -27,15 +32,65 @@ bool ChatClientNetwork::connectTo(const std::wstring& addrW,
         sock_ = INVALID_SOCKET;
     }
 
-    std::wstring waddr = addrW.empty() ? L"127.0.0.1" : addrW;
-    std::wstring wport = portW.empty() ? L"5000" : portW;
-    std::wstring wnick = nickW.empty() ? L"User" : nickW;
+    std::string addr = addrIn.empty() ? "127.0.0.1" : addrIn;
+    std::string port = portIn.empty() ? "5000" : portIn;
+    nicknameUtf8_ = nickIn.empty() ? "User" : nickIn;
+
+    SOCKET s = INVALID_SOCKET;
+    const std::string kUnixPrefix = "unix:";
+    if (addr.compare(0, kUnixPrefix.size(), kUnixPrefix) == 0) {
+        // "unix:路径"：同机连接 Unix 域套接字，帧协议与 TCP 相同
+        s = connectUnix(addr.substr(kUnixPrefix.size()));
+    } else {
+        s = connectTcp(addr, port);
+    }
+
+    if (s == INVALID_SOCKET) {
+        // 如果到最后还是INVALID_SOCKET 说明链接失败
+        deliverNow(Message::FAILURE, "无法连接服务器");
+        return false;
+    }
+
+    // 发送 HELLO 消息（此时写线程尚未启动，直接发送）
+    if (!sendFrame(s, MsgType::HELLO, nicknameUtf8_)) {
+        // 如果发送失败，关闭套接字并返回
+        closesocket(s);
+        deliverNow(Message::FAILURE, "发送 HELLO 失败");
+        return false;
+    }
+    // 恢复回执设置：服务端的消息编号按连接从 1 开始
+    uint8_t flags = receiptFlags_.load();
+    if (flags != 0 &&
+        !sendFrame(s, MsgType::RECEIPTS, std::string(1, static_cast<char>(flags)))) {
+        closesocket(s);
+        deliverNow(Message::FAILURE, "发送回执设置失败");
+        return false;
+    }
 
-    // 转换为 UTF-8
-    std::string addr = utf16_to_utf8(waddr);
-    std::string port = utf16_to_utf8(wport);
-    nicknameUtf8_ = utf16_to_utf8(wnick);
+    // 连接成功
+    sock_ = s;
+    sendq_.reset();
+    nextStreamId_.store(1);
+    sentMessages_.store(0);
+    seq_.reset();  // 新连接重新建立基准，离线期间的消息由邮箱补齐
+    connected_.store(true);
+    disconnecting_.store(false);
+    recvDone_ = false;
+    deliverNow(Message::SYSTEM, "已连接");  // 提示已连接
+    notifyState(true);                       // 状态通知
+    sendThread_ = std::thread(&ChatClientNetwork::writerLoop, this);
+    recvThread_ = std::thread(&ChatClientNetwork::receiverLoop, this);
+    return true;
+}
 
+/**
+ * 解析地址并建立 TCP 连接
+ * @param addr 服务器地址（UTF-8）
+ * @param port 服务器端口（UTF-8）
+ * @return 已连接的套接字，失败返回 INVALID_SOCKET
+ */
+SOCKET ChatClientNetwork::connectTcp(const std::string& addr,
+                                     const std::string& port) {
     // 解析地址
     addrinfo hints{};
     hints.ai_family = AF_INET;
@@ -45,8 +100,8 @@ bool ChatClientNetwork::connectTo(const std::wstring& addrW,
     // 获取地址信息
     addrinfo* res = nullptr;
     if (getaddrinfo(addr.c_str(), port.c_str(), &hints, &res) != 0) {
-        append(L"[错误] 解析地址失败\r\n");
-        return false;
+        deliverNow(Message::FAILURE, "解析地址失败");
+        return INVALID_SOCKET;
     }
 
     // 连接到服务器
@@ -64,29 +119,27 @@ bool ChatClientNetwork::connectTo(const std::wstring& addrW,
     }
     // 释放getaddrinfo分配的内存
     freeaddrinfo(res);
+    return s;
+}
 
-    if (s == INVALID_SOCKET) {
-        // 如果到最后还是INVALID_SOCKET 说明链接失败
-        append(L"[错误] 无法连接服务器\r\n");
-        return false;
-    }
-
-    // 发送 HELLO 消息
-    if (!sendFrame(s, MsgType::HELLO, nicknameUtf8_)) {
-        // 如果发送失败，关闭套接字并返回
+/**
+ * 连接 Unix 域套接字
+ * @param path 套接字文件路径（UTF-8）
+ * @return 已连接的套接字，失败返回 INVALID_SOCKET
+ */
+SOCKET ChatClientNetwork::connectUnix(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path))
+        return INVALID_SOCKET;
+    std::memcpy(addr.sun_path, path.c_str(), path.size());
+    SOCKET s = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s == INVALID_SOCKET) return INVALID_SOCKET;
+    if (connect(s, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
         closesocket(s);
-        append(L"[错误] 发送 HELLO 失败\r\n");
-        return false;
+        return INVALID_SOCKET;
     }
-
-    // 连接成功
-    sock_ = s;
-    connected_.store(true);
-    disconnecting_.store(false);
-    append(L"[系统] 已连接\r\n");  // 提示已连接
-    notifyState(true);             // 状态通知
-    recvThread_ = std::thread(&ChatClientNetwork::receiverLoop, this);
-    return true;
+    return s;
 }
 
 /**
@@ -98,9 +151,23 @@ void ChatClientNetwork::disconnect() {
     disconnecting_.store(true);
 
     bool wasConnected = connected_.exchange(false);  // 获取并清除连接状态
+    if (wasConnected) {
+        // 仍处于连接：BYE 排在已入队的帧之后（忽略失败），写线程发完后退出
+        send(MsgType::BYE, nicknameUtf8_);
+    }
+    sendq_.close();
+    if (sendThread_.joinable()) {
+        sendThread_.join();
+    }
     if (wasConnected && sock_ != INVALID_SOCKET) {
-        // 仍处于连接：尝试发送 BYE（忽略失败）再关闭
-        sendFrame(sock_, MsgType::BYE, nicknameUtf8_);
+        // 半关闭后等待服务端读完并关闭连接：接收缓冲中仍有未读数据时直接
+        // 关闭会发出 RST，服务端尚未读取的消息（包括 BYE）随之丢失
+        shutdown(sock_, SD_SEND);
+        std::unique_lock<std::mutex> lock(recvDoneMtx_);
+        recvDoneCv_.wait_for(lock, std::chrono::milliseconds(kCloseTimeoutMs),
+                             [this] { return recvDone_; });
+    }
+    if (sock_ != INVALID_SOCKET) {
         shutdown(sock_, SD_BOTH);
         closesocket(sock_);
         sock_ = INVALID_SOCKET;
@@ -110,74 +177,593 @@ void ChatClientNetwork::disconnect() {
     if (recvThread_.joinable()) {
         recvThread_.join();
     }
+    stopMulticast();
 
     disconnecting_.store(false);
     notifyState(false);  // 状态通知幂等
 }
 
+void ChatClientNetwork::joinThreads() {
+    sendq_.close();
+    if (sendThread_.joinable()) sendThread_.join();
+    if (recvThread_.joinable()) recvThread_.join();
+    stopMulticast();
+}
+
 /**
  * 发送聊天文本
- * @param textW 聊天文本（UTF-16）
+ * @param text 聊天文本（UTF-8）
+ */
+bool ChatClientNetwork::sendText(const std::string& text) {
+    if (!connected_.load()) return false;
+    bool ok;
+    if (tracing_.load()) {
+        std::string payload;
+        payload.reserve(8 + text.size());
+        putU64(payload, traceNowUs());
+        payload += text;
+        ok = send(MsgType::CHAT_TRACED, payload);
+    } else {
+        ok = send(MsgType::CHAT, text);
+    }
+    if (ok) sentMessages_.fetch_add(1);
+    return ok;
+}
+
+/**
+ * 开启或关闭消息回执
+ * @param on 是否开启
+ * @param deliveries 是否同时报告送达（仅 on 时有效）
+ * @note 此前发出的消息不再确认；未连接时只记录设置，连接后生效
+ */
+void ChatClientNetwork::setReceipts(bool on, bool deliveries) {
+    uint8_t flags = 0;
+    if (on) flags = RECEIPTS_ON | (deliveries ? RECEIPTS_DELIVERIES : 0);
+    receiptFlags_.store(flags);
+    if (connected_.load())
+        send(MsgType::RECEIPTS, std::string(1, static_cast<char>(flags)));
+}
+
+/**
+ * 发送检索请求
+ * @param query 查询文本（UTF-8）
  */
-bool ChatClientNetwork::sendText(const std::wstring& textW) {
+bool ChatClientNetwork::sendSearch(const std::string& query) {
     if (!connected_.load()) return false;
-    std::string utf8 = utf16_to_utf8(textW);
-    return sendFrame(sock_, MsgType::CHAT, utf8);
+    return send(MsgType::SEARCH, query);
+}
+
+/**
+ * 分片发送大数据块
+ * @param name 名称（UTF-8），例如文件名
+ * @param data 数据指针
+ * @param len 数据长度
+ * @note 分片逐个入队；积压超过 kStreamHighWater 时等待写线程发送，
+ * 其他线程的聊天消息可在分片之间插入
+ */
+bool ChatClientNetwork::sendStream(const std::string& name, const char* data,
+                                   size_t len) {
+    if (!connected_.load()) return false;
+    uint32_t id = nextStreamId_.fetch_add(1);
+    std::string begin;
+    putU32(begin, id);
+    putU64(begin, len);
+    begin += name;
+    if (!send(MsgType::STREAM_BEGIN, begin)) return false;
+    std::string chunk;
+    for (size_t off = 0; off < len; off += STREAM_CHUNK_SIZE) {
+        if (!sendq_.waitBelow(kStreamHighWater)) return false;
+        size_t n = std::min<size_t>(STREAM_CHUNK_SIZE, len - off);
+        chunk.clear();
+        putU32(chunk, id);
+        chunk.append(data + off, n);
+        if (!send(MsgType::STREAM_CHUNK, chunk)) return false;
+    }
+    std::string end;
+    putU32(end, id);
+    end.push_back(0);  // 完成
+    return send(MsgType::STREAM_END, end);
+}
+
+/**
+ * 编码一帧并放入发送队列
+ * @param type 消息类型
+ * @param payload 负载
+ * @return 负载过长或队列已关闭（连接断开）时返回 false
+ */
+bool ChatClientNetwork::send(MsgType type, const std::string& payload) {
+    if (payload.size() > MAX_PAYLOAD) return false;
+    return sendq_.push(encodeFrame(type, payload));
+}
+
+/**
+ * 写线程：取出队列中的全部帧，合并为一次发送
+ */
+void ChatClientNetwork::writerLoop() {
+    std::string out;
+    while (sendq_.popAll(out)) {
+        bool ok = sendAll(sock_, out.data(), static_cast<int>(out.size()));
+        sendq_.release(out.size());
+        out.clear();
+        if (!ok) break;  // 连接已断开，由接收线程提示
+    }
+    sendq_.close();  // 之后的发送立即失败，sendStream 不再等待
 }
 
 /**
  *  接收消息线程，循环接收新的消息
- *  @note 根据消息类型调用不同的回调函数处理
+ *  @note 每次 recv 读取尽可能多的字节并解析出所有完整帧，本次产生的消息
+ *  通过一次 deliver_ 回调交付
  */
 void ChatClientNetwork::receiverLoop() {
-    while (true) {
-        MsgType t;
-        std::string p;
-        // 接收消息失败则退出循环，一般是连接断开
-        if (!recvFrame(sock_, t, p)) break;
-        switch (t) {
-            case MsgType::USER_JOIN: {
-                std::wstring msg = L"[加入] ";
-                msg += utf8_to_utf16(p);
-                msg += L"\r\n";
-                append(msg);
-                break;
-            }
-            case MsgType::USER_LEAVE: {
-                std::wstring msg = L"[离开] ";
-                msg += utf8_to_utf16(p);
-                msg += L"\r\n";
-                append(msg);
-                break;
-            }
-            case MsgType::SERVER_BROADCAST: {
-                size_t pos = p.find('\n');
-                std::string from =
-                    pos == std::string::npos ? std::string() : p.substr(0, pos);
-                std::string text =
-                    pos == std::string::npos ? p : p.substr(pos + 1);
-                std::wstring line = L"<" + utf8_to_utf16(from) + L"> " +
-                                    utf8_to_utf16(text) + L"\r\n";
-                append(line);
+    std::vector<char> buf(kRecvBufferSize);
+    size_t have = 0;  // 缓冲中尚未解析的字节
+    std::string payload;
+    bool ok = true;
+    while (ok) {
+        int n = recv(sock_, buf.data() + have,
+                     static_cast<int>(buf.size() - have), 0);
+        // 接收失败则退出循环，一般是连接断开
+        if (n == SOCKET_ERROR || n == 0) break;
+        have += static_cast<size_t>(n);
+
+        std::lock_guard<std::mutex> lock(deliverMtx_);
+        size_t pos = 0;
+        while (have - pos >= 5) {
+            uint32_t len = getU32(buf.data() + pos + 1);
+            if (len > MAX_PAYLOAD) {
+                ok = false;  // 非法帧：按断开处理
                 break;
             }
-            default:
-                break;
+            if (have - pos - 5 < len) break;  // 帧不完整，等待更多数据
+            auto t = static_cast<MsgType>(static_cast<uint8_t>(buf[pos]));
+            payload.assign(buf.data() + pos + 5, len);
+            dispatch(t, payload);
+            pos += 5 + len;
+        }
+        // 不完整的尾部移到缓冲开头
+        if (pos > 0) {
+            std::memmove(buf.data(), buf.data() + pos, have - pos);
+            have -= pos;
+        }
+        if (mcastRunning_.load()) sendNacks();
+        if (!batch_.empty()) {
+            if (deliver_) deliver_(batch_);
+            batch_.clear();
         }
     }
 
+    stopMulticast();
+    sendq_.close();  // 写线程随之退出
+    {
+        std::lock_guard<std::mutex> lock(recvDoneMtx_);
+        recvDone_ = true;
+    }
+    recvDoneCv_.notify_all();
     // 断开连接：若是被动断开，更新连接状态并提示
     if (!disconnecting_.load()) {
         connected_.store(false);
         notifyState(false);
-        append(L"[系统] 已断开连接\r\n");
+        deliverNow(Message::SYSTEM, "已断开连接");
+    }
+}
+
+/**
+ * 按消息类型解析一帧
+ * @param t 消息类型
+ * @param p 负载
+ */
+void ChatClientNetwork::dispatch(MsgType t, const std::string& p) {
+    switch (t) {
+        case MsgType::USER_JOIN:
+            batch_.push_back({Message::JOIN, p, std::string()});
+            break;
+        case MsgType::USER_LEAVE:
+            batch_.push_back({Message::LEAVE, p, std::string()});
+            break;
+        case MsgType::SERVER_BROADCAST:
+        case MsgType::SERVER_BROADCAST_TRACED:
+            sequence(t, p, false);
+            break;
+        case MsgType::SEARCH_RESULT:
+            dispatchSearch(p);
+            break;
+        case MsgType::SERVER_STREAM_BEGIN:
+        case MsgType::SERVER_STREAM_CHUNK:
+        case MsgType::SERVER_STREAM_END:
+            dispatchStream(t, p);
+            break;
+        case MsgType::MAILBOX:
+            dispatchMailbox(p);
+            break;
+        case MsgType::RECEIPT:
+            dispatchReceipt(p);
+            break;
+        case MsgType::MULTICAST_GROUP:
+            startMulticast(p);
+            break;
+        case MsgType::MULTICAST_START:
+            if (p.size() < 8) break;
+            seq_.start(getU64(p.data()), items_);
+            render();
+            break;
+        case MsgType::REPAIR_LOST:
+            if (p.size() < 12) break;
+            seq_.lost(getU64(p.data()), getU32(p.data() + 8), items_);
+            render();
+            break;
+        case MsgType::REFUSED:
+            batch_.push_back({Message::FAILURE, std::string(),
+                              "服务器拒绝连接：" + p});
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * 解析检索结果：先给出条数，再逐条给出结果
+ * @param p 负载：记录之间以 '\0' 分隔，每条为 from + '\n' + text
+ */
+void ChatClientNetwork::dispatchSearch(const std::string& p) {
+    size_t header = batch_.size();
+    batch_.push_back({Message::SEARCH, std::string(), std::string()});
+    size_t count = 0;
+    for (size_t start = 0; start < p.size(); ++count) {
+        size_t end = std::min(p.find('\0', start), p.size());
+        std::string rec = p.substr(start, end - start);
+        size_t nl = rec.find('\n');
+        std::string from =
+            nl == std::string::npos ? std::string() : rec.substr(0, nl);
+        std::string text = nl == std::string::npos ? rec : rec.substr(nl + 1);
+        batch_.push_back(
+            {Message::SEARCH_HIT, std::move(from), std::move(text)});
+        start = end + 1;
+    }
+    batch_[header].text = "共 " + std::to_string(count) + " 条结果";
+}
+
+/**
+ * 解析服务端转发的流帧并回调；开始与结束同时作为提示消息交付
+ * @param t 消息类型
+ * @param p 负载
+ */
+void ChatClientNetwork::dispatchStream(MsgType t, const std::string& p) {
+    if (p.size() < 4) return;
+    StreamEvent ev{};
+    ev.id = getU32(p.data());
+    if (t == MsgType::SERVER_STREAM_BEGIN) {
+        if (p.size() < 12) return;
+        ev.kind = StreamEvent::BEGIN;
+        ev.total = getU64(p.data() + 4);
+        size_t nl = p.find('\n', 12);
+        if (nl == std::string::npos) nl = p.size();
+        ev.from = p.substr(12, nl - 12);
+        if (nl < p.size()) ev.name = p.substr(nl + 1);
+        batch_.push_back({Message::STREAM, ev.from,
+                          "<" + ev.from + "> 正在发送 " + ev.name + "（" +
+                              std::to_string(ev.total) + " 字节）"});
+    } else if (t == MsgType::SERVER_STREAM_CHUNK) {
+        ev.kind = StreamEvent::CHUNK;
+        ev.data = p.data() + 4;
+        ev.size = p.size() - 4;
+    } else {
+        ev.kind = StreamEvent::END;
+        ev.ok = p.size() < 5 || p[4] == 0;
+        batch_.push_back({Message::STREAM, std::string(),
+                          ev.ok ? "接收完成" : "发送方中止"});
+    }
+    if (stream_) stream_(ev);
+}
+
+/**
+ * 解析离线邮箱帧：负载内为若干完整的 SERVER_BROADCAST 帧
+ * @param p 负载（首字节非零表示最后一批）
+ */
+void ChatClientNetwork::dispatchMailbox(const std::string& p) {
+    if (p.empty()) return;
+    for (size_t pos = 1; pos + 5 <= p.size();) {
+        size_t len = getU32(p.data() + pos + 1);
+        if (pos + 5 + len > p.size()) break;
+        auto type = static_cast<MsgType>(static_cast<uint8_t>(p[pos]));
+        // 离线消息早于本连接的实时消息，不参与序号检查；追踪时间戳已无意义
+        size_t skip = SEQ_HEADER_SIZE;
+        if (type == MsgType::SERVER_BROADCAST_TRACED) skip += TRACE_HEADER_SIZE;
+        if ((type == MsgType::SERVER_BROADCAST ||
+             type == MsgType::SERVER_BROADCAST_TRACED) &&
+            len >= skip) {
+            std::string rec = p.substr(pos + 5 + skip, len - skip);
+            size_t nl = rec.find('\n');
+            std::string from =
+                nl == std::string::npos ? std::string() : rec.substr(0, nl);
+            std::string text =
+                nl == std::string::npos ? rec : rec.substr(nl + 1);
+            batch_.push_back(
+                {Message::OFFLINE, std::move(from), std::move(text)});
+            ++mailboxCount_;
+        }
+        pos += 5 + len;
+    }
+    if (p[0] != 0) {
+        batch_.push_back({Message::SYSTEM, std::string(),
+                          "以上为离线期间的 " +
+                              std::to_string(mailboxCount_) + " 条消息"});
+        mailboxCount_ = 0;
+    }
+}
+
+/**
+ * 解析普通聊天广播
+ * @param p 负载：[8 房间序号][from + '\n' + text]
+ */
+void ChatClientNetwork::dispatchChat(const std::string& p) {
+    size_t pos = p.find('\n', SEQ_HEADER_SIZE);
+    std::string from = pos == std::string::npos
+                           ? std::string()
+                           : p.substr(SEQ_HEADER_SIZE, pos - SEQ_HEADER_SIZE);
+    std::string text = pos == std::string::npos ? p.substr(SEQ_HEADER_SIZE)
+                                                : p.substr(pos + 1);
+    batch_.push_back({Message::CHAT, std::move(from), std::move(text)});
+}
+
+/**
+ * 解析追踪广播：按普通聊天交付，并给出各阶段耗时
+ * @param p 负载：[8 房间序号][32 时间戳头][from + '\n' + text]
+ */
+void ChatClientNetwork::dispatchTraced(const std::string& p) {
+    uint64_t now = traceNowUs();
+    if (p.size() < SEQ_HEADER_SIZE + TRACE_HEADER_SIZE) return;
+    const char* h = p.data() + SEQ_HEADER_SIZE;
+    TraceSample s{};
+    s.clientSendUs = getU64(h);
+    s.serverRecvUs = getU64(h + 8);
+    s.serverEnqueueUs = getU64(h + 16);
+    s.serverWriteUs = getU64(h + 24);
+    s.clientRecvUs = now;
+    std::string rec = p.substr(SEQ_HEADER_SIZE + TRACE_HEADER_SIZE);
+    size_t nl = rec.find('\n');
+    s.from = nl == std::string::npos ? std::string() : rec.substr(0, nl);
+    std::string text = nl == std::string::npos ? rec : rec.substr(nl + 1);
+    batch_.push_back({Message::CHAT, s.from, std::move(text)});
+    if (trace_) {
+        trace_(s);
+        return;
     }
+    // 跨机时上行/下行含时钟偏差，可能为负
+    auto us = [](uint64_t from, uint64_t to) {
+        return std::to_string(static_cast<int64_t>(to - from));
+    };
+    batch_.push_back(
+        {Message::TRACE, std::string(),
+         "上行 " + us(s.clientSendUs, s.serverRecvUs) + " us，服务端处理 " +
+             us(s.serverRecvUs, s.serverEnqueueUs) + " us，排队 " +
+             us(s.serverEnqueueUs, s.serverWriteUs) + " us，下行 " +
+             us(s.serverWriteUs, s.clientRecvUs) + " us，共 " +
+             us(s.clientSendUs, s.clientRecvUs) + " us"});
+}
+
+/**
+ * 按房间序号整理一条聊天广播，按序放出的部分追加到 batch_
+ * @param t SERVER_BROADCAST 或 SERVER_BROADCAST_TRACED
+ * @param p 负载（含房间序号）
+ * @param viaMulticast 是否来自组播数据报
+ * @note 调用方持有 deliverMtx_
+ */
+void ChatClientNetwork::sequence(MsgType t, std::string p, bool viaMulticast) {
+    size_t need = SEQ_HEADER_SIZE;
+    if (t == MsgType::SERVER_BROADCAST_TRACED) need += TRACE_HEADER_SIZE;
+    if (p.size() < need) return;
+    uint64_t seq = getU64(p.data());
+    seq_.push(seq, t, std::move(p), viaMulticast, items_);
+    render();
 }
 
 /**
- * 调用回调函数显示消息
- * @param w 消息内容（UTF-16）
+ * 把按序放出的项转换为消息：聊天帧照常解析，缺失段给出一行提示
  */
-void ChatClientNetwork::append(const std::wstring& w) {
-    if (append_) append_(w);
+void ChatClientNetwork::render() {
+    for (auto& it : items_) {
+        if (it.missing != 0) {
+            batch_.push_back(
+                {Message::SYSTEM, std::string(),
+                 "缺失 " + std::to_string(it.missing) + " 条消息（序号 " +
+                     std::to_string(it.first) + " - " +
+                     std::to_string(it.first + it.missing - 1) + "）"});
+        } else if (it.type == MsgType::SERVER_BROADCAST_TRACED) {
+            dispatchTraced(it.payload);
+        } else {
+            dispatchChat(it.payload);
+        }
+    }
+    items_.clear();
+}
+
+/**
+ * 对组播中发现的缺口经 TCP 请求补发
+ * @note 调用方持有 deliverMtx_
+ */
+void ChatClientNetwork::sendNacks() {
+    uint64_t nowMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                         std::chrono::steady_clock::now().time_since_epoch())
+                         .count();
+    seq_.nacks(nowMs, kNackRetryMs, nacks_);
+    for (const auto& r : nacks_) {
+        std::string p;
+        putU64(p, r.first);
+        putU32(p, r.second);
+        send(MsgType::NACK, p);
+    }
+    nacks_.clear();
+}
+
+/**
+ * 加入服务端给出的组播组，成功后通知服务端改经组播发送聊天广播
+ * @param p 负载：[4 实例号][2 端口][组地址]
+ * @note 在 TCP 连接的本地地址所在的接口上加入；失败时继续经 TCP 接收
+ */
+void ChatClientNetwork::startMulticast(const std::string& p) {
+    if (!allowMulticast_.load() || mcastRunning_.load() || p.size() < 7)
+        return;
+    uint32_t instance = getU32(p.data());
+    uint16_t port = static_cast<uint16_t>(
+        (static_cast<uint8_t>(p[4]) << 8) | static_cast<uint8_t>(p[5]));
+    std::string group = p.substr(6);
+
+    ip_mreq mreq{};
+    if (inet_pton(AF_INET, group.c_str(), &mreq.imr_multiaddr) != 1) return;
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    sockaddr_in local{};
+    socklen_t localLen = sizeof(local);
+    if (getsockname(sock_, reinterpret_cast<sockaddr*>(&local), &localLen) ==
+            0 &&
+        local.sin_family == AF_INET)
+        mreq.imr_interface = local.sin_addr;
+
+    SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == INVALID_SOCKET) return;
+    int reuse = 1;
+    int rcvbuf = 1024 * 1024;  // 突发时缓冲更多数据报，减少补发
+#ifdef _WIN32
+    DWORD timeout = kMulticastPollMs;
+#else
+    timeval timeout{0, kMulticastPollMs * 1000};
+#endif
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    // 同机的多个客户端共用端口，各自收到一份
+    bool ok =
+        setsockopt(s, SOL_SOCKET, SO_REUSEADDR,
+                   reinterpret_cast<const char*>(&reuse), sizeof(reuse)) == 0 &&
+        bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 &&
+        setsockopt(s, IPPROTO_IP, IP_ADD_MEMBERSHIP,
+                   reinterpret_cast<const char*>(&mreq), sizeof(mreq)) == 0 &&
+        setsockopt(s, SOL_SOCKET, SO_RCVTIMEO,
+                   reinterpret_cast<const char*>(&timeout),
+                   sizeof(timeout)) == 0;
+    if (!ok) {
+        closesocket(s);
+        batch_.push_back({Message::SYSTEM, std::string(),
+                          "无法加入组播组 " + group + "，继续经 TCP 接收"});
+        return;
+    }
+    setsockopt(s, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&rcvbuf),
+               sizeof(rcvbuf));
+    mcastSock_ = s;
+    mcastInstance_ = instance;
+    mcastRunning_.store(true);
+    mcastThread_ = std::thread(&ChatClientNetwork::multicastLoop, this);
+    send(MsgType::MULTICAST_ON, std::string());
+    batch_.push_back({Message::SYSTEM, std::string(),
+                      "已加入组播组 " + group + ":" + std::to_string(port)});
+}
+
+/**
+ * 停止组播线程并退出组播组（关闭套接字即退出）
+ * @note 不能持有 deliverMtx_ 调用
+ */
+void ChatClientNetwork::stopMulticast() {
+    mcastRunning_.store(false);
+    if (mcastThread_.joinable()) mcastThread_.join();
+    if (mcastSock_ != INVALID_SOCKET) {
+        closesocket(mcastSock_);
+        mcastSock_ = INVALID_SOCKET;
+    }
+}
+
+/**
+ * 组播线程：接收数据报并按序交付；接收超时也检查缺口，按间隔重发补发请求
+ */
+void ChatClientNetwork::multicastLoop() {
+    std::vector<char> buf(64 * 1024);
+    std::minstd_rand drop(std::random_device{}());
+    while (mcastRunning_.load()) {
+        int n = recv(mcastSock_, buf.data(), static_cast<int>(buf.size()), 0);
+        unsigned permille = mcastDropPermille_.load();
+        if (n > 0 && permille > 0 && drop() % 1000 < permille) n = 0;
+        std::lock_guard<std::mutex> lock(deliverMtx_);
+        if (n > 0) onDatagram(buf.data(), static_cast<size_t>(n));
+        sendNacks();
+        if (!batch_.empty()) {
+            if (deliver_) deliver_(batch_);
+            batch_.clear();
+        }
+    }
+}
+
+/**
+ * 解析一个组播数据报
+ * @param d 数据报：[4 实例号][8 房间序号][完整的广播帧（可能省略）]
+ * @param n 长度
+ * @note 调用方持有 deliverMtx_；只有序号的数据报（心跳或超长帧）只记录序号
+ */
+void ChatClientNetwork::onDatagram(const char* d, size_t n) {
+    if (n < 12 || getU32(d) != mcastInstance_) return;
+    uint64_t seq = getU64(d + 4);
+    if (n >= 12 + 5 + SEQ_HEADER_SIZE) {
+        auto t = static_cast<MsgType>(static_cast<uint8_t>(d[12]));
+        uint32_t len = getU32(d + 13);
+        if ((t == MsgType::SERVER_BROADCAST ||
+             t == MsgType::SERVER_BROADCAST_TRACED) &&
+            len == n - 12 - 5 && getU64(d + 17) == seq) {
+            sequence(t, std::string(d + 17, len), true);
+            return;
+        }
+    }
+    seq_.exists(seq);
+}
+
+/**
+ * 解析累积回执：有回调时交给回调，否则显示一行进度
+ * @param p 负载：[8 已受理][8 已送达][4 已送达消息的接收者数]
+ */
+void ChatClientNetwork::dispatchReceipt(const std::string& p) {
+    if (p.size() < 20) return;
+    Receipt r{getU64(p.data()), getU64(p.data() + 8), getU32(p.data() + 16)};
+    if (receipt_) {
+        receipt_(r);
+        return;
+    }
+    std::string text = "已受理 " + std::to_string(r.accepted) + "/" +
+                       std::to_string(sentMessages_.load());
+    if (receiptFlags_.load() & RECEIPTS_DELIVERIES) {
+        text += "，已送达 " + std::to_string(r.delivered) + "（" +
+                std::to_string(r.recipients) + " 人）";
+    }
+    batch_.push_back({Message::RECEIPT, std::string(), std::move(text)});
+}
+
+/**
+ * 立即交付一条提示消息（单独成批）
+ * @param kind 消息类型
+ * @param text 提示文本（UTF-8）
+ */
+void ChatClientNetwork::deliverNow(Message::Kind kind, std::string text) {
+    if (!deliver_) return;
+    std::vector<Message> one;
+    one.push_back({kind, std::string(), std::move(text)});
+    deliver_(one);
+}
+
+/**
+ * 生成消息在界面上显示的一行
+ * @param m 消息
+ * @return UTF-8 文本，不含换行
+ */
+std::string ChatClientNetwork::format(const Message& m) {
+    switch (m.kind) {
+        case Message::SYSTEM: return "[系统] " + m.text;
+        case Message::FAILURE: return "[错误] " + m.text;
+        case Message::JOIN: return "[加入] " + m.from;
+        case Message::LEAVE: return "[离开] " + m.from;
+        case Message::CHAT: return "<" + m.from + "> " + m.text;
+        case Message::OFFLINE: return "[离线] <" + m.from + "> " + m.text;
+        case Message::SEARCH: return "[检索] " + m.text;
+        case Message::SEARCH_HIT: return "  <" + m.from + "> " + m.text;
+        case Message::STREAM: return "[文件] " + m.text;
+        case Message::TRACE: return "[追踪] " + m.text;
+        case Message::RECEIPT: return "[回执] " + m.text;
+    }
+    return m.text;
 }
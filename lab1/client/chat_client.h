@@ -1,48 +1,203 @@
 #pragma once
 
+#ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
+// AF_UNIX 支持（Windows 10 1803+）
+#include <afunix.h>
+#else
+#include <sys/un.h>
+#endif
 
 #include <atomic>
+#include <condition_variable>
 #include <functional>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "common/protocol.h"
+#include "room_sequencer.h"
+#include "send_queue.h"
 
 /**
  * 客户端网络类，管理与聊天服务器的连接和通信
+ * - 不依赖 Win32 界面，接口均为 UTF-8，Windows 与 POSIX 共用
+ * - 发送：帧编码后放入无锁队列立即返回，由写线程合并发送
+ * - 接收：每次唤醒读取尽可能多的字节，解析出的所有消息通过一次回调交付
+ * - 服务端启用组播时加入组播组，聊天广播改由组播线程接收，缺号经 TCP 补发
  */
 class ChatClientNetwork {
    public:
-    using AppendFn = std::function<void(const std::wstring&)>;
+    // 收到的一条消息（UTF-8）；format 给出界面上显示的一行
+    struct Message {
+        enum Kind {
+            SYSTEM,      // 系统提示：text
+            FAILURE,     // 错误提示：text
+            JOIN,        // 用户加入：from
+            LEAVE,       // 用户离开：from
+            CHAT,        // 聊天消息：from + text
+            OFFLINE,     // 离线期间的聊天消息：from + text
+            SEARCH,      // 检索结果汇总：text
+            SEARCH_HIT,  // 一条检索结果：from + text
+            STREAM,      // 流（文件）提示：text
+            TRACE,       // 追踪耗时分解：text
+            RECEIPT,     // 消息回执：text
+        } kind;
+        std::string from;
+        std::string text;
+    };
+    // 一次交付一批消息（在接收线程或组播线程上调用，不会并发；
+    // 回调返回后 batch 即失效）
+    using DeliverFn = std::function<void(const std::vector<Message>& batch)>;
     using StateFn = std::function<void(bool connected)>;
 
+    // 流事件：接收方按分片增量处理，无需缓存整个数据块
+    struct StreamEvent {
+        enum Kind { BEGIN, CHUNK, END } kind;
+        uint32_t id;           // 服务端流编号
+        uint64_t total;        // 总长度（仅 BEGIN）
+        std::string from;      // 发送者昵称（仅 BEGIN，UTF-8）
+        std::string name;      // 名称（仅 BEGIN，UTF-8）
+        const char* data;      // 分片数据（仅 CHUNK）
+        size_t size;           // 分片长度（仅 CHUNK）
+        bool ok;               // 是否完整结束（仅 END）
+    };
+    using StreamFn = std::function<void(const StreamEvent&)>;
+
+    // 追踪样本：一条 CHAT_TRACED 消息在各阶段的时间戳（traceNowUs，微秒）
+    struct TraceSample {
+        std::string from;          // 发送者昵称（UTF-8）
+        uint64_t clientSendUs;     // 发送方 sendText
+        uint64_t serverRecvUs;     // 服务端收到
+        uint64_t serverEnqueueUs;  // 服务端放入发送队列
+        uint64_t serverWriteUs;    // 服务端写线程写出
+        uint64_t clientRecvUs;     // 本端收到
+    };
+    using TraceFn = std::function<void(const TraceSample&)>;
+
+    // 累积回执：本连接发出的第 1..N 条聊天消息均已受理/送达
+    struct Receipt {
+        uint64_t accepted;    // 已放入所有在线接收者的发送队列
+        uint64_t delivered;   // 已由服务端写出（未请求送达时为 0）
+        uint32_t recipients;  // 编号为 delivered 的消息的接收者数
+    };
+    using ReceiptFn = std::function<void(const Receipt&)>;
+
     ChatClientNetwork() = default;
     ~ChatClientNetwork() { disconnect(); }  // 确保析构时断开连接
 
-    void setAppendCallback(AppendFn fn) { append_ = std::move(fn); }
+    void setDeliverCallback(DeliverFn fn) { deliver_ = std::move(fn); }
     void setStateCallback(StateFn fn) { state_ = std::move(fn); }
+    void setStreamCallback(StreamFn fn) { stream_ = std::move(fn); }
+    // 设置后追踪样本交给回调，否则以一行文本显示各阶段耗时
+    void setTraceCallback(TraceFn fn) { trace_ = std::move(fn); }
+    // 开启后 sendText 发送 CHAT_TRACED
+    void setTracing(bool on) { tracing_.store(on); }
+    bool tracing() const { return tracing_.load(); }
+    // 设置后回执交给回调，否则以一行文本显示
+    void setReceiptCallback(ReceiptFn fn) { receipt_ = std::move(fn); }
+    // 开启/关闭消息回执；重连后自动恢复。deliveries 表示同时报告送达
+    void setReceipts(bool on, bool deliveries);
+    // 本连接已发送的聊天消息数，即最新消息的编号
+    uint64_t sentMessages() const { return sentMessages_.load(); }
+    // 房间序号：最近按序交付的序号、检测到的缺失条数、丢弃的重复条数
+    uint64_t lastSeq() const { return seq_.lastSeq(); }
+    uint64_t missedMessages() const { return seq_.missed(); }
+    uint64_t duplicateMessages() const { return seq_.duplicates(); }
+    // 是否接受服务端的组播分发（默认接受），下次连接时生效
+    void setMulticast(bool allow) { allowMulticast_.store(allow); }
+    bool multicastActive() const { return mcastRunning_.load(); }
+    // 测试用：按千分比随机丢弃收到的组播数据报，用于验证缺号补发
+    void setMulticastDrop(unsigned permille) { mcastDropPermille_.store(permille); }
 
-    bool connectTo(const std::wstring& addrW, const std::wstring& portW,
-                   const std::wstring& nickW);
+    // 地址为 "unix:路径" 时连接 Unix 域套接字；参数均为 UTF-8
+    bool connectTo(const std::string& addr, const std::string& port,
+                   const std::string& nick);
     void disconnect();
-    bool sendText(const std::wstring& textW);
+    // 以下发送接口只编码入队，不等待网络，可在任意线程调用
+    bool sendText(const std::string& text);
+    bool sendSearch(const std::string& query);  // 检索聊天历史
+    // 分片发送大数据块；积压过多时等待写线程，期间聊天消息可以插入
+    bool sendStream(const std::string& name, const char* data, size_t len);
     bool isConnected() const { return connected_.load(); }
 
+    // 消息在界面上显示的一行（UTF-8，不含换行）
+    static std::string format(const Message& m);
+
    private:
+    SOCKET connectTcp(const std::string& addr, const std::string& port);
+    SOCKET connectUnix(const std::string& path);
     void receiverLoop();
-    void append(const std::wstring& w);
+    void writerLoop();
+    void joinThreads();
+    // 解析一帧，产生的消息追加到 batch_
+    void dispatch(chatproto::MsgType t, const std::string& p);
+    void dispatchStream(chatproto::MsgType t, const std::string& p);
+    void dispatchSearch(const std::string& p);
+    void dispatchMailbox(const std::string& p);  // 离线期间的消息
+    void dispatchTraced(const std::string& p);   // 追踪消息与耗时分解
+    void dispatchReceipt(const std::string& p);  // 累积回执
+    void dispatchChat(const std::string& p);     // 普通聊天广播
+    // 聊天广播按房间序号整理后交付；viaMulticast 表示来自组播数据报
+    void sequence(chatproto::MsgType t, std::string p, bool viaMulticast);
+    void render();  // 按序放出的项追加到 batch_
+    void sendNacks();
+    // 组播：加入服务端给出的组并启动组播线程
+    void startMulticast(const std::string& p);
+    void stopMulticast();
+    void multicastLoop();
+    void onDatagram(const char* d, size_t n);
+    bool send(chatproto::MsgType type, const std::string& payload);
+    // 在当前线程上立即交付一条消息（连接与断开的提示）
+    void deliverNow(Message::Kind kind, std::string text);
     void notifyState(bool connected) {
         if (state_) state_(connected);
     }
 
    private:
+    // 接收缓冲：至少容纳两个最大帧，解析后把不完整的尾部移到开头
+    static constexpr size_t kRecvBufferSize = 4 * (chatproto::MAX_PAYLOAD + 5);
+    // sendStream 的背压水位：队列积压超过此值时等待写线程
+    static constexpr size_t kStreamHighWater = 1024 * 1024;
+    // 主动断开时等待服务端关闭连接的时限（毫秒），之后强制关闭
+    static constexpr int kCloseTimeoutMs = 2000;
+    // 组播线程的接收超时（毫秒）：据此检查退出标志并重发补发请求
+    static constexpr int kMulticastPollMs = 20;
+    // 同一缺口重复请求补发的间隔（毫秒）
+    static constexpr uint64_t kNackRetryMs = 100;
+
     SOCKET sock_{INVALID_SOCKET};
     std::thread recvThread_;                  // 接收消息线程
+    std::thread sendThread_;                  // 写线程：合并发送队列中的帧
+    SendQueue sendq_;                         // 待发送的已编码帧
     std::atomic<bool> connected_{false};      // 连接状态
     std::atomic<bool> disconnecting_{false};  // 正在断开连接
+    std::atomic<bool> tracing_{false};        // 发送时附带追踪时间戳
+    std::atomic<uint8_t> receiptFlags_{0};    // RECEIPTS 标志，0 表示未开启
+    std::atomic<uint64_t> sentMessages_{0};   // 本连接已发送的聊天消息数
+    std::atomic<bool> allowMulticast_{true};  // 接受组播分发
+    std::atomic<unsigned> mcastDropPermille_{0};  // 组播数据报丢弃千分比
+    std::mutex recvDoneMtx_;
+    std::condition_variable recvDoneCv_;
+    bool recvDone_{false};                    // 接收线程已退出循环
     std::string nicknameUtf8_;                // 用户昵称（UTF-8 编码）
-    AppendFn append_;  // 用于显示消息的回调函数
-    StateFn state_;    // 连接状态变化回调
+    std::atomic<uint32_t> nextStreamId_{1};   // 本连接内的流编号
+    // 接收线程与组播线程各自解析时持有：保护以下成员并串行化交付
+    std::mutex deliverMtx_;
+    size_t mailboxCount_{0};      // 已显示的离线消息数
+    std::vector<Message> batch_;  // 本次唤醒解析出的消息
+    RoomSequencer seq_;           // 聊天广播的排序与去重
+    std::vector<RoomSequencer::Item> items_;     // 按序放出的项
+    std::vector<RoomSequencer::Range> nacks_;    // 待请求补发的缺口
+    SOCKET mcastSock_{INVALID_SOCKET};           // 组播接收套接字
+    std::thread mcastThread_;                    // 组播线程
+    std::atomic<bool> mcastRunning_{false};      // 组播线程运行中
+    uint32_t mcastInstance_{0};  // 服务端组播实例号，其他实例的数据报忽略
+    DeliverFn deliver_;  // 批量交付收到的消息
+    StateFn state_;      // 连接状态变化回调
+    StreamFn stream_;    // 流事件回调
+    TraceFn trace_;      // 追踪样本回调
+    ReceiptFn receipt_;  // 回执回调
 };
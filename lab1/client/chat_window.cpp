@@ -130,12 +130,11 @@ LRESULT ChatWindow::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
                 hInput_, GWLP_WNDPROC, (LONG_PTR)ChatWindow::InputProcThunk);
             SetPropW(hInput_, L"ChatWindowThis", this);
 
-            // 设置回调函数 ，没有有变化的时候在这里运行
-            client_.setAppendCallback([this](const std::wstring& w) {
-                auto p = new std::wstring(w);
-                // 消息类型为 WM_CHAT_APPEND，参数为动态分配的字符串指针
-                PostMessageW(hwnd_, WM_CHAT_APPEND, 0, (LPARAM)p);
-            });
+            // 收到消息的回调：每批消息转换一次编码，合并后通知 UI 线程
+            client_.setDeliverCallback(
+                [this](const std::vector<ChatClientNetwork::Message>& batch) {
+                    onDeliver(batch);
+                });
             // 连接状态变化回调
             client_.setStateCallback([this](bool connected) {
                 PostMessageW(hwnd_, WM_CONN_STATE, (WPARAM)(connected ? 1 : 0),
@@ -179,12 +178,14 @@ LRESULT ChatWindow::WndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
             break;
         }
         case WM_CHAT_APPEND: {
-            // 追加聊天内容消息处理
-            std::wstring* p = reinterpret_cast<std::wstring*>(lParam);
-            if (p) {
-                appendText(*p);
-                delete p;
+            // 追加聊天内容消息处理：取走此前累积的全部文本
+            {
+                std::lock_guard<std::mutex> lock(pendingMtx_);
+                shown_.swap(pending_);
+                appendPosted_ = false;
             }
+            if (!shown_.empty()) appendText(shown_);
+            shown_.clear();
             return 0;
         }
         case WM_CONN_STATE: {
@@ -244,6 +245,34 @@ void ChatWindow::appendText(const std::wstring& text) {
     SendMessageW(hChat_, EM_SCROLLCARET, 0, 0);  // 滚动到光标位置
 }
 
+/**
+ * 接收线程交付的一批消息
+ * @param batch 消息（UTF-8）
+ * @note 整批拼接后一次转换为 UTF-16，直接写入 pending_ 的尾部
+ */
+void ChatWindow::onDeliver(
+    const std::vector<ChatClientNetwork::Message>& batch) {
+    std::string utf8;
+    for (const auto& m : batch) {
+        utf8 += ChatClientNetwork::format(m);
+        utf8 += "\r\n";
+    }
+    int n = MultiByteToWideChar(CP_UTF8, 0, utf8.data(), (int)utf8.size(),
+                                nullptr, 0);
+    if (n <= 0) return;
+    bool post = false;
+    {
+        std::lock_guard<std::mutex> lock(pendingMtx_);
+        size_t old = pending_.size();
+        pending_.resize(old + n);
+        MultiByteToWideChar(CP_UTF8, 0, utf8.data(), (int)utf8.size(),
+                            &pending_[old], n);
+        post = !appendPosted_;
+        appendPosted_ = true;
+    }
+    if (post) PostMessageW(hwnd_, WM_CHAT_APPEND, 0, 0);
+}
+
 /**
  * 发送按钮处理
  */
@@ -260,7 +289,28 @@ void ChatWindow::onSend() {
     std::wstring text = buffer;
     // 清空输入框并发送消息
     SetWindowTextW(hInput_, L"");
-    client_.sendText(text);
+    // "/search 关键词" 检索聊天历史，其余作为聊天消息发送
+    const std::wstring kSearchCmd = L"/search ";
+    if (text.compare(0, kSearchCmd.size(), kSearchCmd) == 0) {
+        client_.sendSearch(utf16_to_utf8(text.substr(kSearchCmd.size())));
+        return;
+    }
+    // "/trace on|off" 切换时延追踪，之后发送的消息附带各阶段时间戳
+    if (text == L"/trace on" || text == L"/trace off") {
+        client_.setTracing(text == L"/trace on");
+        appendText(client_.tracing() ? L"[系统] 已开启时延追踪\r\n"
+                                     : L"[系统] 已关闭时延追踪\r\n");
+        return;
+    }
+    // "/receipts on|off" 切换消息回执（含送达），之后发送的消息会被确认
+    if (text == L"/receipts on" || text == L"/receipts off") {
+        bool on = text == L"/receipts on";
+        client_.setReceipts(on, true);
+        appendText(on ? L"[系统] 已开启消息回执\r\n"
+                      : L"[系统] 已关闭消息回执\r\n");
+        return;
+    }
+    client_.sendText(utf16_to_utf8(text));
 }
 
 /**
@@ -275,7 +325,8 @@ void ChatWindow::onConnectToggle() {
         GetWindowTextW(hPort_, portW, 16);
         wchar_t nickW[64];
         GetWindowTextW(hNick_, nickW, 64);
-        if (client_.connectTo(addrW, portW, nickW)) {
+        if (client_.connectTo(utf16_to_utf8(addrW), utf16_to_utf8(portW),
+                              utf16_to_utf8(nickW))) {
             // 连接成功，更新按钮文本
             updateUiForConnected(true);
         }
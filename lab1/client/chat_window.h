@@ -2,7 +2,9 @@
 
 #include <windows.h>
 
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "chat_client.h"
 
@@ -20,6 +22,8 @@ class ChatWindow {
     LRESULT InputProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
     void appendText(const std::wstring& text);
+    // 接收线程：把一批消息转为 UTF-16 追加到待显示缓冲
+    void onDeliver(const std::vector<ChatClientNetwork::Message>& batch);
     void onSend();
     void onConnectToggle();
     void updateUiForConnected(bool connected);
@@ -37,6 +41,13 @@ class ChatWindow {
     WNDPROC oldInputProc_{};  // 原始输入框窗口过程
 
     ChatClientNetwork client_{};  // 聊天客户端
+
+    // 待显示的文本：接收线程追加，UI 线程整体取走；已投递 WM_CHAT_APPEND
+    // 且尚未处理时不再重复投递，高消息率下每次界面刷新只处理一次
+    std::mutex pendingMtx_;
+    std::wstring pending_;
+    bool appendPosted_{false};
+    std::wstring shown_;  // UI 线程复用的缓冲
 };
 
 // 聊天历史
@@ -54,7 +65,7 @@ class ChatWindow {
 // 连接按钮
 #define IDC_CONNECT 1007
 
-// 消息：追加聊天内容
+// 消息：追加聊天内容（内容在 ChatWindow::pending_ 中）
 #define WM_CHAT_APPEND (WM_APP + 1)
 // 消息：连接状态变化（wParam: 1=连接，0=断开）
 #define WM_CONN_STATE (WM_APP + 2)
@@ -0,0 +1,130 @@
+// 组播分发检验：若干接收者加入组播组并随机丢弃数据报，另一连接经 TCP 连续发送编号消息，
+// 检查每个接收者是否经 NACK 补发按序收齐全部消息。服务端须以组播参数启动，
+// 本机测试时发送接口填 127.0.0.1（如 239.255.10.1:5001@127.0.0.1）
+#ifdef _WIN32
+#include <winsock2.h>
+#endif
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "chat_client.h"
+
+namespace {
+
+// 一个接收者按序核对收到的编号
+struct Receiver {
+    ChatClientNetwork client;
+    uint64_t next = 0;       // 期望的下一个编号
+    uint64_t disorder = 0;   // 编号不连续的次数
+};
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    // 用法：chat_mcast [地址] [端口] [消息数] [丢弃千分比] [接收者数] [消息字节数]
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        std::cerr << "WSAStartup failed" << std::endl;
+        return 1;
+    }
+#endif
+    std::string addr = argc >= 2 ? argv[1] : "127.0.0.1";
+    std::string port = argc >= 3 ? argv[2] : "5000";
+    uint64_t count = argc >= 4 ? std::strtoull(argv[3], nullptr, 10) : 10000;
+    unsigned drop = argc >= 5 ? std::atoi(argv[4]) : 50;
+    int receivers = argc >= 6 ? std::atoi(argv[5]) : 4;
+    size_t size = argc >= 7 ? std::strtoul(argv[6], nullptr, 10) : 0;
+    if (receivers <= 0) receivers = 1;
+    const std::string sender = "mcsend";
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<std::unique_ptr<Receiver>> rs;
+    for (int i = 0; i < receivers; ++i) {
+        rs.push_back(std::make_unique<Receiver>());
+        Receiver *r = rs.back().get();
+        r->client.setMulticastDrop(drop);
+        r->client.setDeliverCallback(
+            [&, r](const std::vector<ChatClientNetwork::Message> &batch) {
+                std::lock_guard<std::mutex> lock(mtx);
+                for (const auto &m : batch) {
+                    if (m.kind != ChatClientNetwork::Message::CHAT ||
+                        m.from != sender)
+                        continue;
+                    uint64_t n = std::strtoull(m.text.c_str(), nullptr, 10);
+                    if (n != r->next) ++r->disorder;
+                    r->next = n + 1;
+                }
+                cv.notify_all();
+            });
+        if (!r->client.connectTo(addr, port, "mc" + std::to_string(i)))
+            return 1;
+    }
+
+    // 等待所有接收者切换到组播
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    for (auto &r : rs) {
+        while (!r->client.multicastActive() &&
+               std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        if (!r->client.multicastActive()) {
+            std::cerr << "multicast not active (server started without a "
+                         "multicast group?)" << std::endl;
+            return 1;
+        }
+    }
+
+    ChatClientNetwork tx;
+    tx.setMulticast(false);
+    if (!tx.connectTo(addr, port, sender)) return 1;
+    auto start = std::chrono::steady_clock::now();
+    // 编号后补足到 size 字节；超过 1400 字节的广播只经组播发送序号，全部经 TCP 补发
+    for (uint64_t i = 0; i < count && tx.isConnected(); ++i) {
+        std::string text = std::to_string(i);
+        if (text.size() < size) text.resize(size, ' ');
+        tx.sendText(text);
+    }
+
+    // 最后几条的丢失要等心跳数据报发现，留出足够的补发时间
+    bool done;
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        done = cv.wait_for(lock, std::chrono::seconds(30), [&] {
+            for (const auto &r : rs)
+                if (r->next < count) return false;
+            return true;
+        });
+    }
+    double secs = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start).count();
+    tx.disconnect();
+
+    bool ok = done;
+    for (size_t i = 0; i < rs.size(); ++i) {
+        Receiver &r = *rs[i];
+        r.client.disconnect();
+        std::printf("mc%zu: received %llu/%llu, disorder %llu, lost %llu, "
+                    "duplicates %llu\n",
+                    i, (unsigned long long)r.next, (unsigned long long)count,
+                    (unsigned long long)r.disorder,
+                    (unsigned long long)r.client.missedMessages(),
+                    (unsigned long long)r.client.duplicateMessages());
+        if (r.disorder != 0 || r.client.missedMessages() != 0) ok = false;
+    }
+    std::printf("%s: %llu messages, drop %u/1000, %.2f s\n",
+                ok ? "PASS" : "FAIL", (unsigned long long)count, drop, secs);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+// 往返时延测量：逐条发送追踪消息并等待服务端把它广播回本端，统计往返耗时
+// 用于比较 TCP 与 Unix 域套接字两种接入方式
+#ifdef _WIN32
+#include <winsock2.h>
+#endif
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "chat_client.h"
+
+int main(int argc, char **argv) {
+    // 用法：chat_ping [地址|unix:路径] [端口] [次数] [负载字节数]
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        std::cerr << "WSAStartup failed" << std::endl;
+        return 1;
+    }
+#endif
+    std::string addr = argc >= 2 ? argv[1] : "127.0.0.1";
+    std::string port = argc >= 3 ? argv[2] : "5000";
+    int count = argc >= 4 ? std::atoi(argv[3]) : 10000;
+    size_t size = argc >= 5 ? std::strtoul(argv[4], nullptr, 10) : 64;
+    if (count <= 0) count = 1;
+    const std::string nick = "ping";
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    uint64_t rtt = 0;
+    bool got = false;
+
+    ChatClientNetwork client;
+    client.setTraceCallback(
+        [&](const ChatClientNetwork::TraceSample &s) {
+            if (s.from != nick) return;  // 只统计自己发出的消息
+            std::lock_guard<std::mutex> lock(mtx);
+            rtt = s.clientRecvUs - s.clientSendUs;
+            got = true;
+            cv.notify_one();
+        });
+    client.setStateCallback([&](bool) { cv.notify_one(); });
+    if (!client.connectTo(addr, port, nick)) return 1;
+    client.setTracing(true);
+
+    const std::string text(size, 'x');
+    std::vector<uint64_t> samples;
+    samples.reserve(count);
+    for (int i = 0; i < count && client.isConnected(); ++i) {
+        std::unique_lock<std::mutex> lock(mtx);
+        got = false;
+        lock.unlock();
+        if (!client.sendText(text)) break;
+        lock.lock();
+        cv.wait(lock, [&] { return got || !client.isConnected(); });
+        if (!got) break;
+        samples.push_back(rtt);
+    }
+    client.disconnect();
+#ifdef _WIN32
+    WSACleanup();
+#endif
+
+    if (samples.empty()) {
+        std::cerr << "no samples" << std::endl;
+        return 1;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double q) {
+        return samples[std::min(samples.size() - 1,
+                                static_cast<size_t>(q * samples.size()))];
+    };
+    std::printf("%s: %zu samples, %zu bytes, rtt us p50=%llu p90=%llu "
+                "p99=%llu max=%llu\n",
+                addr.c_str(), samples.size(), size,
+                (unsigned long long)at(0.50), (unsigned long long)at(0.90),
+                (unsigned long long)at(0.99),
+                (unsigned long long)samples.back());
+    return 0;
+}
@@ -0,0 +1,186 @@
+#include "room_sequencer.h"
+
+#include <algorithm>
+
+using namespace chatproto;
+
+void RoomSequencer::reset() {
+    last_.store(0, std::memory_order_relaxed);
+    based_ = false;
+    overlap_ = false;
+    started_ = false;
+    known_ = 0;
+    nackedTo_ = 0;
+    nackAtMs_ = 0;
+    pending_.clear();
+}
+
+/**
+ * 收到一条广播
+ * @param seq 房间序号
+ * @param type SERVER_BROADCAST 或 SERVER_BROADCAST_TRACED
+ * @param payload 含房间序号的完整负载
+ * @param viaMulticast 是否来自组播数据报（否则来自 TCP，包括补发）
+ * @param out 输出：按序放出的项
+ */
+void RoomSequencer::push(uint64_t seq, MsgType type, std::string payload,
+                         bool viaMulticast, std::vector<Item>& out) {
+    uint64_t last = last_.load(std::memory_order_relaxed);
+    overlap_ = overlap_ || viaMulticast;
+    if (!based_) {
+        if (viaMulticast) {
+            // 尚无基准：之前的广播可能仍在 TCP 上，先缓存
+            if (pending_.size() < kMaxPending)
+                pending_.emplace(seq, std::make_pair(type, std::move(payload)));
+            known_ = std::max(known_, seq);
+            return;
+        }
+        last = seq - 1;  // 第一条经 TCP 到达的广播建立基准
+        based_ = true;
+        advance(last);
+        pending_.erase(pending_.begin(), pending_.lower_bound(seq));
+    }
+    if (seq <= last || pending_.count(seq)) {
+        // 切换之前的重叠是正常的，不计为重复
+        if (started_ || !overlap_)
+            duplicates_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    known_ = std::max(known_, seq);
+    if (seq == last + 1) {
+        out.push_back({type, std::move(payload), 0, 0});
+        advance(seq);
+        release(out);
+        return;
+    }
+    if (!started_ && !viaMulticast) {
+        // 只经 TCP 接收：中间的广播不会再到达，直接报告缺失
+        skip(last + 1, seq - last - 1, out);
+        out.push_back({type, std::move(payload), 0, 0});
+        advance(seq);
+        release(out);
+        return;
+    }
+    pending_.emplace(seq, std::make_pair(type, std::move(payload)));
+    if (pending_.size() > kMaxPending) {
+        // 缓存过多：放弃最早的缺口
+        uint64_t first = pending_.begin()->first;
+        skip(last + 1, first - last - 1, out);
+        release(out);
+    }
+}
+
+void RoomSequencer::exists(uint64_t seq) { known_ = std::max(known_, seq); }
+
+/**
+ * MULTICAST_START：TCP 上此前的广播均已到达，之后只经组播接收
+ * @param seq 第一条只经组播发送的序号
+ * @param out 输出：按序放出的项
+ */
+void RoomSequencer::start(uint64_t seq, std::vector<Item>& out) {
+    started_ = true;
+    if (!based_ && seq > 0) {
+        based_ = true;
+        advance(seq - 1);
+        pending_.erase(pending_.begin(), pending_.lower_bound(seq));
+    }
+    known_ = std::max(known_, seq - 1);
+    release(out);
+}
+
+/**
+ * REPAIR_LOST：服务端已无法补发
+ * @param first 起始序号
+ * @param count 条数
+ * @param out 输出：按序放出的项
+ */
+void RoomSequencer::lost(uint64_t first, uint32_t count,
+                         std::vector<Item>& out) {
+    count = std::min(count, kMaxNackCount);
+    if (!based_) return;
+    uint64_t last = last_.load(std::memory_order_relaxed);
+    for (uint64_t s = first; s < first + count; ++s) {
+        if (s > last) pending_.emplace(s, std::make_pair(MsgType{}, ""));
+    }
+    release(out);
+}
+
+/**
+ * 生成补发请求
+ * @param nowMs 当前时间（毫秒，单调时钟）
+ * @param retryMs 重复请求的间隔
+ * @param out 输出：缺口列表
+ * @note 出现新的缺口时立即只请求新缺口；旧缺口每 retryMs 重新请求一次
+ */
+void RoomSequencer::nacks(uint64_t nowMs, uint64_t retryMs,
+                          std::vector<Range>& out) {
+    uint64_t last = last_.load(std::memory_order_relaxed);
+    if (!started_ || !based_ || known_ <= last) return;
+    bool retry = nowMs - nackAtMs_ >= retryMs;
+    if (!retry && known_ <= nackedTo_) return;
+    uint64_t from = retry ? last + 1 : std::max(last + 1, nackedTo_ + 1);
+    // 请求数受限时只记到已请求的位置，其余缺口在下次调用时继续请求
+    uint64_t covered = known_;
+    auto add = [&](uint64_t begin, uint64_t end) {  // [begin, end)
+        begin = std::max(begin, from);
+        if (begin >= end || covered < known_) return;
+        if (out.size() >= kMaxNackRanges) {
+            covered = begin - 1;
+            return;
+        }
+        uint64_t n = std::min<uint64_t>(end - begin, kMaxNackCount);
+        out.push_back({begin, static_cast<uint32_t>(n)});
+        if (n < end - begin) covered = begin + n - 1;
+    };
+    uint64_t s = last + 1;
+    for (const auto& kv : pending_) {
+        if (kv.first > s) add(s, kv.first);
+        s = kv.first + 1;
+    }
+    add(s, known_ + 1);
+    nackedTo_ = covered;
+    if (retry) nackAtMs_ = nowMs;
+}
+
+void RoomSequencer::advance(uint64_t seq) {
+    last_.store(seq, std::memory_order_relaxed);
+}
+
+void RoomSequencer::release(std::vector<Item>& out) {
+    while (!pending_.empty()) {
+        auto it = pending_.begin();
+        uint64_t last = last_.load(std::memory_order_relaxed);
+        if (it->first <= last) {
+            pending_.erase(it);
+            continue;
+        }
+        if (it->first != last + 1) break;
+        if (it->second.first == MsgType{}) {
+            skip(it->first, 1, out);  // 服务端确认丢失
+        } else {
+            out.push_back(
+                {it->second.first, std::move(it->second.second), 0, 0});
+            advance(it->first);
+        }
+        pending_.erase(it);
+    }
+}
+
+/**
+ * 跳过一段缺失的序号，与紧邻的上一段合并
+ * @param first 起始序号
+ * @param count 条数
+ * @param out 输出：按序放出的项
+ */
+void RoomSequencer::skip(uint64_t first, uint64_t count,
+                         std::vector<Item>& out) {
+    if (count == 0) return;
+    missed_.fetch_add(count, std::memory_order_relaxed);
+    advance(first + count - 1);
+    if (!out.empty() && out.back().missing != 0 &&
+        out.back().first + out.back().missing == first) {
+        out.back().missing += count;
+        return;
+    }
+    out.push_back({MsgType{}, std::string(), count, first});
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "common/protocol.h"
+
+/**
+ * 按房间序号整理聊天广播：去重、重排、发现缺失
+ * - 只经 TCP 接收时序号本应逐一递增：跳号直接报告缺失，不等待
+ * - 组播模式（start 之后）：数据报可能丢失或乱序，先缓存后面的帧，对缺口
+ *   生成 NACK，补发经 TCP 到达后按序放出；服务端已无法补发的序号按缺失跳过
+ * - 每个连接重新建立基准：第一条经 TCP 到达的广播或 MULTICAST_START 之前，
+ *   组播数据报只缓存不放出
+ * - 非线程安全，由调用方加锁；计数可在任意线程读取
+ */
+class RoomSequencer {
+   public:
+    // 按序放出的一项：一条广播帧，或一段缺失（missing 非 0）
+    struct Item {
+        chatproto::MsgType type;
+        std::string payload;  // 含房间序号的完整负载
+        uint64_t missing;     // 缺失的条数
+        uint64_t first;       // 缺失段的起始序号
+    };
+    using Range = std::pair<uint64_t, uint32_t>;  // [起始序号, 条数]
+
+    void reset();  // 新连接：清空缓存与基准（累计计数保留）
+    // 收到一条广播；viaMulticast 表示来自组播数据报
+    void push(uint64_t seq, chatproto::MsgType type, std::string payload,
+              bool viaMulticast, std::vector<Item>& out);
+    void exists(uint64_t seq);  // 已知序号存在但未收到内容（心跳或超长帧）
+    // MULTICAST_START：此后 TCP 不再发送 >= seq 的广播
+    void start(uint64_t seq, std::vector<Item>& out);
+    // REPAIR_LOST：服务端已无法补发，按缺失跳过
+    void lost(uint64_t first, uint32_t count, std::vector<Item>& out);
+    // 需要请求补发的缺口；距上次请求不足 retryMs 且没有新缺口时返回空
+    void nacks(uint64_t nowMs, uint64_t retryMs, std::vector<Range>& out);
+
+    uint64_t lastSeq() const { return last_.load(std::memory_order_relaxed); }
+    uint64_t missed() const { return missed_.load(std::memory_order_relaxed); }
+    uint64_t duplicates() const {
+        return duplicates_.load(std::memory_order_relaxed);
+    }
+
+   private:
+    void advance(uint64_t seq);  // last_ 前移到 seq
+    void release(std::vector<Item>& out);  // 放出紧接 last_ 的缓存项
+    void skip(uint64_t first, uint64_t count, std::vector<Item>& out);
+
+   private:
+    // 缓存上限：超过时放弃最早的缺口，避免长时间断流后无限缓存
+    static constexpr size_t kMaxPending = 16384;
+    static constexpr size_t kMaxNackRanges = 16;   // 单次最多请求的缺口
+    static constexpr uint32_t kMaxNackCount = 1024;  // 单个缺口最多的条数
+
+    std::atomic<uint64_t> last_{0};  // 已按序放出的最新序号
+    std::atomic<uint64_t> missed_{0};
+    std::atomic<uint64_t> duplicates_{0};
+    bool based_{false};     // 已建立基准
+    bool overlap_{false};   // 已收到组播：切换前两条路径可能送达同一帧
+    bool started_{false};   // 已收到 MULTICAST_START
+    uint64_t known_{0};     // 已知存在的最大序号
+    uint64_t nackedTo_{0};  // 已请求补发到的序号
+    uint64_t nackAtMs_{0};  // 上次请求补发的时间
+    // 尚未放出的帧：序号 -> 帧；type 为 0 的项表示服务端确认丢失
+    std::map<uint64_t, std::pair<chatproto::MsgType, std::string>> pending_;
+};
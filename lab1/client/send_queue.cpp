@@ -0,0 +1,106 @@
+#include "send_queue.h"
+
+/**
+ * 入队一帧
+ * @param frame 已编码的完整帧
+ * @return 队列已关闭时返回 false
+ */
+bool SendQueue::push(std::string frame) {
+    if (closed_.load(std::memory_order_acquire)) return false;
+    bytes_.fetch_add(frame.size(), std::memory_order_relaxed);
+    Node* n = new Node{nullptr, std::move(frame)};
+    Node* old = head_.load(std::memory_order_relaxed);
+    do {
+        n->next = old;
+    } while (!head_.compare_exchange_weak(old, n, std::memory_order_release,
+                                          std::memory_order_relaxed));
+    if (old == nullptr) {
+        // 由空变为非空：写线程可能在睡眠。先加锁再通知，避免丢失唤醒
+        std::lock_guard<std::mutex> lock(mtx_);
+        readyCv_.notify_one();
+    }
+    return true;
+}
+
+/**
+ * 取出全部待发送帧
+ * @param out 输出缓冲，按入队顺序追加
+ * @return 队列已关闭且没有剩余内容时返回 false
+ */
+bool SendQueue::popAll(std::string& out) {
+    Node* list = head_.exchange(nullptr, std::memory_order_acquire);
+    if (list == nullptr) {
+        std::unique_lock<std::mutex> lock(mtx_);
+        readyCv_.wait(lock, [this] {
+            return head_.load(std::memory_order_relaxed) != nullptr ||
+                   closed_.load(std::memory_order_relaxed);
+        });
+        list = head_.exchange(nullptr, std::memory_order_acquire);
+        if (list == nullptr) return false;  // 已关闭且取空
+    }
+    // 链表为逆序：先反转，再按入队顺序拼接
+    Node* prev = nullptr;
+    while (list) {
+        Node* next = list->next;
+        list->next = prev;
+        prev = list;
+        list = next;
+    }
+    while (prev) {
+        Node* next = prev->next;
+        out += prev->frame;
+        delete prev;
+        prev = next;
+    }
+    return true;
+}
+
+/**
+ * 一批帧发送完毕
+ * @param bytes 该批的字节数
+ */
+void SendQueue::release(size_t bytes) {
+    bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mtx_);
+    drainedCv_.notify_all();
+}
+
+/**
+ * 等待积压降到 limit 以下（分片发送大数据块时的背压）
+ * @param limit 积压上限（字节）
+ */
+bool SendQueue::waitBelow(size_t limit) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    drainedCv_.wait(lock, [&] {
+        return bytes_.load(std::memory_order_relaxed) < limit ||
+               closed_.load(std::memory_order_relaxed);
+    });
+    return !closed_.load(std::memory_order_relaxed);
+}
+
+void SendQueue::close() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        closed_.store(true, std::memory_order_release);
+    }
+    readyCv_.notify_all();
+    drainedCv_.notify_all();
+}
+
+/**
+ * 丢弃剩余内容并重新打开；调用方保证此时没有写线程
+ */
+void SendQueue::reset() {
+    clear();
+    bytes_.store(0, std::memory_order_relaxed);
+    closed_.store(false, std::memory_order_release);
+}
+
+void SendQueue::clear() {
+    Node* list = head_.exchange(nullptr, std::memory_order_acquire);
+    while (list) {
+        Node* next = list->next;
+        delete list;
+        list = next;
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string>
+
+/**
+ * 客户端发送队列（多生产者、单消费者）
+ * - 入队无锁：生产者用 CAS 把已编码的帧压入链表头后立即返回，不等待网络
+ * - 写线程一次取走整条链表，反转为入队顺序后拼接，合并为一次 send
+ * - 只有队列由空变为非空时才加锁唤醒写线程，积压时入队不再触碰互斥量
+ */
+class SendQueue {
+   public:
+    SendQueue() = default;
+    ~SendQueue() { clear(); }
+
+    SendQueue(const SendQueue&) = delete;
+    SendQueue& operator=(const SendQueue&) = delete;
+
+    // 入队一帧；队列已关闭时返回 false
+    bool push(std::string frame);
+    // 等待并取出全部帧，按入队顺序追加到 out；已关闭且取空时返回 false
+    bool popAll(std::string& out);
+    // 写线程发送完一批后调用，释放积压计数并唤醒等待背压的生产者
+    void release(size_t bytes);
+    // 等待积压降到 limit 以下；队列关闭时返回 false
+    bool waitBelow(size_t limit);
+
+    void close();  // 之后 push 失败；popAll 取完剩余内容后返回 false
+    void reset();  // 丢弃剩余内容并重新打开（新连接复用）
+    size_t queuedBytes() const {
+        return bytes_.load(std::memory_order_relaxed);
+    }
+
+   private:
+    struct Node {
+        Node* next;
+        std::string frame;
+    };
+
+    void clear();
+
+   private:
+    std::atomic<Node*> head_{nullptr};  // 最新入队的帧（链表为逆序）
+    std::atomic<size_t> bytes_{0};      // 已入队、尚未发送完的字节数
+    std::atomic<bool> closed_{false};
+
+    // 仅用于睡眠与唤醒，不保护链表
+    std::mutex mtx_;
+    std::condition_variable readyCv_;    // 写线程：队列非空或关闭
+    std::condition_variable drainedCv_;  // 生产者：积压下降或关闭
+};
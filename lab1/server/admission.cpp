@@ -0,0 +1,158 @@
+#include "admission.h"
+
+#include <algorithm>
+
+using namespace chatproto;
+
+/**
+ * 登记新接受的连接
+ * @param s 已设置为非阻塞的客户端套接字
+ * @param peerKey 来源地址
+ * @return 是否登记成功；失败时套接字已被关闭
+ */
+bool HandshakeAdmission::add(SOCKET s, const std::string& peerKey) {
+    size_t& count = perPeer_[peerKey];
+    if (pending_.size() >= cfg_.maxPending || count >= cfg_.maxPendingPerIp) {
+        // 超过全局或单地址上限，直接拒绝
+        if (count == 0) perPeer_.erase(peerKey);
+        closesocket(s);
+        return false;
+    }
+    ++count;
+    Pending p;
+    p.sock = s;
+    p.peerKey = peerKey;
+    p.deadline = Clock::now() + std::chrono::milliseconds(cfg_.helloTimeoutMs);
+    pending_.push_back(std::move(p));
+    return true;
+}
+
+/**
+ * 将所有待握手套接字追加到 poll 集合
+ * @param fds poll 集合
+ */
+void HandshakeAdmission::appendPollFds(std::vector<WSAPOLLFD>& fds) const {
+    for (const auto& p : pending_) {
+        WSAPOLLFD pfd{};
+        pfd.fd = p.sock;
+        pfd.events = POLLIN;
+        fds.push_back(pfd);
+    }
+}
+
+/**
+ * 处理 poll 返回的就绪事件
+ * @param fds poll 集合
+ * @param offset 待握手套接字在集合中的起始下标
+ * @param out 输出握手完成的连接
+ */
+void HandshakeAdmission::onPollResult(const std::vector<WSAPOLLFD>& fds,
+                                      size_t offset,
+                                      std::vector<Admitted>& out) {
+    // 倒序遍历，便于在循环中按下标移除
+    size_t n = std::min(pending_.size(), fds.size() - offset);
+    for (size_t i = n; i-- > 0;) {
+        short ev = fds[offset + i].revents;
+        if (ev == 0) continue;
+        if (ev & (POLLERR | POLLHUP | POLLNVAL)) {
+            drop(i);
+            continue;
+        }
+        int r = readSome(pending_[i]);
+        if (r < 0) {
+            drop(i);
+        } else if (r > 0) {
+            // HELLO 完整：恢复阻塞模式后交给会话线程
+            Pending& p = pending_[i];
+            u_long blocking = 0;
+            ioctlsocket(p.sock, FIONBIO, &blocking);
+            out.push_back({p.sock, std::move(p.payload)});
+            p.sock = INVALID_SOCKET;  // 所有权已转移
+            drop(i);
+        }
+    }
+}
+
+/**
+ * 非阻塞地读取一个待握手连接上的可用数据
+ * @param p 待握手连接
+ * @return -1 失败或协议错误，0 尚未完整，1 已收到完整 HELLO
+ */
+int HandshakeAdmission::readSome(Pending& p) {
+    if (p.headerGot < sizeof(p.header)) {
+        int n = recv(p.sock, reinterpret_cast<char*>(p.header) + p.headerGot,
+                     static_cast<int>(sizeof(p.header) - p.headerGot), 0);
+        if (n == 0) return -1;
+        if (n == SOCKET_ERROR)
+            return WSAGetLastError() == WSAEWOULDBLOCK ? 0 : -1;
+        p.headerGot += static_cast<size_t>(n);
+        if (p.headerGot < sizeof(p.header)) return 0;
+        // 帧头完整：第一帧必须是 HELLO，且负载不超过上限
+        if (static_cast<MsgType>(p.header[0]) != MsgType::HELLO) return -1;
+        uint32_t nlen = 0;
+        std::memcpy(&nlen, p.header + 1, 4);
+        p.payloadLen = ntohl(nlen);
+        if (p.payloadLen > cfg_.maxHelloPayload) return -1;
+        p.payload.reserve(p.payloadLen);
+        if (p.payloadLen == 0) return 1;
+        return 0;  // 负载留到下一次可读时读取
+    }
+    char buf[512];
+    size_t want = std::min<size_t>(sizeof(buf), p.payloadLen - p.payload.size());
+    int n = recv(p.sock, buf, static_cast<int>(want), 0);
+    if (n == 0) return -1;
+    if (n == SOCKET_ERROR) return WSAGetLastError() == WSAEWOULDBLOCK ? 0 : -1;
+    p.payload.append(buf, static_cast<size_t>(n));
+    return p.payload.size() == p.payloadLen ? 1 : 0;
+}
+
+/**
+ * 关闭所有已超过 HELLO 截止时间的连接
+ * @return 关闭的连接数
+ */
+size_t HandshakeAdmission::expire() {
+    auto now = Clock::now();
+    size_t n = 0;
+    for (size_t i = pending_.size(); i-- > 0;) {
+        if (pending_[i].deadline <= now) {
+            drop(i);
+            ++n;
+        }
+    }
+    return n;
+}
+
+/**
+ * 计算 poll 的等待时间
+ * @param fallbackMs 无待握手连接时的等待时间
+ */
+int HandshakeAdmission::nextTimeoutMs(int fallbackMs) const {
+    if (pending_.empty()) return fallbackMs;
+    auto earliest = pending_.front().deadline;
+    for (const auto& p : pending_) earliest = std::min(earliest, p.deadline);
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    earliest - Clock::now())
+                    .count();
+    if (left < 0) return 0;
+    return static_cast<int>(std::min<long long>(left, fallbackMs));
+}
+
+/**
+ * 关闭所有待握手连接
+ */
+void HandshakeAdmission::closeAll() {
+    while (!pending_.empty()) drop(pending_.size() - 1);
+}
+
+/**
+ * 关闭并移除一个待握手连接（与末尾交换后弹出）
+ * @param idx 下标
+ */
+void HandshakeAdmission::drop(size_t idx) {
+    Pending& p = pending_[idx];
+    if (p.sock != INVALID_SOCKET) closesocket(p.sock);
+    auto it = perPeer_.find(p.peerKey);
+    if (it != perPeer_.end() && --it->second == 0) perPeer_.erase(it);
+    if (idx != pending_.size() - 1) pending_[idx] = std::move(pending_.back());
+    pending_.pop_back();
+}
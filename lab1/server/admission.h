@@ -0,0 +1,77 @@
+#pragma once
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common/protocol.h"
+
+/**
+ * 握手准入阶段：在收到 HELLO 之前不为连接分配会话、线程或客户端列表槽位
+ * 由 accept 线程单线程驱动，所有待握手连接均为非阻塞套接字
+ */
+class HandshakeAdmission {
+   public:
+    struct Config {
+        int helloTimeoutMs = 5000;     // HELLO 截止时间（毫秒）
+        size_t maxPendingPerIp = 8;    // 单个来源地址的最大待握手连接数
+        size_t maxPending = 1024;      // 全局最大待握手连接数
+        size_t acceptBatch = 64;       // 每次监听可读时最多 accept 的连接数
+        uint32_t maxHelloPayload = 1024;  // HELLO 负载上限（昵称）
+    };
+
+    // 握手完成的连接：套接字已恢复为阻塞模式
+    struct Admitted {
+        SOCKET sock;
+        std::string nickname;
+    };
+
+    explicit HandshakeAdmission(const Config& cfg) : cfg_(cfg) {}
+    ~HandshakeAdmission() { closeAll(); }
+
+    HandshakeAdmission(const HandshakeAdmission&) = delete;
+    HandshakeAdmission& operator=(const HandshakeAdmission&) = delete;
+
+    // 登记新连接，超出限制时关闭套接字并返回 false
+    bool add(SOCKET s, const std::string& peerKey);
+    // 将待握手套接字追加到 poll 集合（只关心可读）
+    void appendPollFds(std::vector<WSAPOLLFD>& fds) const;
+    // 处理 poll 结果（fds 从 offset 开始与 appendPollFds 顺序一致）
+    void onPollResult(const std::vector<WSAPOLLFD>& fds, size_t offset,
+                      std::vector<Admitted>& out);
+    // 关闭所有超过截止时间的连接，返回关闭的数量
+    size_t expire();
+    // 距离最近截止时间的毫秒数（无待握手连接时返回 fallbackMs）
+    int nextTimeoutMs(int fallbackMs) const;
+    void closeAll();
+
+    size_t pendingCount() const { return pending_.size(); }
+    const Config& config() const { return cfg_; }
+
+   private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Pending {
+        SOCKET sock{INVALID_SOCKET};
+        std::string peerKey;        // 来源地址（用于按地址计数）
+        Clock::time_point deadline;  // HELLO 截止时间
+        uint8_t header[5]{};         // 帧头缓冲
+        size_t headerGot{0};         // 已接收帧头字节数
+        uint32_t payloadLen{0};      // 负载长度
+        std::string payload;         // 已接收负载
+    };
+
+    // 读取可用数据；返回 -1 失败，0 未完成，1 HELLO 完整
+    int readSome(Pending& p);
+    void drop(size_t idx);  // 关闭并移除第 idx 个连接
+
+   private:
+    Config cfg_;
+    std::vector<Pending> pending_;                       // 待握手连接
+    std::unordered_map<std::string, size_t> perPeer_;  // 每个地址的待握手数
+};
@@ -1,53 +1,181 @@
 #include "chat_server.h"
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <vector>
 
 using namespace chatproto;
 
 /**
- * 启动服务器，监听指定端口
+ * 读取聊天广播帧的房间序号
+ * @param wire 已编码的帧
+ * @return 房间序号，非聊天广播返回 0
+ */
+static uint64_t roomSeqOf(const OutboundQueue::Wire& wire) {
+    auto type = static_cast<MsgType>((*wire)[0]);
+    if ((type != MsgType::SERVER_BROADCAST &&
+         type != MsgType::SERVER_BROADCAST_TRACED) ||
+        wire->size() < 5 + SEQ_HEADER_SIZE)
+        return 0;
+    return getU64(wire->data() + 5);
+}
+
+/**
+ * 创建、绑定并监听一个流式套接字
+ * @param family 地址族（AF_INET / AF_UNIX）
+ * @param addr 绑定地址
+ * @param len 地址长度
+ * @return 非阻塞的监听套接字，失败返回 INVALID_SOCKET
+ */
+static SOCKET openListener(int family, const sockaddr* addr, int len) {
+    // TCP 与 Unix 域套接字都使用 SOCK_STREAM，帧协议完全相同
+    SOCKET s = socket(family, SOCK_STREAM, family == AF_INET ? IPPROTO_TCP : 0);
+    if (s == INVALID_SOCKET) return INVALID_SOCKET;
+
+    if (family == AF_INET) {
+        // 允许地址重用 SO_REUSEADDR
+        u_long yes = 1;
+        setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes,
+                   sizeof(yes));
+    }
+    // 绑定并开始监听传入连接
+    if (bind(s, addr, len) == SOCKET_ERROR ||
+        listen(s, SOMAXCONN) == SOCKET_ERROR) {
+        closesocket(s);
+        return INVALID_SOCKET;
+    }
+    // 监听套接字设为非阻塞，以便 acceptLoop 批量 accept 直到 WSAEWOULDBLOCK
+    u_long nonBlocking = 1;
+    ioctlsocket(s, FIONBIO, &nonBlocking);
+    return s;
+}
+
+/**
+ * 删除残留的 Unix 域套接字文件；路径上是普通文件或目录时保留不动（bind 随后失败）
+ * @param path 套接字路径
+ */
+static void removeStaleSocket(const std::string& path) {
+#ifdef _WIN32
+#ifndef IO_REPARSE_TAG_AF_UNIX
+#define IO_REPARSE_TAG_AF_UNIX 0x80000023L
+#endif
+    // Windows 上的 AF_UNIX 套接字文件是带 AF_UNIX 标记的重解析点
+    WIN32_FIND_DATAA fd;
+    HANDLE h = FindFirstFileA(path.c_str(), &fd);
+    if (h == INVALID_HANDLE_VALUE) return;
+    FindClose(h);
+    if ((fd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) &&
+        fd.dwReserved0 == IO_REPARSE_TAG_AF_UNIX)
+        DeleteFileA(path.c_str());
+#else
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path.c_str());
+#endif
+}
+
+/**
+ * 启动服务器，监听指定端口（以及可选的 Unix 域套接字路径）
  * @param port 监听端口
  */
 bool ChatServer::start(uint16_t port) {
     if (running_.load()) return true;  // 如果已经运行则直接返回 true
-    // 创建监听套接字
-    SOCKET& listenSockRef = listenSock_;
-    // af: IPv4,type:SOCK_STREAM, protocol:TCP 流式套接字
-    listenSockRef = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (listenSockRef == INVALID_SOCKET) return false;
-
-    // 允许地址重用
-    u_long yes = 1;
-    // 设置套接字选项 允许地址重用 SO_REUSEADDR
-    setsockopt(listenSockRef, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes,
-               sizeof(yes));
-
-    // 绑定地址和端口
+
+    // 绑定到所有接口的指定端口
     sockaddr_in addr{};
     addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = htonl(INADDR_ANY);  // 绑定到所有接口
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
     addr.sin_port = htons(port);
+    SOCKET tcp = openListener(AF_INET, (sockaddr*)&addr, sizeof(addr));
+    if (tcp == INVALID_SOCKET) return false;
+    listeners_.push_back({tcp, AF_INET});
 
-    // 将套接字绑定到指定的 IP 地址和端口
-    if (bind(listenSockRef, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
-        closesocket(listenSockRef);
-        listenSockRef = INVALID_SOCKET;
+    if (!unixPath_.empty()) {
+        // 同机客户端绕过 TCP/IP 协议栈；先删除上次运行残留的套接字文件
+        sockaddr_un uaddr{};
+        uaddr.sun_family = AF_UNIX;
+        if (unixPath_.size() >= sizeof(uaddr.sun_path)) {
+            closeListeners();
+            listeners_.clear();
+            return false;
+        }
+        std::memcpy(uaddr.sun_path, unixPath_.c_str(), unixPath_.size());
+        removeStaleSocket(unixPath_);
+        SOCKET us = openListener(AF_UNIX, (sockaddr*)&uaddr, sizeof(uaddr));
+        if (us == INVALID_SOCKET) {
+            closeListeners();
+            listeners_.clear();
+            return false;
+        }
+        listeners_.push_back({us, AF_UNIX});
+    }
+
+    if (metricsPort_ != 0 &&
+        !metricsExporter_.start(metricsPort_,
+                                [this] { return renderMetrics(); })) {
+        closeListeners();
+        listeners_.clear();
         return false;
     }
-    // 开始监听传入连接
-    if (listen(listenSockRef, SOMAXCONN) == SOCKET_ERROR) {
-        closesocket(listenSockRef);
-        listenSockRef = INVALID_SOCKET;
+
+    if (!mailboxCfg_.spillDir.empty() && !mailbox_.start(mailboxCfg_)) {
+        metricsExporter_.stop();
+        closeListeners();
+        listeners_.clear();
+        return false;
+    }
+
+    if (!multicastCfg_.group.empty() && !multicast_.start(multicastCfg_)) {
+        mailbox_.stop();
+        metricsExporter_.stop();
+        closeListeners();
+        listeners_.clear();
         return false;
     }
 
     running_.store(true);
+    searchIndex_.start();
+    receiptBatcher_.start(kReceiptIntervalMs);
+    if (memoryCfg_.limitBytes > 0) {
+        MemoryGovernor::Hooks hooks;
+        hooks.usage = [this] { return memoryUsage(); };
+        hooks.trimHistory = [this](size_t bytes) {
+            size_t freed = searchIndex_.trimOldest(bytes);
+            metrics::inc(metrics::MEM_HISTORY_TRIMMED, freed);
+            return freed;
+        };
+        hooks.disconnectHeaviest = [this] { return shedHeaviest(); };
+        memoryGovernor_.start(memoryCfg_, std::move(hooks));
+    }
+    if (fanoutThreads_ > 0) {
+        // 分发线程本身参与并行分发，线程池只需再启动 n - 1 个工作线程
+        fanoutPool_.start(fanoutThreads_ - 1);
+        fanoutRunning_ = true;
+        fanoutThread_ = std::thread(&ChatServer::fanoutLoop, this);
+    }
     acceptThread_ = std::thread(&ChatServer::acceptLoop, this);
     return true;
 }
 
+/**
+ * 关闭所有监听套接字
+ */
+void ChatServer::closeListeners() {
+    for (auto& l : listeners_) {
+        if (l.sock != INVALID_SOCKET) closesocket(l.sock);
+        l.sock = INVALID_SOCKET;
+    }
+}
+
 /**
  * 停止服务器，关闭所有连接
  */
@@ -56,12 +184,22 @@ void ChatServer::stop() {
 
     // 停止接受新连接
     running_.store(false);
-    if (listenSock_ != INVALID_SOCKET) {
-        closesocket(listenSock_);  // 关闭监听套接字
-        listenSock_ = INVALID_SOCKET;
-    }
+    closeListeners();  // 关闭监听套接字
 
     if (acceptThread_.joinable()) acceptThread_.join();  // 等待接受线程结束
+    listeners_.clear();
+    memoryGovernor_.stop();
+    if (!unixPath_.empty()) removeStaleSocket(unixPath_);
+
+    // 先分发完已提交的广播；此后的广播在发送者线程上同步分发
+    {
+        std::lock_guard<std::mutex> lock(fanoutMtx_);
+        fanoutRunning_ = false;
+    }
+    fanoutCv_.notify_all();
+    fanoutSpaceCv_.notify_all();
+    if (fanoutThread_.joinable()) fanoutThread_.join();
+    fanoutPool_.stop();  // 并行分发只在分发线程上进行，此时已空闲
 
     // 关闭所有客户端连接（避免在持锁时 delete 导致死锁）
     std::vector<ClientSession*> toClose;
@@ -69,12 +207,13 @@ void ChatServer::stop() {
         std::lock_guard<std::mutex> lock(clientsMtx_);
         toClose.swap(clients_);  // 将当前列表转移出来并清空服务器持有的列表
     }
-    for (auto* c : toClose) {
-        c->forceClose();
-    }
-    for (auto* c : toClose) {
-        delete c;  // 析构中 join 线程
-    }
+    dispose(toClose);
+    reapRetired(true);  // 包括已自行离开、尚未被清理的会话
+    receiptBatcher_.stop();
+    multicast_.stop();
+    mailbox_.stop();
+    searchIndex_.stop();
+    metricsExporter_.stop();
 }
 
 /**
@@ -85,32 +224,300 @@ void ChatServer::stop() {
  */
 void ChatServer::broadcast(MsgType type, const std::string& payload,
                            ClientSession* exclude) {
+    // 只编码一次，所有接收者共享同一份帧数据
+    dispatch(std::make_shared<const std::string>(encodeFrame(type, payload)),
+             exclude, 0);
+}
+
+/**
+ * 广播流帧到所有客户端，排除指定客户端
+ * @param streamId 服务端流编号
+ * @param type 消息类型
+ * @param payload 消息负载
+ * @param exclude 排除的客户端指针（可选）
+ */
+void ChatServer::broadcastStream(uint32_t streamId, MsgType type,
+                                 const std::string& payload,
+                                 ClientSession* exclude) {
+    dispatch(std::make_shared<const std::string>(encodeFrame(type, payload)),
+             exclude, streamId);
+}
+
+/**
+ * 提交广播：启用分发线程时入队后立即返回，发送者线程可继续读取下一帧
+ * @param wire 已编码的帧
+ * @param exclude 排除的客户端指针（可选）
+ * @param streamId 流编号，0 表示普通帧
+ * @note 所有广播经同一队列按提交顺序分发，每个接收者看到的顺序不变
+ */
+void ChatServer::dispatch(const OutboundQueue::Wire& wire,
+                          ClientSession* exclude, uint32_t streamId) {
+    auto lock = waitFanoutSpace();
+    submit(lock, {wire, exclude, streamId});
+}
+
+/**
+ * 广播聊天消息，并在提交时分配房间序号
+ * @param type SERVER_BROADCAST 或 SERVER_BROADCAST_TRACED
+ * @param payload 负载，开头预留 SEQ_HEADER_SIZE 字节
+ * @param receipts 发送者的回执状态（可选）
+ * @param id 回执的消息编号
+ * @note 序号在 fanoutMtx_ 内分配并与入队一起完成，分发线程按队列顺序执行，
+ *       因此每个接收者看到的序号严格递增；锁内只写 8 字节，不分配内存
+ */
+void ChatServer::publish(MsgType type, const std::string& payload,
+                         ReceiptTracker* receipts, uint64_t id) {
+    auto* frame = new std::string(encodeFrame(type, payload));
+    OutboundQueue::Wire wire =
+        receipts ? receipts->track(id, frame) : OutboundQueue::Wire(frame);
+    auto lock = waitFanoutSpace();
+    setU64(&(*frame)[5], ++roomSeq_);
+    submit(lock, {std::move(wire), nullptr, 0});
+}
+
+std::unique_lock<std::mutex> ChatServer::waitFanoutSpace() {
+    std::unique_lock<std::mutex> lock(fanoutMtx_);
+    fanoutSpaceCv_.wait(lock, [this] {
+        return !fanoutRunning_ || fanoutJobs_.size() < kMaxFanoutJobs;
+    });
+    return lock;
+}
+
+/**
+ * 提交广播并释放分发锁
+ * @param lock 持有的 fanoutMtx_
+ * @param job 待分发的广播
+ * @note 分发线程未运行时（同步模式、仿真或停止过程中）由调用者线程执行队列：
+ *       广播仍先入队，序号顺序即执行顺序，并发的发送者不会让 N+1 先于 N 入队
+ */
+void ChatServer::submit(std::unique_lock<std::mutex>& lock, FanoutJob job) {
+    fanoutJobs_.push_back(std::move(job));
+    bool running = fanoutRunning_;
+    lock.unlock();
+    if (running) {
+        fanoutCv_.notify_one();
+        return;
+    }
+    drainFanout();
+}
+
+/**
+ * 分发线程：等待广播并按提交顺序执行；停止时先处理完已提交的广播
+ */
+void ChatServer::fanoutLoop() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(fanoutMtx_);
+            fanoutCv_.wait(lock, [this] {
+                return !fanoutJobs_.empty() || !fanoutRunning_;
+            });
+            if (fanoutJobs_.empty()) return;
+        }
+        drainFanout();
+    }
+}
+
+/**
+ * 逐个取出队首广播执行 fanout，直到队列为空
+ * @note 出队与 fanout 都在 fanoutOrderMtx_ 内，分发线程与同步分发的发送者线程
+ *       不会交错执行；调用者不得持有 clientsMtx_
+ */
+void ChatServer::drainFanout() {
+    std::lock_guard<std::mutex> order(fanoutOrderMtx_);
+    while (true) {
+        FanoutJob job;
+        {
+            std::lock_guard<std::mutex> lock(fanoutMtx_);
+            if (fanoutJobs_.empty()) return;
+            job = std::move(fanoutJobs_.front());
+            fanoutJobs_.pop_front();
+        }
+        fanoutSpaceCv_.notify_one();
+        fanout(job.wire, job.exclude, job.streamId);
+    }
+}
+
+/**
+ * 将帧放入各客户端的发送队列，实际发送由各自的写线程完成
+ * @param wire 已编码的帧
+ * @param exclude 排除的客户端指针（可选）
+ * @param streamId 流编号，0 表示普通帧
+ */
+void ChatServer::fanout(const OutboundQueue::Wire& wire,
+                        ClientSession* exclude, uint32_t streamId) {
+    uint64_t t0 = metrics::nowNs();
+    // 组播模式下聊天广播按房间序号区分：已加入组播的会话不再经 TCP 接收
+    uint64_t seq =
+        streamId == 0 && multicast_.enabled() ? roomSeqOf(wire) : 0;
     // 上锁保护客户端列表，并在锁外删除对象避免死锁
     std::vector<ClientSession*> toRemove;
     {
-        std::lock_guard<std::mutex> lock(clientsMtx_);
-        for (auto it = clients_.begin(); it != clients_.end();) {
-            ClientSession* c = *it;
-            if (exclude && c == exclude) {
-                ++it;
-                continue;
+        auto lock = lockClients();
+        if (clients_.size() >= kParallelFanoutMin &&
+            fanoutPool_.workers() > 0) {
+            fanoutParallel(lock, wire, exclude, streamId, seq, toRemove);
+        } else {
+            for (auto it = clients_.begin(); it != clients_.end();) {
+                ClientSession* c = *it;
+                if (exclude && c == exclude) {
+                    ++it;
+                    continue;
+                }
+                bool ok = streamId ? c->enqueueStream(streamId, wire)
+                          : seq    ? c->enqueueChat(wire, seq)
+                                   : c->enqueue(wire);
+                if (!ok) {
+                    // 队列已关闭或积压超过上限（慢消费者），从列表中移除
+                    it = clients_.erase(it);
+                    toRemove.push_back(c);
+                } else {
+                    ++it;
+                }
+            }
+            if (streamId == 0 && ReceiptTracker::tracked(wire)) {
+                // 带回执的聊天（不排除发送者）：列表中剩下的会话均已成功入队
+                ReceiptTracker::accepted(
+                    wire, static_cast<uint32_t>(clients_.size()));
             }
-            if (!sendFrame(c->sock(), type, payload)) {
-                // 如果发送失败，直接从列表中移除，稍后在锁外关闭并析构
-                it = clients_.erase(it);
-                toRemove.push_back(c);
-            } else {
-                ++it;
+            // 与入队在同一临界区内：离线用户恰好错过的帧由邮箱保留
+            if (streamId == 0) mailbox_.post(wire);
+        }
+        for (auto* c : toRemove) {
+            mailbox_.offline(c);
+            metrics::inc(metrics::SLOW_CONSUMERS);
+        }
+    }
+    if (seq) multicast_.publish(seq, wire);  // 整个房间只发送一次
+    metrics::observe(metrics::BROADCAST_FANOUT, metrics::nowNs() - t0);
+    if (!toRemove.empty()) dispose(toRemove);
+}
+
+/**
+ * 按接收者区间并行入队：持锁复制接收者列表后释放 clientsMtx_，由线程池在锁外
+ * 入队，最后重新加锁移除入队失败的会话
+ * @param lock 持有的 clientsMtx_，入队期间释放，返回时重新持有
+ * @param wire 已编码的帧
+ * @param exclude 排除的客户端指针（可选）
+ * @param streamId 流编号，0 表示普通帧
+ * @param seq 组播模式下聊天广播的房间序号，否则为 0
+ * @param toRemove 输出：入队失败、已移出列表的会话
+ * @note 快照中的会话在入队期间可能被移出列表，sessionRefsMtx_ 的共享锁保证
+ *       它们在此期间不会被 delete
+ */
+void ChatServer::fanoutParallel(std::unique_lock<std::mutex>& lock,
+                                const OutboundQueue::Wire& wire,
+                                ClientSession* exclude, uint32_t streamId,
+                                uint64_t seq,
+                                std::vector<ClientSession*>& toRemove) {
+    std::shared_lock<std::shared_mutex> refs(sessionRefsMtx_);
+    fanoutTargets_.assign(clients_.begin(), clients_.end());
+    // 与快照在同一临界区内：此后上线的用户从邮箱取得该帧
+    if (streamId == 0) mailbox_.post(wire);
+    lock.unlock();
+
+    const size_t n = fanoutTargets_.size();
+    fanoutFailed_.assign(n, 0);
+    std::atomic<size_t> failed{0};
+    fanoutPool_.parallelFor(n, kFanoutGrain, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            ClientSession* c = fanoutTargets_[i];
+            if (c == exclude) continue;
+            bool ok = streamId ? c->enqueueStream(streamId, wire)
+                      : seq    ? c->enqueueChat(wire, seq)
+                               : c->enqueue(wire);
+            if (!ok) {
+                fanoutFailed_[i] = 1;  // 各区间只写自己的下标
+                failed.fetch_add(1, std::memory_order_relaxed);
             }
         }
+    });
+    size_t nFailed = failed.load(std::memory_order_relaxed);
+    if (streamId == 0 && ReceiptTracker::tracked(wire)) {
+        // 带回执的聊天（不排除发送者）：快照中入队成功的会话数
+        ReceiptTracker::accepted(wire, static_cast<uint32_t>(n - nFailed));
+    }
+
+    lock.lock();
+    if (nFailed == 0) return;
+    std::vector<ClientSession*> failedSessions;
+    for (size_t i = 0; i < n; ++i) {
+        if (fanoutFailed_[i]) failedSessions.push_back(fanoutTargets_[i]);
+    }
+    std::sort(failedSessions.begin(), failedSessions.end());
+    // 只移除仍在列表中的会话；期间已自行离开的会话由其离开流程负责
+    size_t kept = 0;
+    for (auto* c : clients_) {
+        if (std::binary_search(failedSessions.begin(), failedSessions.end(),
+                               c)) {
+            toRemove.push_back(c);
+        } else {
+            clients_[kept++] = c;
+        }
     }
-    // 在锁外进行强制关闭 + delete，避免析构中 join() 与持锁引发的死锁
-    for (auto* c : toRemove) {
+    clients_.resize(kept);
+}
+
+/**
+ * 释放会话
+ * @param sessions 已从客户端列表移出的会话
+ * @note 先全部 forceClose 使各自的线程尽快退出，再交给 accept 线程在线程退出后
+ *       delete；可在任意线程上调用，包括被释放会话自己的处理线程与分发线程
+ */
+void ChatServer::dispose(std::vector<ClientSession*>& sessions) {
+    for (auto* c : sessions) {
         c->forceClose();
     }
-    for (auto* c : toRemove) {
-        delete c;
+    for (auto* c : sessions) {
+        if (disposeHook_ && disposeHook_(c)) continue;
+        retire(c);
     }
+    sessions.clear();
+}
+
+/**
+ * 登记待释放的会话（已移出客户端列表）
+ * @param c 会话
+ */
+void ChatServer::retire(ClientSession* c) {
+    std::lock_guard<std::mutex> lock(retiredMtx_);
+    retired_.push_back(c);
+}
+
+/**
+ * 释放已登记的会话
+ * @param all true 时释放全部（析构中等待线程退出，用于停止），否则只释放
+ *        处理线程与写线程都已退出的会话，不阻塞调用者
+ */
+void ChatServer::reapRetired(bool all) {
+    std::vector<ClientSession*> done;
+    {
+        std::lock_guard<std::mutex> lock(retiredMtx_);
+        auto it = std::partition(
+            retired_.begin(), retired_.end(),
+            [all](ClientSession* c) { return !all && !c->exited(); });
+        done.assign(it, retired_.end());
+        retired_.erase(it, retired_.end());
+    }
+    if (done.empty()) return;
+    {
+        // 等待仍持有旧快照的并行分发结束；这些会话已不在列表中，之后的快照
+        // 不会再包含它们
+        std::unique_lock<std::shared_mutex> barrier(sessionRefsMtx_);
+    }
+    for (auto* c : done) delete c;
+}
+
+/**
+ * 向单个客户端发送一帧
+ * @param c 目标客户端会话
+ * @param type 消息类型
+ * @param payload 消息负载
+ * @return 是否入队成功
+ */
+bool ChatServer::sendTo(ClientSession* c, MsgType type,
+                        const std::string& payload) {
+    return c->enqueue(
+        std::make_shared<const std::string>(encodeFrame(type, payload)));
 }
 
 /**
@@ -119,105 +526,661 @@ void ChatServer::broadcast(MsgType type, const std::string& payload,
  */
 void ChatServer::removeClient(ClientSession* c) {
     // 上锁
-    std::lock_guard<std::mutex> lock(clientsMtx_);
+    auto lock = lockClients();
     // 查找并移除客户端
     auto it = std::find(clients_.begin(), clients_.end(), c);
-    if (it != clients_.end()) clients_.erase(it);
+    if (it != clients_.end()) {
+        clients_.erase(it);
+        mailbox_.offline(c);
+        // 会话自行离开：与移出列表在同一临界区内登记，run() 退出后由 accept
+        // 线程释放（仿真中会话没有线程，由仿真自行释放）
+        if (c->onOwnThread()) retire(c);
+    }
+}
+
+/**
+ * 获取客户端列表锁，并将等待时间计入直方图
+ * @return 已持有 clientsMtx_ 的锁
+ */
+std::unique_lock<std::mutex> ChatServer::lockClients() {
+    uint64_t t0 = metrics::nowNs();
+    std::unique_lock<std::mutex> lock(clientsMtx_);
+    metrics::observe(metrics::CLIENTS_LOCK_WAIT, metrics::nowNs() - t0);
+    return lock;
+}
+
+/**
+ * 生成 Prometheus 文本：累计指标来自各线程分片，队列深度在采集时读取
+ * @return 指标文本
+ */
+std::string ChatServer::renderMetrics() {
+    size_t sessions = 0, queued = 0, maxQueued = 0, maxSessionMem = 0;
+    {
+        auto lock = lockClients();
+        sessions = clients_.size();
+        for (auto* c : clients_) {
+            size_t q = c->queuedBytes();
+            queued += q;
+            maxQueued = std::max(maxQueued, q);
+            maxSessionMem = std::max(maxSessionMem, c->memoryBytes());
+        }
+    }
+    std::string text = metrics::render();
+    auto gauge = [&text](const char* name, const char* help, size_t v) {
+        text += "# HELP ";
+        text += name;
+        text += ' ';
+        text += help;
+        text += "\n# TYPE ";
+        text += name;
+        text += " gauge\n";
+        text += name;
+        text += ' ';
+        text += std::to_string(v);
+        text += '\n';
+    };
+    gauge("chat_sessions", "Active sessions", sessions);
+    gauge("chat_pending_handshakes", "Connections waiting for HELLO",
+          pendingHandshakes_.load(std::memory_order_relaxed));
+    gauge("chat_outbound_queued_bytes", "Bytes queued across all sessions",
+          queued);
+    gauge("chat_outbound_queued_bytes_max",
+          "Largest per-session outbound queue", maxQueued);
+    gauge("chat_search_pending_docs", "Messages waiting to be indexed",
+          searchIndex_.pendingDocs());
+    gauge("chat_search_segments", "Immutable index segments",
+          searchIndex_.segmentCount());
+    size_t fanoutPending = 0;
+    {
+        std::lock_guard<std::mutex> lock(fanoutMtx_);
+        fanoutPending = fanoutJobs_.size();
+    }
+    gauge("chat_fanout_pending", "Broadcasts waiting for the fanout thread",
+          fanoutPending);
+    if (mailbox_.enabled()) {
+        gauge("chat_mailbox_memory_bytes", "Offline mailbox bytes in memory",
+              mailbox_.memoryBytes());
+    }
+    if (multicast_.enabled()) {
+        gauge("chat_multicast_history_bytes",
+              "Chat broadcasts kept for multicast repair",
+              multicast_.memoryBytes());
+    }
+    gauge("chat_session_memory_bytes_max",
+          "Largest memory attributed to one session", maxSessionMem);
+    if (memoryGovernor_.limit() > 0) {
+        gauge("chat_memory_bytes", "Estimated server memory at last check",
+              memoryGovernor_.lastUsage());
+        gauge("chat_memory_limit_bytes", "Global memory limit",
+              memoryGovernor_.limit());
+        gauge("chat_memory_shed_level",
+              "Shedding actions engaged (0 = none)", memoryGovernor_.level());
+    }
+    return text;
+}
+
+/**
+ * 汇总内存占用估算
+ * @return 字节数
+ * @note 广播帧由多个接收者共享，按接收者分别计入，结果偏保守
+ */
+size_t ChatServer::memoryUsage() {
+    size_t total = 0;
+    {
+        auto lock = lockClients();
+        for (auto* c : clients_) total += c->memoryBytes();
+    }
+    {
+        std::lock_guard<std::mutex> lock(fanoutMtx_);
+        for (const auto& job : fanoutJobs_) total += job.wire->size();
+    }
+    total += searchIndex_.memoryBytes();
+    total += mailbox_.memoryBytes();
+    total += multicast_.memoryBytes();
+    total += pendingHandshakes_.load(std::memory_order_relaxed) *
+             admissionCfg_.maxHelloPayload;
+    return total;
+}
+
+/**
+ * 断开占用内存最多的会话（内存超限降级的最后一步）
+ * @return 被断开会话在固定开销之外的占用（发送队列与正在处理的帧）；所有会话都
+ *         只剩固定开销时返回 0，不再断开：此时超限来自邮箱、检索等，断开会话无济于事
+ */
+size_t ChatServer::shedHeaviest() {
+    ClientSession* victim = nullptr;
+    size_t most = 0;
+    {
+        auto lock = lockClients();
+        for (auto* c : clients_) {
+            size_t m = c->memoryBytes() - ClientSession::kSessionBaseBytes;
+            if (m > most) {
+                most = m;
+                victim = c;
+            }
+        }
+        if (!victim) return 0;
+        clients_.erase(std::find(clients_.begin(), clients_.end(), victim));
+        // 不为被断开的昵称开始收信，内存紧张时不再新建邮箱
+        mailbox_.drop(victim);
+    }
+    metrics::inc(metrics::MEM_DISCONNECTS);
+    std::vector<ClientSession*> v{victim};
+    dispose(v);
+    return most;
 }
 
 /**
- * 持续监听客户端连接请求，接受新的链接请求并创建对应的Session
+ * 上传方节流：其他会话的流积压达到 kStreamBudgetBytes 时暂停转发，上传者的处理
+ * 线程也就暂停读取，由 TCP 把背压传回上传者；流数据因此不会挤占接收者普通帧的
+ * 额度，读得慢的接收者只会让上传变慢
+ * @param uploader 上传者（不计自身）
+ * @note 等待 kStreamStallMs 后积压仍未降下来的接收者视为慢消费者断开，上传继续；
+ *       服务器未运行（仿真或停止过程中）时不等待
+ */
+void ChatServer::throttleStream(ClientSession* uploader) {
+    using Clock = std::chrono::steady_clock;
+    constexpr auto kPoll = std::chrono::milliseconds(2);
+    const auto deadline =
+        Clock::now() + std::chrono::milliseconds(ClientSession::kStreamStallMs);
+    auto backlogged = [uploader](ClientSession* c) {
+        return c != uploader &&
+               c->streamQueuedBytes() >= ClientSession::kStreamBudgetBytes;
+    };
+    while (running_.load()) {
+        std::vector<ClientSession*> stalled;
+        {
+            auto lock = lockClients();
+            if (std::none_of(clients_.begin(), clients_.end(), backlogged))
+                return;
+            if (Clock::now() >= deadline) {
+                auto it = std::stable_partition(
+                    clients_.begin(), clients_.end(),
+                    [&](ClientSession* c) { return !backlogged(c); });
+                stalled.assign(it, clients_.end());
+                clients_.erase(it, clients_.end());
+                for (auto* c : stalled) {
+                    mailbox_.offline(c);
+                    metrics::inc(metrics::SLOW_CONSUMERS);
+                }
+            }
+        }
+        if (!stalled.empty()) {
+            dispose(stalled);
+            return;
+        }
+        std::this_thread::sleep_for(kPoll);
+    }
+}
+
+/**
+ * 持续监听客户端连接请求，新连接先进入握手准入阶段，收到 HELLO 后才创建 Session
+ * @note 监听套接字与待握手连接一起由 WSAPoll 驱动，不为未握手连接分配线程
  */
 void ChatServer::acceptLoop() {
+    // 停止检查间隔：stop() 关闭监听套接字后，最迟在该时间内退出循环
+    constexpr int kIdlePollMs = 200;
+    HandshakeAdmission admission(admissionCfg_);
+    std::vector<WSAPOLLFD> fds;
+    std::vector<HandshakeAdmission::Admitted> admitted;
     while (running_.load()) {
-        // 开启新连接
-        sockaddr_in caddr{};
-        int clen = sizeof(caddr);
-        SOCKET cs = accept(listenSock_, (sockaddr*)&caddr, &clen);
-        if (cs == INVALID_SOCKET) {
-            // 如果重连接失败且服务器正在运行，则继续循环
-            if (!running_.load()) break;
-            continue;
+        fds.clear();
+        for (const auto& l : listeners_) {
+            WSAPOLLFD lfd{};
+            lfd.fd = l.sock;
+            lfd.events = POLLIN;
+            fds.push_back(lfd);
         }
-        auto* cli = new ClientSession(this, cs);  // 创建新的客户端会话
-        {
-            // 上锁，加入客户端列表
-            std::lock_guard<std::mutex> lock(clientsMtx_);
-            clients_.push_back(cli);
+        admission.appendPollFds(fds);
+
+        int rv = WSAPoll(fds.data(), static_cast<ULONG>(fds.size()),
+                         admission.nextTimeoutMs(kIdlePollMs));
+        if (!running_.load()) break;
+        if (rv == SOCKET_ERROR) continue;
+
+        if (rv > 0) {
+            // 先推进已有连接的握手，再接受新连接，避免新连接洪泛饿死已有连接
+            admission.onPollResult(fds, listeners_.size(), admitted);
+            for (size_t i = 0; i < listeners_.size(); ++i) {
+                if (fds[i].revents & POLLIN)
+                    acceptBatch(listeners_[i], admission);
+            }
         }
-        cli->start();  // 启动客户端会话线程
+        // 关闭超过 HELLO 截止时间的连接
+        metrics::inc(metrics::CONN_EXPIRED, admission.expire());
+        pendingHandshakes_.store(admission.pendingCount(),
+                                 std::memory_order_relaxed);
+
+        for (auto& a : admitted) admit(std::move(a));
+        admitted.clear();
+        reapRetired(false);  // 释放线程已退出的会话
     }
+    admission.closeAll();
+    pendingHandshakes_.store(0);
+}
+
+/**
+ * 批量接受新连接，直到没有待接受连接或达到单批上限
+ * @param l 可读的监听套接字
+ * @param admission 握手准入阶段
+ */
+void ChatServer::acceptBatch(const Listener& l, HandshakeAdmission& admission) {
+    for (size_t i = 0; i < admission.config().acceptBatch; ++i) {
+        sockaddr_storage caddr{};
+        int clen = sizeof(caddr);
+        SOCKET cs = accept(l.sock, (sockaddr*)&caddr, &clen);
+        if (cs == INVALID_SOCKET) break;  // WSAEWOULDBLOCK 或监听已关闭
+        // 待握手阶段使用非阻塞套接字
+        u_long nonBlocking = 1;
+        ioctlsocket(cs, FIONBIO, &nonBlocking);
+        // 按来源地址限流；Unix 域连接没有来源地址，按接受顺序各自计数，
+        // 只受全局待握手上限约束（能否连接由套接字文件的权限控制）
+        std::string peer = "unix#" + std::to_string(++unixAccepted_);
+        if (l.family == AF_INET) {
+            char ip[INET_ADDRSTRLEN] = {0};
+            inet_ntop(AF_INET, &((sockaddr_in*)&caddr)->sin_addr, ip,
+                      sizeof(ip));
+            peer = ip;
+        }
+        metrics::inc(metrics::CONN_ACCEPTED);
+        // 超出限制时由准入阶段直接关闭
+        if (!admission.add(cs, peer)) metrics::inc(metrics::CONN_REJECTED);
+    }
+}
+
+/**
+ * 握手完成：创建会话并加入客户端列表
+ * @param a 已收到 HELLO 的连接
+ */
+void ChatServer::admit(HandshakeAdmission::Admitted&& a) {
+    // HELLO 帧由准入阶段读取，在此补记
+    metrics::frameIn(static_cast<uint8_t>(MsgType::HELLO),
+                     5 + a.nickname.size());
+    if (memoryGovernor_.refusingHello()) {
+        // 内存超限：不再接纳新会话，已有会话不受影响；先告知原因再关闭
+        std::string wire =
+            encodeFrame(MsgType::REFUSED, "服务器内存不足，暂不接纳新连接");
+        sendAll(a.sock, wire.data(), static_cast<int>(wire.size()));
+        shutdown(a.sock, SD_SEND);
+        closesocket(a.sock);
+        metrics::inc(metrics::MEM_HELLO_REFUSED);
+        return;
+    }
+    ClientSession* cli = attach(a.sock, std::move(a.nickname));
+    cli->start();  // 启动客户端会话线程
+}
+
+/**
+ * 创建会话并加入客户端列表
+ * @param s 已握手的套接字
+ * @param nickname HELLO 中的昵称
+ * @return 新会话（尚未启动线程）
+ */
+ClientSession* ChatServer::attach(SOCKET s, std::string nickname) {
+    metrics::inc(metrics::SESSIONS_OPENED);
+    auto* cli = new ClientSession(this, s, std::move(nickname));
+    {
+        // 上锁，加入客户端列表
+        auto lock = lockClients();
+        clients_.push_back(cli);
+        cli->mailboxTicket_ = mailbox_.online(cli, cli->nickname());
+    }
+    return cli;
 }
 
 /**
  * 客户端会话析构函数，确保线程结束
  */
 ClientSession::~ClientSession() {
+    // 先等处理线程退出：它处理 RECEIPTS 时会替换 receipts_
     if (thread_.joinable()) thread_.join();
+    if (receipts_) receipts_->detach();  // 队列随会话销毁，之后不再发回执
+    outq_.close();
+    if (writer_.joinable()) writer_.join();
+    // 两个线程都已退出，此后不会再有线程使用该句柄
+    if (sock_ != INVALID_SOCKET) closesocket(sock_);
+}
+
+/**
+ * 放入一条聊天广播
+ * @param wire 已编码的帧
+ * @param seq 房间序号
+ * @note 客户端加入组播后，第一条不再经 TCP 发送的广播处改发 MULTICAST_START，
+ *       之前的序号仍在本队列中，客户端据此确定组播的起点
+ */
+bool ClientSession::enqueueChat(const OutboundQueue::Wire& wire,
+                                uint64_t seq) {
+    if (!multicast_.load(std::memory_order_acquire)) return outq_.push(wire);
+    if (multicastStarted_) return true;
+    multicastStarted_ = true;
+    std::string p;
+    putU64(p, seq);
+    return outq_.push(std::make_shared<const std::string>(
+        encodeFrame(MsgType::MULTICAST_START, p)));
 }
 
 /**
- * 启动客户端会话线程
+ * 启动客户端会话线程与写线程
  */
 void ClientSession::start() {
+    writer_ = std::thread(&ClientSession::writeLoop, this);
     thread_ = std::thread(&ClientSession::run, this);
 }
 
-void ClientSession::run() {
-    // 首先从客户端 接收 HELLO 消息并获取昵称
-    MsgType t;
-    std::string p;
-    if (!recvFrame(sock_.load(), t, p) || t != MsgType::HELLO) {
-        // 接收失败或消息类型不对则关闭连接
-        SOCKET s = sock_.exchange(INVALID_SOCKET);
-        if (s != INVALID_SOCKET) closesocket(s);
-        return;
+/**
+ * 写线程：从发送队列取帧并写入套接字，写失败时关闭连接
+ */
+void ClientSession::writeLoop() {
+    OutboundQueue::Wire wire, out;
+    while (outq_.pop(wire)) {
+        out = wire;
+        if (static_cast<MsgType>((*wire)[0]) ==
+            MsgType::SERVER_BROADCAST_TRACED) {
+            out = stampWrite(wire);  // 追踪帧：复制后填入写出时间
+        }
+        if (!sendAll(sock_, out->data(),
+                     static_cast<int>(out->size()))) {
+            forceClose();  // 使处理线程的 recvFrame 失败，走正常离开流程
+            break;
+        }
+        metrics::frameOut(static_cast<uint8_t>((*out)[0]), out->size());
+        // 写出后立即释放：带回执的帧在最后一个引用释放时计为送达
+        out.reset();
+        wire.reset();
     }
-    nickname_ = p;
+    outq_.close();
+    exited_.fetch_add(1, std::memory_order_release);  // 此后不再访问会话
+}
 
-    // 通知所有客户端有新用户加入
-    server_->broadcast(MsgType::USER_JOIN, nickname_, nullptr);
+void ClientSession::run() {
+    // HELLO 已在准入阶段接收，昵称由构造函数传入
+    if (server_->multicast_.enabled()) {
+        server_->sendTo(this, MsgType::MULTICAST_GROUP,
+                        server_->multicast_.groupInfo());
+    }
+    deliverMailbox();
+    onJoin();
 
     // 持续接收客户端消息
     while (true) {
         MsgType type;
         std::string payload;
-        // 当服务端被停止时，sock_ 会被置为 INVALID_SOCKET，从而使 recvFrame
+        // 服务端停止或驱逐本会话时 forceClose 会 shutdown 套接字，使 recvFrame
         // 失败
-        if (!recvFrame(sock_.load(), type, payload))
+        if (!recvFrame(sock_, type, payload))
             break;  // 接收失败则退出循环
-        if (type == MsgType::CHAT) {
-            // 广播聊天消息，格式为 "昵称\n消息内容"
-            std::string combined = nickname_;
-            combined.push_back('\n');
-            combined += payload;
-            server_->broadcast(MsgType::SERVER_BROADCAST, combined, nullptr);
-        } else if (type == MsgType::BYE) {
-            // 客户端断开连接
-            if (!payload.empty()) nickname_ = payload;
-            break;
+        metrics::frameIn(static_cast<uint8_t>(type), 5 + payload.size());
+        inflightBytes_.store(payload.capacity(), std::memory_order_relaxed);
+        bool keep = handleFrame(type, payload);
+        inflightBytes_.store(0, std::memory_order_relaxed);
+        if (!keep) break;
+    }
+
+    onLeave();
+    forceClose();   // 唤醒可能阻塞在 send 中的写线程；句柄在析构中关闭
+    outq_.close();  // 唤醒写线程退出
+    metrics::inc(metrics::SESSIONS_CLOSED);
+    exited_.fetch_add(1, std::memory_order_release);  // 此后不再访问会话
+}
+
+/**
+ * 在追踪帧的副本中填入写出时间，并统计排队耗时
+ * @param wire 共享的 SERVER_BROADCAST_TRACED 帧
+ * @return 本接收者专用的副本
+ */
+OutboundQueue::Wire ClientSession::stampWrite(const OutboundQueue::Wire& wire) {
+    constexpr size_t kHeader = 5 + SEQ_HEADER_SIZE;  // 时间戳头的起点
+    if (wire->size() < kHeader + TRACE_HEADER_SIZE) return wire;
+    auto copy = std::make_shared<std::string>(*wire);
+    uint64_t now = traceNowUs();
+    uint64_t enqueued = getU64(copy->data() + kHeader + 16);
+    setU64(&(*copy)[kHeader + 24], now);
+    if (now >= enqueued)
+        metrics::observe(metrics::TRACE_QUEUE, (now - enqueued) * 1000);
+    return copy;
+}
+
+/**
+ * 投递离线期间的广播：拼接为若干 MAILBOX 帧，最后一帧标记结束
+ * @note 邮箱与上线之间入队的实时帧可能先于离线内容到达，客户端按标记区分
+ */
+void ClientSession::deliverMailbox() {
+    std::string frames = server_->mailbox_.collect(this, mailboxTicket_);
+    mailboxTicket_ = 0;
+    if (frames.empty()) return;
+    std::string batch(1, '\0');
+    size_t pos = 0;
+    while (pos + 5 <= frames.size()) {
+        size_t n = 5 + getU32(frames.data() + pos + 1);
+        if (pos + n > frames.size()) break;
+        // 单帧放不进一批时跳过（只可能是接近上限的超长消息）
+        if (n + 1 <= MAX_PAYLOAD) {
+            if (batch.size() + n > MAX_PAYLOAD) {
+                server_->sendTo(this, MsgType::MAILBOX, batch);
+                batch.assign(1, '\0');
+            }
+            batch.append(frames, pos, n);
         }
+        pos += n;
     }
+    batch[0] = 1;  // 最后一批
+    server_->sendTo(this, MsgType::MAILBOX, batch);
+}
 
-    // 通知所有客户端有用户离开
-    server_->broadcast(MsgType::USER_LEAVE, nickname_, this);
+/**
+ * 通知所有客户端有新用户加入
+ */
+void ClientSession::onJoin() {
+    server_->broadcast(MsgType::USER_JOIN, nickname_, nullptr);
+}
+
+/**
+ * 处理客户端发来的一帧
+ * @param type 消息类型
+ * @param payload 消息负载（BYE 可能携带昵称）
+ * @return 收到 BYE 或协议错误时返回 false
+ */
+bool ClientSession::handleFrame(MsgType type, std::string& payload) {
+    if (type == MsgType::CHAT || type == MsgType::CHAT_TRACED) {
+        // 追踪扩展：只有 CHAT_TRACED 才取时间戳，普通聊天不受影响
+        const bool traced = type == MsgType::CHAT_TRACED;
+        uint64_t sentUs = 0, recvUs = 0;
+        if (traced) {
+            if (payload.size() < 8) return false;
+            recvUs = traceNowUs();
+            sentUs = getU64(payload.data());
+            payload.erase(0, 8);
+        }
+        // 先过滤违禁词，广播与检索索引都只看到过滤后的文本
+        if (server_->filter_.active()) {
+            uint64_t t0 = metrics::nowNs();
+            if (server_->filter_.apply(payload))
+                metrics::inc(metrics::FILTER_MATCHES);
+            metrics::inc(metrics::FILTER_NANOS, metrics::nowNs() - t0);
+            metrics::inc(metrics::FILTER_BYTES, payload.size());
+        }
+        // 广播聊天消息，格式为 "[房间序号]昵称\n消息内容"，序号在提交时填入
+        std::string combined(SEQ_HEADER_SIZE, '\0');
+        if (traced) combined.append(TRACE_HEADER_SIZE, '\0');
+        combined += nickname_;
+        combined.push_back('\n');
+        combined += payload;
+        if (traced) {
+            // 入队时间在广播前填入；写出时间由各接收者的写线程填入
+            uint64_t enqueueUs = traceNowUs();
+            setU64(&combined[SEQ_HEADER_SIZE], sentUs);
+            setU64(&combined[SEQ_HEADER_SIZE + 8], recvUs);
+            setU64(&combined[SEQ_HEADER_SIZE + 16], enqueueUs);
+            if (recvUs >= sentUs)
+                metrics::observe(metrics::TRACE_UPLINK,
+                                 (recvUs - sentUs) * 1000);
+            metrics::observe(metrics::TRACE_PROCESS,
+                             (enqueueUs - recvUs) * 1000);
+        }
+        MsgType out = traced ? MsgType::SERVER_BROADCAST_TRACED
+                             : MsgType::SERVER_BROADCAST;
+        server_->publish(out, combined, receipts_.get(), ++chatSeq_);
+        server_->searchIndex_.add(nickname_, payload);  // 仅入队
+    } else if (type == MsgType::RECEIPTS) {
+        // 开启/关闭消息回执；重新开启时从当前编号之后开始确认
+        if (payload.empty()) return false;
+        uint8_t flags = static_cast<uint8_t>(payload[0]);
+        if (receipts_) receipts_->detach();
+        receipts_.reset();
+        if (flags & RECEIPTS_ON) {
+            receipts_ = std::make_shared<ReceiptTracker>(
+                &server_->receiptBatcher_, &outq_, chatSeq_,
+                (flags & RECEIPTS_DELIVERIES) != 0);
+        }
+    } else if (type == MsgType::MULTICAST_ON) {
+        // 客户端已加入组播组：之后的聊天广播由分发线程改为只经组播发送
+        if (server_->multicast_.enabled())
+            multicast_.store(true, std::memory_order_release);
+    } else if (type == MsgType::NACK) {
+        if (payload.size() < 12) return false;
+        return repair(getU64(payload.data()), getU32(payload.data() + 8));
+    } else if (type == MsgType::SEARCH) {
+        // 检索聊天历史，结果只回复给请求者
+        return server_->sendTo(this, MsgType::SEARCH_RESULT,
+                               searchReply(payload));
+    } else if (type == MsgType::STREAM_BEGIN ||
+               type == MsgType::STREAM_CHUNK || type == MsgType::STREAM_END) {
+        return relayStream(type, payload);
+    } else if (type == MsgType::BYE) {
+        // 客户端断开连接
+        if (!payload.empty()) nickname_ = std::move(payload);
+        return false;
+    }
+    return true;
+}
 
-    // 从服务器移除当前对话并关闭连接
+/**
+ * 中止未完成的流，通知所有客户端有用户离开，并从服务器移除当前会话
+ */
+void ClientSession::onLeave() {
+    abortStreams();
+    server_->broadcast(MsgType::USER_LEAVE, nickname_, this);
     server_->removeClient(this);
-    {
-        // 将套接字设置为 INVALID_SOCKET
-        SOCKET s = sock_.exchange(INVALID_SOCKET);
-        // 如果原来的不是 INVALID_SOCKET
-        if (s != INVALID_SOCKET)
-            closesocket(s);  // 关闭客户端的通信套接字，释放资源
+}
+
+/**
+ * 转发流帧：重新分配服务端流编号后广播给其他客户端
+ * @param type STREAM_BEGIN / STREAM_CHUNK / STREAM_END
+ * @param payload 帧负载
+ * @return 协议错误（未知流、流过多、负载过短、分片超过 STREAM_CHUNK_SIZE）时
+ *         返回 false
+ */
+bool ClientSession::relayStream(MsgType type, const std::string& payload) {
+    if (payload.size() < 4) return false;
+    uint32_t clientId = getU32(payload.data());
+    std::string out;
+    if (type == MsgType::STREAM_BEGIN) {
+        if (payload.size() < 12 || streams_.count(clientId) ||
+            streams_.size() >= kMaxStreams)
+            return false;
+        uint32_t id = server_->nextStreamId_.fetch_add(1);
+        if (id == 0) id = server_->nextStreamId_.fetch_add(1);  // 0 保留
+        streams_.emplace(clientId, id);
+        // [流编号][总长度][from + '\n' + 名称]
+        putU32(out, id);
+        out.append(payload, 4, 8);
+        out += nickname_;
+        out.push_back('\n');
+        out.append(payload, 12, std::string::npos);
+        if (out.size() > MAX_PAYLOAD) return false;
+        server_->broadcastStream(id, MsgType::SERVER_STREAM_BEGIN, out, this);
+        return true;
+    }
+
+    auto it = streams_.find(clientId);
+    if (it == streams_.end()) return false;
+    if (type == MsgType::STREAM_CHUNK &&
+        payload.size() - 4 > STREAM_CHUNK_SIZE)
+        return false;
+    uint32_t id = it->second;
+    putU32(out, id);
+    out.append(payload, 4, std::string::npos);
+    if (type == MsgType::STREAM_CHUNK) {
+        server_->throttleStream(this);
+        server_->broadcastStream(id, MsgType::SERVER_STREAM_CHUNK, out, this);
+    } else {
+        if (out.size() < 5) out.push_back(0);  // 缺省状态为完成
+        server_->broadcastStream(id, MsgType::SERVER_STREAM_END, out, this);
+        streams_.erase(it);
     }
+    return true;
 }
 
-void ClientSession::forceClose() {
-    // 原子交换句柄，确保只关闭一次
-    SOCKET s = sock_.exchange(INVALID_SOCKET);
-    if (s != INVALID_SOCKET) {
-        shutdown(s, SD_BOTH);  // 关闭连接
-        closesocket(s);        // 关闭原来的套接字，释放资源
+/**
+ * 连接结束时向接收方发送中止状态的 SERVER_STREAM_END
+ */
+void ClientSession::abortStreams() {
+    for (const auto& [clientId, id] : streams_) {
+        std::string out;
+        putU32(out, id);
+        out.push_back(1);  // 中止
+        server_->broadcastStream(id, MsgType::SERVER_STREAM_END, out, this);
+    }
+    streams_.clear();
+}
+
+/**
+ * 经 TCP 补发组播丢失的聊天广播
+ * @param first 起始房间序号
+ * @param count 条数（单次至多 kMaxRepairFrames）
+ * @return 入队失败（队列已关闭或积压过多）时返回 false
+ * @note 补发的是原帧，与正常路径相同；已淘汰的部分回复 REPAIR_LOST
+ */
+bool ClientSession::repair(uint64_t first, uint32_t count) {
+    count = std::min(count, kMaxRepairFrames);
+    std::vector<OutboundQueue::Wire> frames;
+    uint32_t lost = server_->multicast_.collect(first, count, frames);
+    if (lost > 0) {
+        std::string p;
+        putU64(p, first);
+        putU32(p, lost);
+        metrics::inc(metrics::MCAST_LOST, lost);
+        if (!server_->sendTo(this, MsgType::REPAIR_LOST, p)) return false;
+    }
+    // 补发至多占用发送队列剩余额度的一半，其余留给实时消息；
+    // 放不下的部分由客户端在重传间隔后再次请求，不会因补发把请求者挤出
+    size_t budget = outq_.spareBytes() / 2;
+    size_t pushed = 0;
+    for (const auto& w : frames) {
+        if (w->size() > budget) break;
+        budget -= w->size();
+        if (!outq_.push(w)) return false;
+        ++pushed;
+    }
+    metrics::inc(metrics::MCAST_REPAIRS, pushed);
+    return true;
+}
+
+/**
+ * 执行检索并组装 SEARCH_RESULT 负载
+ * @param query 查询文本
+ * @return 以 '\0' 分隔的 from + '\n' + text 记录，不超过 MAX_PAYLOAD
+ */
+std::string ClientSession::searchReply(const std::string& query) const {
+    constexpr size_t kMaxHits = 20;  // 单次检索最多返回条数
+    std::string out;
+    for (const auto& hit : server_->searchIndex_.search(query, kMaxHits)) {
+        size_t need = hit.from.size() + 1 + hit.text.size() + 1;
+        if (out.size() + need > MAX_PAYLOAD) break;
+        if (!out.empty()) out.push_back('\0');
+        out += hit.from;
+        out.push_back('\n');
+        out += hit.text;
     }
+    return out;
+}
+
+void ClientSession::forceClose() {
+    if (sock_ == INVALID_SOCKET || shutDown_.exchange(true)) return;
+    // 只 shutdown 不关闭句柄：写线程可能正在使用它，关闭后句柄值可能被新连接复用
+    shutdown(sock_, SD_BOTH);
+#ifdef _WIN32
+    // shutdown 不一定能唤醒已阻塞的 recv/send，取消该套接字上未完成的 I/O
+    CancelIoEx(reinterpret_cast<HANDLE>(sock_), nullptr);
+#endif
 }
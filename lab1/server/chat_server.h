@@ -2,17 +2,36 @@
 
 #include <winsock2.h>
 #include <ws2tcpip.h>
+// AF_UNIX 支持（Windows 10 1803+）
+#include <afunix.h>
 
+#include <algorithm>
 #include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
+#include "admission.h"
 #include "common/protocol.h"
+#include "content_filter.h"
+#include "fanout_pool.h"
+#include "mailbox.h"
+#include "memory_governor.h"
+#include "metrics.h"
+#include "multicast.h"
+#include "outbound_queue.h"
+#include "receipts.h"
+#include "search_index.h"
 
 class ClientSession;
+class Simulation;
 /**
  * 多线程 TCP 聊天服务端类
  */
@@ -21,24 +40,163 @@ class ChatServer {
     ChatServer() = default;  // 默认构造函数
     ~ChatServer() { stop(); }
 
+    // 握手准入配置，需在 start 之前设置
+    void setAdmissionConfig(const HandshakeAdmission::Config& cfg) {
+        admissionCfg_ = cfg;
+    }
+
+    // 额外监听的 Unix 域套接字路径（空表示不启用），需在 start 之前设置
+    void setUnixSocketPath(const std::string& path) { unixPath_ = path; }
+
+    // 指标导出端口（仅监听 127.0.0.1，0 表示不启用），需在 start 之前设置
+    void setMetricsPort(uint16_t port) { metricsPort_ = port; }
+
+    // 离线邮箱配置（spillDir 为空表示不启用），需在 start 之前设置
+    void setMailboxConfig(const Mailbox::Config& cfg) { mailboxCfg_ = cfg; }
+
+    // 广播分发线程数（含分发线程本身，默认为 CPU 核数，至少 1；0 表示在发送者
+    // 线程上同步分发，仍按提交顺序逐个执行），需在 start 之前设置
+    void setFanoutThreads(size_t n) { fanoutThreads_ = n; }
+
+    // 全局内存上限与降级顺序（limitBytes 为 0 表示不启用），需在 start 之前设置
+    void setMemoryConfig(const MemoryGovernor::Config& cfg) {
+        memoryCfg_ = cfg;
+    }
+
+    // 局域网组播分发（group 为空表示不启用），需在 start 之前设置
+    void setMulticastConfig(const MulticastPublisher::Config& cfg) {
+        multicastCfg_ = cfg;
+    }
+
     bool start(uint16_t port);
     void stop();
 
+    // 加载违禁词表，可在运行中重复调用（不暂停收发）；文件无法打开时返回 false
+    bool loadFilter(const std::string& path) { return filter_.load(path); }
+    const ContentFilter& filter() const { return filter_; }
+
     // 广播到所有客户端
     void broadcast(chatproto::MsgType type, const std::string& payload,
                    ClientSession* exclude = nullptr);
+    // 广播流帧：进入各客户端的流队列，与普通帧公平交错发送
+    void broadcastStream(uint32_t streamId, chatproto::MsgType type,
+                         const std::string& payload,
+                         ClientSession* exclude = nullptr);
 
    private:
+    // 监听套接字：TCP 或 Unix 域，接受后的连接对会话完全透明
+    struct Listener {
+        SOCKET sock;
+        int family;
+    };
+
+    // 待分发的广播
+    struct FanoutJob {
+        OutboundQueue::Wire wire;
+        ClientSession* exclude;
+        uint32_t streamId;
+    };
+
     friend class ClientSession;  // 允许会话通知服务器移除自身
+    friend class Simulation;     // 仿真模式直接驱动会话逻辑
     void acceptLoop();           // 接受连接循环
+    // 批量接受新连接
+    void acceptBatch(const Listener& l, HandshakeAdmission& admission);
+    void closeListeners();  // 关闭所有监听套接字
+    void admit(HandshakeAdmission::Admitted&& a);  // 握手完成，创建会话
+    // 创建会话并加入客户端列表（不启动线程）
+    ClientSession* attach(SOCKET s, std::string nickname);
+    // 释放已移出列表的会话：先全部强制关闭，再交给 accept 线程 delete
+    void dispose(std::vector<ClientSession*>& sessions);
+    void retire(ClientSession* c);  // 登记待 delete 的会话
+    // delete 已登记的会话：all 为 false 时只处理线程均已退出的会话
+    void reapRetired(bool all);
     void removeClient(ClientSession* c);  // 移除客户端会话
+    // 获取 clientsMtx_ 并记录等待耗时
+    std::unique_lock<std::mutex> lockClients();
+    // 生成指标文本：累计计数器 + 采集时的队列深度
+    std::string renderMetrics();
+    // 内存占用估算：各会话 + 检索历史 + 离线邮箱 + 待握手与待分发的数据
+    size_t memoryUsage();
+    // 断开占用内存最多的会话，返回其占用（没有会话时返回 0）
+    size_t shedHeaviest();
+    // 上传方节流：其他会话的流积压过多时等待（在上传者的处理线程上调用）
+    void throttleStream(ClientSession* uploader);
+    // 向单个客户端发送（入队，由其写线程发送）
+    bool sendTo(ClientSession* c, chatproto::MsgType type,
+                const std::string& payload);
+    // 交给分发线程（未启用时直接调用 fanout）
+    void dispatch(const OutboundQueue::Wire& wire, ClientSession* exclude,
+                  uint32_t streamId);
+    // 广播聊天消息：提交时分配房间序号；receipts 非空时按编号 id 跟踪回执
+    void publish(chatproto::MsgType type, const std::string& payload,
+                 ReceiptTracker* receipts, uint64_t id);
+    // 等待分发队列有空位，返回持有的 fanoutMtx_
+    std::unique_lock<std::mutex> waitFanoutSpace();
+    // 提交一个广播并释放 lock：入队给分发线程，未启用时由调用者执行队列
+    void submit(std::unique_lock<std::mutex>& lock, FanoutJob job);
+    void fanoutLoop();  // 分发线程：按提交顺序逐个执行广播
+    // 持 fanoutOrderMtx_ 按提交顺序执行队列中的广播，直到队列为空
+    void drainFanout();
+    // 将已编码的帧放入所有客户端的队列；streamId 为 0 表示普通帧
+    void fanout(const OutboundQueue::Wire& wire, ClientSession* exclude,
+                uint32_t streamId);
+    // fanout 的大房间版本：在 clientsMtx_ 外按接收者区间并行入队
+    void fanoutParallel(std::unique_lock<std::mutex>& lock,
+                        const OutboundQueue::Wire& wire,
+                        ClientSession* exclude, uint32_t streamId,
+                        uint64_t seq, std::vector<ClientSession*>& toRemove);
 
    private:
-    SOCKET listenSock_{INVALID_SOCKET};    // 监听套接字
+    // 接收者达到该数量时按区间并行分发
+    static constexpr size_t kParallelFanoutMin = 1024;
+    // 并行分发时不再拆分的区间大小
+    static constexpr size_t kFanoutGrain = 256;
+    // 待分发广播的上限，超过时发送者等待（恢复背压）
+    static constexpr size_t kMaxFanoutJobs = 4096;
+    // 消息回执的合并周期（毫秒）：每个会话每周期至多一帧 RECEIPT
+    static constexpr int kReceiptIntervalMs = 5;
+
+    std::vector<Listener> listeners_;      // 监听套接字
+    std::string unixPath_;                 // Unix 域套接字路径
+    uint64_t unixAccepted_{0};             // 已接受的 Unix 域连接数（accept 线程）
     std::thread acceptThread_;             // 服务器接受线程
     std::vector<ClientSession*> clients_;  // 活动客户端列表
     std::mutex clientsMtx_;                // 保护客户端列表的互斥锁
     std::atomic<bool> running_{false};     // 服务器运行状态
+    HandshakeAdmission::Config admissionCfg_{};  // 握手准入配置
+    SearchIndex searchIndex_;                    // 聊天历史检索索引
+    ContentFilter filter_;                       // 违禁词过滤
+    std::atomic<uint32_t> nextStreamId_{1};      // 服务端流编号分配
+    uint16_t metricsPort_{0};                    // 指标导出端口
+    metrics::Exporter metricsExporter_;          // 指标 HTTP 端点
+    Mailbox::Config mailboxCfg_{};               // 离线邮箱配置
+    Mailbox mailbox_;                            // 离线用户的聊天广播
+    size_t fanoutThreads_{std::max(1u, std::thread::hardware_concurrency())};
+    std::thread fanoutThread_;                   // 广播分发线程
+    std::mutex fanoutMtx_;                       // 保护分发队列
+    std::condition_variable fanoutCv_;           // 有新的广播
+    std::condition_variable fanoutSpaceCv_;      // 分发队列有空位
+    std::deque<FanoutJob> fanoutJobs_;           // 待分发的广播
+    // 串行执行 fanout：同步分发时多个发送者线程也按房间序号顺序入队
+    std::mutex fanoutOrderMtx_;
+    bool fanoutRunning_{false};                  // 分发线程是否运行
+    uint64_t roomSeq_{0};  // 最近分配的房间序号（受 fanoutMtx_ 保护）
+    FanoutPool fanoutPool_;                      // 大房间并行分发
+    std::vector<ClientSession*> fanoutTargets_;  // 并行分发的接收者快照
+    std::vector<uint8_t> fanoutFailed_;  // 并行分发时入队失败的下标
+    // 共享：分发线程在 clientsMtx_ 外访问接收者快照；独占：delete 会话之前
+    std::shared_mutex sessionRefsMtx_;
+    std::mutex retiredMtx_;                 // 保护 retired_
+    std::vector<ClientSession*> retired_;  // 已移出列表、待 delete 的会话
+    MemoryGovernor::Config memoryCfg_{};  // 全局内存上限配置
+    MemoryGovernor memoryGovernor_;       // 超限时按顺序降级
+    ReceiptBatcher receiptBatcher_;       // 合并发送消息回执
+    MulticastPublisher::Config multicastCfg_{};  // 组播配置
+    MulticastPublisher multicast_;               // 组播分发与补发环
+    std::atomic<size_t> pendingHandshakes_{0};   // 待握手连接数
+    // 仿真模式接管会话释放：返回 true 表示由回调负责 delete
+    std::function<bool(ClientSession*)> disposeHook_;
 };
 
 /**
@@ -46,23 +204,93 @@ class ChatServer {
  */
 class ClientSession {
    public:
-    ClientSession(ChatServer* server, SOCKET s) : server_(server), sock_(s) {}
+    // 会话仅在准入阶段收到 HELLO 之后创建
+    ClientSession(ChatServer* server, SOCKET s, std::string nickname)
+        : server_(server), sock_(s), nickname_(std::move(nickname)) {}
     ~ClientSession();
 
     void start();
-    // 从外部请求关闭：唤醒阻塞并安全关闭套接字
+    // 请求关闭：shutdown 套接字使两个线程的阻塞收发失败（句柄在析构中关闭）
     void forceClose();
 
-    SOCKET sock() const { return sock_.load(); }
+    // 放入发送队列（队列已满或已关闭时返回 false）
+    bool enqueue(const OutboundQueue::Wire& wire) { return outq_.push(wire); }
+    bool enqueueStream(uint32_t streamId, const OutboundQueue::Wire& wire) {
+        return outq_.pushStream(streamId, wire);
+    }
+    // 放入房间序号为 seq 的聊天广播；已改经组播接收时只在切换处发送
+    // MULTICAST_START（仅分发路径调用，同一会话不会并发）
+    bool enqueueChat(const OutboundQueue::Wire& wire, uint64_t seq);
+
+    SOCKET sock() const { return sock_; }
+    // 当前是否在本会话的处理线程上
+    bool onOwnThread() const {
+        return thread_.get_id() == std::this_thread::get_id();
+    }
+    // 处理线程与写线程均已退出，delete 不会阻塞
+    bool exited() const {
+        return exited_.load(std::memory_order_acquire) == 2;
+    }
+    size_t queuedBytes() const { return outq_.queuedBytes(); }
+    size_t streamQueuedBytes() const { return outq_.streamQueuedBytes(); }
+    // 归属本会话的内存：固定开销 + 正在处理的帧 + 发送队列
+    size_t memoryBytes() const {
+        return kSessionBaseBytes + outq_.queuedBytes() +
+               inflightBytes_.load(std::memory_order_relaxed);
+    }
     const std::string& nickname() const { return nickname_; }
 
    private:
+    friend class ChatServer;  // attach 时登记邮箱凭据
+    friend class Simulation;  // 仿真模式不启动线程，直接调用以下步骤
+
     void run();
+    void deliverMailbox();  // 投递离线期间的广播（MAILBOX 帧）
+    void writeLoop();  // 写线程：按队列顺序发送
+    // 追踪帧：复制一份并填入写出时间
+    static OutboundQueue::Wire stampWrite(const OutboundQueue::Wire& wire);
+    void onJoin();     // 握手后：广播加入
+    // 处理一帧；返回 false 表示会话应结束
+    bool handleFrame(chatproto::MsgType type, std::string& payload);
+    void onLeave();  // 结束时：中止流、广播离开、移出客户端列表
+    std::string searchReply(const std::string& query) const;  // 检索应答
+    // 经 TCP 补发组播丢失的聊天广播，受发送队列剩余额度限制；队列已关闭时返回 false
+    bool repair(uint64_t first, uint32_t count);
+    // 处理 STREAM_* 帧并转发；协议错误时返回 false
+    bool relayStream(chatproto::MsgType type, const std::string& payload);
+    void abortStreams();  // 连接结束时中止未完成的流
 
    private:
+    // 单个客户端发送队列中普通帧的字节上限，超过则视为慢消费者并断开
+    static constexpr size_t kMaxQueuedBytes = 8 * 1024 * 1024;
+    // 流帧积压达到该值时暂停读取上传者的数据（上传方节流）
+    static constexpr size_t kStreamBudgetBytes = 4 * 1024 * 1024;
+    // 流帧的字节上限（节流之外的兜底，超过即断开）
+    static constexpr size_t kMaxStreamQueuedBytes = 32 * 1024 * 1024;
+    // 上传方节流的最长等待（毫秒）：届时流积压仍未降下来的接收者被断开
+    static constexpr int kStreamStallMs = 5000;
+    // 单个连接同时进行的流数量上限
+    static constexpr size_t kMaxStreams = 4;
+    // 每个会话的固定开销估算：会话对象、两个线程栈已提交的部分、流映射等
+    static constexpr size_t kSessionBaseBytes = 128 * 1024;
+    // 单个 NACK 最多补发的条数
+    static constexpr uint32_t kMaxRepairFrames = 1024;
+
     ChatServer* server_{};  // 所属服务器指针
-    std::atomic<SOCKET> sock_{
-        INVALID_SOCKET};    // 客户端套接字（原子，避免竞态）
+    // 客户端套接字：写线程退出后才在析构中关闭，句柄在会话存续期间不会被复用
+    SOCKET sock_{INVALID_SOCKET};
+    std::atomic<bool> shutDown_{false};  // 已 shutdown（forceClose 只执行一次）
     std::thread thread_;    // 处理线程
+    std::thread writer_;    // 写线程
     std::string nickname_;  // 客户端昵称
+    OutboundQueue outq_{kMaxQueuedBytes, kMaxStreamQueuedBytes};  // 发送队列
+    // 客户端流编号 -> 服务端流编号（仅处理线程访问）
+    std::unordered_map<uint32_t, uint32_t> streams_;
+    uint64_t mailboxTicket_{0};  // 上线时邮箱返回的凭据（0 表示无）
+    uint64_t chatSeq_{0};  // 已处理的 CHAT/CHAT_TRACED 数（即最新消息编号）
+    std::shared_ptr<ReceiptTracker> receipts_;  // 消息回执（未开启时为空）
+    std::atomic<bool> multicast_{false};  // 客户端已加入组播组
+    bool multicastStarted_{false};  // 已发送 MULTICAST_START（仅分发路径访问）
+    std::atomic<size_t> inflightBytes_{0};  // 正在处理的入站帧负载
+    std::atomic<int> exited_{0};  // 已退出的线程数（处理线程、写线程）
 };
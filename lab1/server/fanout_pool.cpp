@@ -0,0 +1,147 @@
+#include "fanout_pool.h"
+
+/**
+ * 启动工作线程
+ * @param workers 工作线程数；0 表示 parallelFor 只在调用线程上执行
+ */
+void FanoutPool::start(size_t workers) {
+    if (!threads_.empty()) return;
+    stopping_ = false;
+    lanes_.clear();
+    for (size_t i = 0; i <= workers; ++i)
+        lanes_.push_back(std::make_unique<Lane>());
+    for (size_t i = 1; i <= workers; ++i)
+        threads_.emplace_back(&FanoutPool::workerLoop, this, i);
+}
+
+/**
+ * 停止并等待所有工作线程退出
+ */
+void FanoutPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stopping_ = true;
+    }
+    wakeCv_.notify_all();
+    for (auto& t : threads_) {
+        if (t.joinable()) t.join();
+    }
+    threads_.clear();
+}
+
+/**
+ * 并行执行区间任务
+ * @param n 下标总数
+ * @param grain 不再拆分的区间大小
+ * @param fn 区间回调，可能在多个线程上并发调用（区间互不重叠）
+ */
+void FanoutPool::parallelFor(size_t n, size_t grain, const RangeFn& fn) {
+    if (n == 0) return;
+    if (threads_.empty() || n <= grain) {
+        fn(0, n);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        fn_ = &fn;
+        grain_ = grain > 0 ? grain : 1;
+        remaining_.store(n, std::memory_order_relaxed);
+        ++jobSeq_;
+    }
+    // 区间最后放入：其他线程经由队列锁取得区间时，fn_ 已对其可见
+    pushRange(0, {0, n});
+    wakeCv_.notify_all();
+    drain(0);
+    // 等待工作线程全部离开本任务，fn 的生命周期到此结束
+    std::unique_lock<std::mutex> lock(mtx_);
+    doneCv_.wait(lock, [this] { return busy_ == 0; });
+    fn_ = nullptr;
+}
+
+void FanoutPool::workerLoop(size_t lane) {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mtx_);
+            wakeCv_.wait(lock, [&] { return stopping_ || jobSeq_ != seen; });
+            if (stopping_) return;
+            seen = jobSeq_;
+            ++busy_;
+        }
+        drain(lane);
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            --busy_;
+        }
+        doneCv_.notify_one();
+    }
+}
+
+/**
+ * 执行当前任务直到没有剩余下标
+ * 取不到区间时（剩余区间正被其他线程执行）阻塞等待新拆分出的区间或任务结束
+ */
+void FanoutPool::drain(size_t lane) {
+    Range r;
+    while (remaining_.load(std::memory_order_acquire) > 0) {
+        uint64_t seq;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            seq = rangeSeq_;
+        }
+        if (!popLocal(lane, r) && !steal(lane, r)) {
+            std::unique_lock<std::mutex> lock(mtx_);
+            ++idle_;
+            rangeCv_.wait(lock, [&] {
+                return rangeSeq_ != seq ||
+                       remaining_.load(std::memory_order_acquire) == 0;
+            });
+            --idle_;
+            continue;
+        }
+        // 大区间对半拆分：后半放回本线程队尾，可被窃取
+        while (r.end - r.begin > grain_) {
+            size_t mid = r.begin + (r.end - r.begin) / 2;
+            pushRange(lane, {mid, r.end});
+            r.end = mid;
+        }
+        (*fn_)(r.begin, r.end);
+        size_t n = r.end - r.begin;
+        if (remaining_.fetch_sub(n, std::memory_order_acq_rel) == n) {
+            // 最后一个区间：唤醒等待区间的线程退出
+            std::lock_guard<std::mutex> lock(mtx_);
+            if (idle_ > 0) rangeCv_.notify_all();
+        }
+    }
+}
+
+void FanoutPool::pushRange(size_t lane, Range r) {
+    {
+        std::lock_guard<std::mutex> lock(lanes_[lane]->mtx);
+        lanes_[lane]->ranges.push_back(r);
+    }
+    std::lock_guard<std::mutex> lock(mtx_);
+    ++rangeSeq_;
+    if (idle_ > 0) rangeCv_.notify_one();
+}
+
+bool FanoutPool::popLocal(size_t lane, Range& r) {
+    Lane& l = *lanes_[lane];
+    std::lock_guard<std::mutex> lock(l.mtx);
+    if (l.ranges.empty()) return false;
+    r = l.ranges.back();
+    l.ranges.pop_back();
+    return true;
+}
+
+bool FanoutPool::steal(size_t lane, Range& r) {
+    for (size_t k = 1; k < lanes_.size(); ++k) {
+        Lane& l = *lanes_[(lane + k) % lanes_.size()];
+        std::lock_guard<std::mutex> lock(l.mtx);
+        if (l.ranges.empty()) continue;
+        r = l.ranges.front();
+        l.ranges.pop_front();
+        return true;
+    }
+    return false;
+}
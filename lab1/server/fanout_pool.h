@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * 广播分发用的工作窃取线程池
+ * - parallelFor 把下标区间交给调用线程与各工作线程共同执行，调用线程也参与
+ * - 每个线程有自己的区间双端队列：取到大区间时对半拆分，后半放回队尾，
+ *   自己继续处理前半；空闲线程从其他队列的队头窃取（通常是最大的区间）
+ * - 同一时刻只执行一个 parallelFor（由单个分发线程调用）
+ */
+class FanoutPool {
+   public:
+    using RangeFn = std::function<void(size_t begin, size_t end)>;
+
+    FanoutPool() = default;
+    ~FanoutPool() { stop(); }
+
+    FanoutPool(const FanoutPool&) = delete;
+    FanoutPool& operator=(const FanoutPool&) = delete;
+
+    void start(size_t workers);  // 工作线程数（不含调用线程）
+    void stop();
+    size_t workers() const { return threads_.size(); }
+
+    // 对 [0, n) 执行 fn，区间不小于 grain 时继续拆分；返回时全部执行完毕
+    void parallelFor(size_t n, size_t grain, const RangeFn& fn);
+
+   private:
+    struct Range {
+        size_t begin, end;
+    };
+    // 每个线程的区间队列；队尾由所属线程使用，队头供其他线程窃取
+    struct Lane {
+        std::mutex mtx;
+        std::deque<Range> ranges;
+    };
+
+    void workerLoop(size_t lane);
+    void drain(size_t lane);  // 执行当前任务直到没有剩余下标
+    void pushRange(size_t lane, Range r);  // 放入本线程队尾并唤醒空闲线程
+    bool popLocal(size_t lane, Range& r);
+    bool steal(size_t lane, Range& r);
+
+   private:
+    std::vector<std::unique_ptr<Lane>> lanes_;  // 0 号为调用线程
+    std::vector<std::thread> threads_;
+
+    std::mutex mtx_;
+    std::condition_variable wakeCv_;  // 新任务或停止
+    std::condition_variable doneCv_;  // 工作线程退出当前任务
+    std::condition_variable rangeCv_;  // 有新区间可窃取或剩余下标归零
+    uint64_t rangeSeq_{0};  // 放入区间的次数
+    size_t idle_{0};        // 在 rangeCv_ 上等待的线程数
+    uint64_t jobSeq_{0};
+    size_t busy_{0};  // 正在执行当前任务的工作线程数
+    bool stopping_{false};
+
+    const RangeFn* fn_{nullptr};
+    size_t grain_{1};
+    std::atomic<size_t> remaining_{0};  // 尚未执行的下标数
+};
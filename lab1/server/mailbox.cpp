@@ -0,0 +1,387 @@
+#include "mailbox.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+#include "common/protocol.h"
+#include "metrics.h"
+#include "receipts.h"
+
+using namespace chatproto;
+namespace fs = std::filesystem;
+
+/**
+ * 启动邮箱；清理上次运行遗留的落盘文件
+ * @param cfg 配置
+ * @return 目录无法创建时返回 false
+ */
+bool Mailbox::start(const Config& cfg) {
+    if (running_.load()) return true;
+    if (cfg.spillDir.empty()) return false;
+    std::error_code ec;
+    fs::create_directories(cfg.spillDir, ec);
+    if (!fs::is_directory(cfg.spillDir, ec)) return false;
+    for (const auto& entry : fs::directory_iterator(cfg.spillDir, ec)) {
+        if (entry.path().extension() == ".mbx") fs::remove(entry.path(), ec);
+    }
+    cfg_ = cfg;
+    running_.store(true);
+    thread_ = std::thread(&Mailbox::loop, this);
+    return true;
+}
+
+/**
+ * 停止邮箱线程；未投递的内容随之丢弃
+ */
+void Mailbox::stop() {
+    if (!running_.exchange(false)) return;
+    queueCv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+    {
+        std::lock_guard<std::mutex> lock(doneMtx_);
+        doneCv_.notify_all();  // 唤醒仍在 collect 中等待的会话
+    }
+    std::error_code ec;
+    for (const auto& [nick, box] : boxes_) {
+        if (!box.file.empty()) fs::remove(box.file, ec);
+    }
+    boxes_.clear();
+    lru_.clear();
+    log_.clear();
+    logBytes_ = 0;
+    memBytes_.store(0);
+}
+
+uint64_t Mailbox::push(Event&& e) {
+    uint64_t seq;
+    {
+        std::lock_guard<std::mutex> lock(queueMtx_);
+        seq = e.seq = nextSeq_++;
+        queue_.push_back(std::move(e));
+    }
+    queueCv_.notify_one();
+    return seq;
+}
+
+/**
+ * 会话上线
+ * @param session 会话（仅作标识）
+ * @param nickname 昵称
+ * @return collect 所需的凭据
+ */
+uint64_t Mailbox::online(const void* session, const std::string& nickname) {
+    if (!enabled()) return 0;
+    return push({Event::ONLINE, nullptr, session, nickname, 0});
+}
+
+/**
+ * 会话下线
+ * @param session 会话（仅作标识）
+ */
+void Mailbox::offline(const void* session) {
+    if (!enabled()) return;
+    pendingOffline_.fetch_add(1, std::memory_order_relaxed);
+    push({Event::OFFLINE, nullptr, session, std::string(), 0});
+}
+
+/**
+ * 会话被丢弃：注销会话，但不新建邮箱，内存紧张时不再为其积累广播
+ * @param session 会话（仅作标识）
+ * @note 未领取的离线内容一并丢弃
+ */
+void Mailbox::drop(const void* session) {
+    if (!enabled()) return;
+    push({Event::DROP, nullptr, session, std::string(), 0});
+}
+
+/**
+ * 广播帧入队
+ * @param wire 已编码的帧（与会话队列共享）
+ */
+void Mailbox::post(const Wire& wire) {
+    if (offlineBoxes_.load(std::memory_order_relaxed) == 0 &&
+        pendingOffline_.load(std::memory_order_relaxed) == 0)
+        return;  // 没有离线用户：广播路径只多这一次判断
+    if (!enabled()) return;
+    auto type = static_cast<MsgType>((*wire)[0]);
+    if (type != MsgType::SERVER_BROADCAST &&
+        type != MsgType::SERVER_BROADCAST_TRACED)
+        return;
+    // 带回执的帧改存副本：离线用户不推迟发送者的送达回执
+    Wire kept = ReceiptTracker::tracked(wire)
+                    ? std::make_shared<const std::string>(*wire)
+                    : wire;
+    bool dropped = false;
+    uint64_t report = 0;  // 需要记日志时为本轮丢弃的条数
+    {
+        std::lock_guard<std::mutex> lock(queueMtx_);
+        if (pendingWires_ >= cfg_.maxPendingFrames) {  // 邮箱线程落后
+            dropped = true;
+            ++droppedSinceLog_;
+            uint64_t now = metrics::nowNs();
+            if (now - dropLogNs_ >= kDropLogIntervalNs) {
+                report = droppedSinceLog_;
+                droppedSinceLog_ = 0;
+                dropLogNs_ = now;
+            }
+        } else {
+            ++pendingWires_;
+            queue_.push_back(
+                {Event::WIRE, std::move(kept), nullptr, std::string(), 0});
+        }
+    }
+    if (dropped) {
+        metrics::inc(metrics::MAILBOX_DROPPED);
+        if (report > 0) {
+            std::cerr << "Mailbox fell behind (" << cfg_.maxPendingFrames
+                      << " frames pending), dropped " << report
+                      << " offline messages" << std::endl;
+        }
+        return;
+    }
+    queueCv_.notify_one();
+}
+
+/**
+ * 领取离线期间的帧
+ * @param session 会话
+ * @param ticket online 返回的凭据
+ * @return 完整帧按时间顺序拼接；没有时为空
+ */
+std::string Mailbox::collect(const void* session, uint64_t ticket) {
+    if (ticket == 0) return std::string();
+    Taken taken;
+    {
+        std::unique_lock<std::mutex> lock(doneMtx_);
+        doneCv_.wait(lock, [&] { return doneSeq_ >= ticket || !enabled(); });
+        auto it = ready_.find(session);
+        if (it == ready_.end()) return std::string();
+        taken = std::move(it->second);
+        ready_.erase(it);
+    }
+
+    // 在会话线程上读盘，不占用邮箱线程
+    std::string out;
+    if (!taken.file.empty()) {
+        std::ifstream in(taken.file, std::ios::binary);
+        out.resize(taken.fileBytes);
+        in.read(&out[0], static_cast<std::streamsize>(taken.fileBytes));
+        out.resize(static_cast<size_t>(in.gcount()));
+        in.close();
+        std::error_code ec;
+        fs::remove(taken.file, ec);
+    }
+    for (const auto& w : taken.frames) out += *w;
+
+    // 磁盘与内存合计超出单用户上限时，丢弃最旧的帧
+    size_t pos = 0;
+    while (out.size() - pos > cfg_.perUserBytes && out.size() - pos >= 5) {
+        pos += 5 + getU32(out.data() + pos + 1);
+    }
+    if (pos > 0) out.erase(0, std::min(pos, out.size()));
+    return out;
+}
+
+/**
+ * 邮箱线程：按入队顺序处理上线、下线与广播帧
+ */
+void Mailbox::loop() {
+    std::deque<Event> batch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(queueMtx_);
+            queueCv_.wait(lock, [this] {
+                return !queue_.empty() || !running_.load();
+            });
+            if (!running_.load()) return;
+            batch.swap(queue_);
+            pendingWires_ = 0;
+        }
+        for (auto& e : batch) {
+            switch (e.kind) {
+                case Event::WIRE: onWire(e.wire); break;
+                case Event::ONLINE: onOnline(e.session, e.nickname); break;
+                case Event::OFFLINE: onOffline(e.session, true); break;
+                case Event::DROP: onOffline(e.session, false); break;
+            }
+            if (e.kind == Event::ONLINE) {
+                std::lock_guard<std::mutex> lock(doneMtx_);
+                doneSeq_ = e.seq;
+                doneCv_.notify_all();
+            }
+        }
+        batch.clear();
+    }
+}
+
+void Mailbox::onWire(const Wire& wire) {
+    if (boxes_.empty()) return;
+    log_.push_back(wire);
+    logBytes_ += wire->size();
+    memBytes_.fetch_add(wire->size(), std::memory_order_relaxed);
+    trimLog();
+    // 超出内存预算：从最早下线（或最早落盘）的邮箱开始落盘
+    for (size_t k = lru_.size();
+         k > 0 && memBytes_.load(std::memory_order_relaxed) > cfg_.memoryBudget;
+         --k) {
+        std::string nickname = lru_.front();
+        if (!spill(nickname, boxes_[nickname])) break;
+    }
+}
+
+void Mailbox::onOnline(const void* session, const std::string& nickname) {
+    sessions_[session] = nickname;
+    ++onlineCount_[nickname];
+    auto it = boxes_.find(nickname);
+    if (it == boxes_.end()) return;
+
+    Box& box = it->second;
+    memBytes_.fetch_sub(box.ownBytes, std::memory_order_relaxed);
+    Taken taken{std::move(box.own), std::move(box.file), box.fileBytes};
+    for (uint64_t i = std::max(box.from, logBase_); i < logBase_ + log_.size();
+         ++i) {
+        taken.frames.push_back(log_[i - logBase_]);
+    }
+    lru_.erase(box.lru);
+    boxes_.erase(it);
+    offlineBoxes_.fetch_sub(1, std::memory_order_relaxed);
+    trimLog();
+
+    std::lock_guard<std::mutex> lock(doneMtx_);
+    ready_[session] = std::move(taken);
+}
+
+void Mailbox::onOffline(const void* session, bool keepMail) {
+    auto sit = sessions_.find(session);
+    if (sit != sessions_.end()) {
+        std::string nickname = std::move(sit->second);
+        sessions_.erase(sit);
+
+        Taken unclaimed;  // 会话未领取就下线：内容放回邮箱
+        {
+            std::lock_guard<std::mutex> lock(doneMtx_);
+            auto rit = ready_.find(session);
+            if (rit != ready_.end()) {
+                unclaimed = std::move(rit->second);
+                ready_.erase(rit);
+            }
+        }
+
+        auto cit = onlineCount_.find(nickname);
+        if (cit != onlineCount_.end() && --cit->second == 0) {
+            onlineCount_.erase(cit);
+            if (!keepMail) {
+                std::error_code ec;
+                if (!unclaimed.file.empty()) fs::remove(unclaimed.file, ec);
+                return;
+            }
+            Box& box = boxes_[nickname];
+            box.own = std::move(unclaimed.frames);
+            for (const auto& w : box.own) box.ownBytes += w->size();
+            while (box.ownBytes > cfg_.perUserBytes) {
+                box.ownBytes -= box.own.front()->size();
+                box.own.pop_front();
+            }
+            box.from = logBase_ + log_.size();
+            box.file = std::move(unclaimed.file);
+            box.fileBytes = unclaimed.fileBytes;
+            memBytes_.fetch_add(box.ownBytes, std::memory_order_relaxed);
+            box.lru = lru_.insert(lru_.end(), nickname);
+            offlineBoxes_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    // 先计入离线邮箱再减少待处理数，post 的判断不会出现空窗
+    if (keepMail) pendingOffline_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+/**
+ * 裁剪共享日志：lru_ 按 from 升序，最早的邮箱之前的帧已无人需要；
+ * 单个邮箱最多保留 perUserBytes，超出部分对所有邮箱都已丢弃
+ */
+void Mailbox::trimLog() {
+    uint64_t keepFrom = logBase_ + log_.size();
+    if (!lru_.empty()) keepFrom = boxes_[lru_.front()].from;
+    while (!log_.empty() &&
+           (logBase_ < keepFrom || logBytes_ > cfg_.perUserBytes)) {
+        size_t n = log_.front()->size();
+        log_.pop_front();
+        ++logBase_;
+        logBytes_ -= n;
+        memBytes_.fetch_sub(n, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * 把邮箱的内存帧（own 与日志中属于它的部分）追加到其落盘文件
+ * @param nickname 昵称
+ * @param box 邮箱
+ * @return 写盘失败时返回 false（内容保留在内存中）
+ */
+bool Mailbox::spill(const std::string& nickname, Box& box) {
+    const uint64_t end = logBase_ + log_.size();
+    const uint64_t begin = std::max(box.from, logBase_);
+    if (!box.own.empty() || begin < end) {
+        if (box.file.empty()) box.file = fileFor(nickname);
+        std::ofstream out(box.file, std::ios::binary | std::ios::app);
+        size_t written = 0;
+        auto write = [&](const Wire& w) {
+            out.write(w->data(), static_cast<std::streamsize>(w->size()));
+            written += w->size();
+        };
+        for (const auto& w : box.own) write(w);
+        for (uint64_t i = begin; i < end; ++i) write(log_[i - logBase_]);
+        if (!out) return false;
+        out.close();
+        box.fileBytes += written;
+        memBytes_.fetch_sub(box.ownBytes, std::memory_order_relaxed);
+        box.own.clear();
+        box.ownBytes = 0;
+        if (box.fileBytes > 2 * cfg_.perUserBytes) compact(box);
+    }
+    box.from = end;
+    lru_.splice(lru_.end(), lru_, box.lru);
+    trimLog();
+    return true;
+}
+
+/**
+ * 重写落盘文件，只保留最新的 perUserBytes
+ * @param box 邮箱
+ */
+void Mailbox::compact(Box& box) {
+    std::string data;
+    {
+        std::ifstream in(box.file, std::ios::binary);
+        data.resize(box.fileBytes);
+        in.read(&data[0], static_cast<std::streamsize>(box.fileBytes));
+        data.resize(static_cast<size_t>(in.gcount()));
+    }
+    size_t pos = 0;
+    while (data.size() - pos > cfg_.perUserBytes && data.size() - pos >= 5) {
+        pos += 5 + getU32(data.data() + pos + 1);
+    }
+    pos = std::min(pos, data.size());
+    std::ofstream out(box.file, std::ios::binary | std::ios::trunc);
+    out.write(data.data() + pos,
+              static_cast<std::streamsize>(data.size() - pos));
+    box.fileBytes = data.size() - pos;
+}
+
+/**
+ * 生成落盘文件名：昵称转十六进制（避免路径字符）加序号
+ * @param nickname 昵称
+ */
+std::string Mailbox::fileFor(const std::string& nickname) {
+    static const char kHex[] = "0123456789abcdef";
+    std::string name;
+    for (size_t i = 0; i < nickname.size() && i < 64; ++i) {
+        auto b = static_cast<unsigned char>(nickname[i]);
+        name.push_back(kHex[b >> 4]);
+        name.push_back(kHex[b & 15]);
+    }
+    name += "-" + std::to_string(++fileSeq_) + ".mbx";
+    return (fs::path(cfg_.spillDir) / name).string();
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "outbound_queue.h"
+
+/**
+ * 离线邮箱：昵称下线后，保留其离线期间的聊天广播，下次 HELLO 时一次性投递
+ * - 广播路径只做一次原子判断；有离线用户时再把共享的帧指针入队（O(1)）
+ * - 离线期间的广播追加到所有离线邮箱共享的日志，每帧只存一份、只计一次内存；
+ *   邮箱只记录自己从日志的哪个序号开始，分发与离线人数无关
+ * - 裁剪、落盘都在邮箱线程上完成
+ * - 每个昵称最多保留 perUserBytes（丢弃最旧）；内存超过 memoryBudget 时，
+ *   按下线（或上次落盘）先后把邮箱写入磁盘
+ * - 邮箱线程落后、待分发帧超过 maxPendingFrames 时丢弃新帧，计入
+ *   chat_mailbox_dropped_total，并至多每 10 秒记一行日志
+ * - online/offline/post 需在持有 clientsMtx_ 时调用，与广播的先后顺序一致：
+ *   每条广播要么已进入会话队列，要么进入邮箱，不重复也不丢失
+ */
+class Mailbox {
+   public:
+    using Wire = OutboundQueue::Wire;
+
+    struct Config {
+        std::string spillDir;                    // 落盘目录；空表示不启用
+        size_t memoryBudget = 64 * 1024 * 1024;  // 所有邮箱的内存预算
+        size_t perUserBytes = 1024 * 1024;       // 单个昵称保留的上限
+        size_t maxPendingFrames = 65536;  // 待分发帧上限，超过则丢弃新帧
+    };
+
+    Mailbox() = default;
+    ~Mailbox() { stop(); }
+
+    Mailbox(const Mailbox&) = delete;
+    Mailbox& operator=(const Mailbox&) = delete;
+
+    bool start(const Config& cfg);  // 创建落盘目录并启动邮箱线程
+    void stop();
+    bool enabled() const { return running_.load(std::memory_order_relaxed); }
+
+    // 会话上线，返回凭据供 collect 等待（未启用时返回 0）
+    uint64_t online(const void* session, const std::string& nickname);
+    // 会话下线（同一昵称的最后一个会话下线后开始收信）
+    void offline(const void* session);
+    // 会话被服务端丢弃（内存超限时断开）：只注销，不为该昵称开始收信
+    void drop(const void* session);
+    // 广播帧：只保留 SERVER_BROADCAST（含追踪版本）
+    void post(const Wire& wire);
+
+    // 会话线程调用：等待上线事件处理完毕，取出离线期间的帧（按时间顺序拼接）
+    std::string collect(const void* session, uint64_t ticket);
+
+    size_t memoryBytes() const {
+        return memBytes_.load(std::memory_order_relaxed);
+    }
+
+   private:
+    struct Event {
+        enum Kind { WIRE, ONLINE, OFFLINE, DROP } kind;
+        Wire wire;
+        const void* session;
+        std::string nickname;
+        uint64_t seq;
+    };
+
+    // 离线用户的邮箱（仅邮箱线程访问）
+    // 内容依次为：落盘文件、own、共享日志中序号 >= from 的帧
+    struct Box {
+        std::deque<Wire> own;  // 下线时放回的未领取帧（比日志中的旧）
+        size_t ownBytes = 0;
+        uint64_t from = 0;     // 本邮箱在共享日志中的起始序号
+        std::string file;      // 落盘文件（空表示未落盘）
+        size_t fileBytes = 0;
+        std::list<std::string>::iterator lru;
+    };
+
+    // 上线时取出、等待会话线程领取的内容
+    struct Taken {
+        std::deque<Wire> frames;
+        std::string file;
+        size_t fileBytes = 0;
+    };
+
+    uint64_t push(Event&& e);
+    void loop();
+    void onWire(const Wire& wire);
+    void onOnline(const void* session, const std::string& nickname);
+    void onOffline(const void* session, bool keepMail);
+    // 丢弃没有邮箱需要、或超出单用户上限的日志帧
+    void trimLog();
+    // 内存帧写入磁盘并移到落盘顺序末尾；写盘失败时返回 false
+    bool spill(const std::string& nickname, Box& box);
+    void compact(Box& box);  // 只保留磁盘中最新的 perUserBytes
+    std::string fileFor(const std::string& nickname);
+
+   private:
+    Config cfg_;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+
+    std::mutex queueMtx_;
+    std::condition_variable queueCv_;
+    std::deque<Event> queue_;
+    size_t pendingWires_{0};
+    // 待分发帧超限时丢弃的新帧：至多每 kDropLogIntervalNs 记一行日志
+    static constexpr uint64_t kDropLogIntervalNs = 10'000'000'000ull;
+    uint64_t droppedSinceLog_{0};
+    uint64_t dropLogNs_{0};
+    uint64_t nextSeq_{1};
+
+    // 广播路径的快速判断：存在离线邮箱或尚未处理的下线事件
+    std::atomic<size_t> offlineBoxes_{0};
+    std::atomic<size_t> pendingOffline_{0};
+    std::atomic<size_t> memBytes_{0};
+
+    // 上线事件处理进度与待领取内容
+    std::mutex doneMtx_;
+    std::condition_variable doneCv_;
+    uint64_t doneSeq_{0};
+    std::unordered_map<const void*, Taken> ready_;
+
+    // 以下仅邮箱线程访问
+    std::unordered_map<std::string, Box> boxes_;        // 离线昵称 -> 邮箱
+    std::deque<Wire> log_;   // 共享日志：离线期间的广播
+    uint64_t logBase_{0};    // log_.front() 的序号
+    size_t logBytes_{0};
+    std::unordered_map<std::string, int> onlineCount_;  // 在线昵称 -> 会话数
+    std::unordered_map<const void*, std::string> sessions_;  // 会话 -> 昵称
+    // 离线邮箱，按下线或上次落盘的先后排列，即按 from 升序
+    std::list<std::string> lru_;
+    uint64_t fileSeq_{0};
+};
@@ -25,6 +25,82 @@ int main(int argc, char **argv) {
 
     // 创建聊天服务器
     ChatServer server;
+    // 可选：同机客户端使用的 Unix 域套接字路径（"-" 表示不启用）
+    std::string unixPath;
+    if (argc >= 3 && std::string(argv[2]) != "-") {
+        unixPath = argv[2];
+        server.setUnixSocketPath(unixPath);
+    }
+    // 可选：指标导出端口，仅监听 127.0.0.1（0 表示不启用）
+    uint16_t metricsPort = 0;
+    if (argc >= 4) {
+        metricsPort = static_cast<uint16_t>(std::stoi(argv[3]));
+        server.setMetricsPort(metricsPort);
+    }
+    // 可选：违禁词表文件，运行中输入 reload 重新加载
+    std::string filterPath;
+    auto loadFilter = [&] {
+        if (!server.loadFilter(filterPath)) {
+            std::cerr << "Failed to load banned terms from " << filterPath
+                      << std::endl;
+            return;
+        }
+        std::cout << "Loaded " << server.filter().termCount()
+                  << " banned terms (" << server.filter().stateCount()
+                  << " states), filter throughput "
+                  << static_cast<long long>(server.filter().benchmarkMBps())
+                  << " MB/s per core" << std::endl;
+    };
+    if (argc >= 5 && std::string(argv[4]) != "-") {
+        filterPath = argv[4];
+        loadFilter();
+    }
+    // 可选：离线邮箱目录（"-" 表示不启用），超出内存预算的邮箱写入该目录
+    std::string mailboxDir;
+    if (argc >= 6 && std::string(argv[5]) != "-") {
+        mailboxDir = argv[5];
+        Mailbox::Config cfg;
+        cfg.spillDir = mailboxDir;
+        server.setMailboxConfig(cfg);
+    }
+    // 可选：全局内存上限（MiB，0 表示不启用），可附降级顺序，
+    // 例如 "512:hello,history,heaviest"
+    size_t memoryLimitMb = 0;
+    if (argc >= 7 && std::string(argv[6]) != "-") {
+        std::string spec = argv[6];
+        size_t colon = spec.find(':');
+        MemoryGovernor::Config cfg;
+        memoryLimitMb = std::stoul(spec.substr(0, colon));
+        if (colon != std::string::npos &&
+            !MemoryGovernor::parseOrder(spec.substr(colon + 1), cfg.order)) {
+            std::cerr << "Unknown shedding order " << spec.substr(colon + 1)
+                      << " (use hello,history,heaviest)" << std::endl;
+            WSACleanup();
+            return 1;
+        }
+        cfg.limitBytes = memoryLimitMb * 1024 * 1024;
+        server.setMemoryConfig(cfg);
+    }
+    // 可选：局域网组播分发，"组地址:端口[@接口地址]"，
+    // 例如 "239.255.10.1:5001@192.168.1.10"
+    std::string multicastSpec;
+    if (argc >= 8 && std::string(argv[7]) != "-") {
+        multicastSpec = argv[7];
+        MulticastPublisher::Config cfg;
+        size_t at = multicastSpec.find('@');
+        std::string addr = multicastSpec.substr(0, at);
+        if (at != std::string::npos) cfg.iface = multicastSpec.substr(at + 1);
+        size_t colon = addr.rfind(':');
+        if (colon == std::string::npos) {
+            std::cerr << "Multicast spec must be group:port[@iface]"
+                      << std::endl;
+            WSACleanup();
+            return 1;
+        }
+        cfg.group = addr.substr(0, colon);
+        cfg.port = static_cast<uint16_t>(std::stoi(addr.substr(colon + 1)));
+        server.setMulticastConfig(cfg);
+    }
     if (!server.start(port)) {
         // 启动服务器失败（C++ 风格输出）
         std::cerr << "Failed to start server on port " << port << std::endl;
@@ -34,13 +110,36 @@ int main(int argc, char **argv) {
     }
 
     std::cout << "Chat server listening on port " << port << std::endl;
+    if (!unixPath.empty()) {
+        std::cout << "Chat server listening on unix socket " << unixPath
+                  << std::endl;
+    }
+    if (metricsPort != 0) {
+        std::cout << "Metrics at http://127.0.0.1:" << metricsPort
+                  << "/metrics" << std::endl;
+    }
+    if (!mailboxDir.empty()) {
+        std::cout << "Offline mailbox enabled, spilling to " << mailboxDir
+                  << std::endl;
+    }
+    if (memoryLimitMb != 0) {
+        std::cout << "Memory limit " << memoryLimitMb << " MiB" << std::endl;
+    }
+    if (!multicastSpec.empty()) {
+        std::cout << "Multicast fanout to " << multicastSpec << std::endl;
+    }
     std::cout << "Type 'quit' + Enter to stop." << std::endl;
+    if (!filterPath.empty()) {
+        std::cout << "Type 'reload' + Enter to reload banned terms."
+                  << std::endl;
+    }
 
     std::thread quitThread([&] {
         // 等待用户输入 "quit" 命令以停止服务器
         std::string line;
         while (std::getline(std::cin, line)) {
             if (line == "quit") break;
+            if (line == "reload" && !filterPath.empty()) loadFilter();
         }
         server.stop();
     });
@@ -0,0 +1,111 @@
+#include "memory_governor.h"
+
+#include <algorithm>
+#include <chrono>
+
+/**
+ * 启动检查线程
+ * @param cfg 配置
+ * @param hooks 占用统计与降级动作
+ * @return 未设置上限时返回 false（不启动）
+ */
+bool MemoryGovernor::start(const Config& cfg, Hooks hooks) {
+    if (cfg.limitBytes == 0 || !hooks.usage) return false;
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (running_) return true;
+    cfg_ = cfg;
+    hooks_ = std::move(hooks);
+    running_ = true;
+    thread_ = std::thread(&MemoryGovernor::loop, this);
+    return true;
+}
+
+void MemoryGovernor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!running_) return;
+        running_ = false;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+    refusing_.store(false);
+    level_.store(0);
+}
+
+void MemoryGovernor::loop() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (running_) {
+        cv_.wait_for(lock, std::chrono::milliseconds(cfg_.intervalMs),
+                     [this] { return !running_; });
+        if (!running_) break;
+        lock.unlock();
+        check();  // 降级动作可能耗时（断开连接需等待会话线程），不持锁
+        lock.lock();
+    }
+}
+
+/**
+ * 一次检查：低于恢复水位时解除降级；达到上限时按顺序执行降级动作
+ */
+void MemoryGovernor::check() {
+    size_t used = hooks_.usage();
+    usage_.store(used, std::memory_order_relaxed);
+    const size_t resume = cfg_.limitBytes / 100 * cfg_.resumePercent;
+    if (used < resume) {
+        refusing_.store(false, std::memory_order_relaxed);
+        level_.store(0, std::memory_order_relaxed);
+        return;
+    }
+    if (used < cfg_.limitBytes) return;  // 介于两条水位之间：保持现状
+
+    size_t level = 0;
+    for (Action a : cfg_.order) {
+        if (used < cfg_.limitBytes) break;
+        ++level;
+        switch (a) {
+            case REFUSE_HELLO:
+                refusing_.store(true, std::memory_order_relaxed);
+                break;
+            case TRIM_HISTORY:
+                if (hooks_.trimHistory)
+                    used -= std::min(used, hooks_.trimHistory(used - resume));
+                break;
+            case DISCONNECT_HEAVIEST:
+                while (hooks_.disconnectHeaviest && used >= resume) {
+                    size_t freed = hooks_.disconnectHeaviest();
+                    if (freed == 0) break;  // 没有可断开的会话
+                    used -= std::min(used, freed);
+                }
+                break;
+        }
+    }
+    level_.store(std::max(level, level_.load(std::memory_order_relaxed)),
+                 std::memory_order_relaxed);
+}
+
+/**
+ * 解析降级顺序
+ * @param text 以逗号分隔：hello / history / heaviest
+ * @param out 输出顺序
+ */
+bool MemoryGovernor::parseOrder(const std::string& text,
+                                std::vector<Action>& out) {
+    std::vector<Action> order;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t end = std::min(text.find(',', start), text.size());
+        std::string item = text.substr(start, end - start);
+        if (item == "hello") {
+            order.push_back(REFUSE_HELLO);
+        } else if (item == "history") {
+            order.push_back(TRIM_HISTORY);
+        } else if (item == "heaviest") {
+            order.push_back(DISCONNECT_HEAVIEST);
+        } else {
+            return false;
+        }
+        start = end + 1;
+    }
+    out = std::move(order);
+    return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * 全局内存上限：周期性汇总服务端的内存占用，超限时按配置顺序降级
+ * - 占用由 usage 回调给出（各会话、检索历史、离线邮箱等的估算之和）
+ * - 达到上限时依次执行降级动作，某一步之后低于上限即停止；拒绝 HELLO 保持到
+ *   占用回落到恢复水位以下，裁剪历史与断开连接则以恢复水位为目标释放
+ * - 未设置上限（limitBytes 为 0）时不启动线程
+ */
+class MemoryGovernor {
+   public:
+    enum Action {
+        REFUSE_HELLO,         // 拒绝新的 HELLO（不再接纳新会话）
+        TRIM_HISTORY,         // 丢弃最旧的聊天历史
+        DISCONNECT_HEAVIEST,  // 逐个断开占用最多的会话
+    };
+
+    struct Config {
+        size_t limitBytes = 0;        // 全局上限；0 表示不启用
+        unsigned resumePercent = 80;  // 恢复水位（上限的百分比）
+        int intervalMs = 100;         // 检查周期
+        std::vector<Action> order{REFUSE_HELLO, TRIM_HISTORY,
+                                  DISCONNECT_HEAVIEST};
+    };
+
+    struct Hooks {
+        std::function<size_t()> usage;              // 当前占用
+        std::function<size_t(size_t)> trimHistory;  // 期望释放量 -> 实际释放量
+        // 断开一个，返回其可归属于会话的占用；返回 0 表示没有值得断开的会话
+        std::function<size_t()> disconnectHeaviest;
+    };
+
+    MemoryGovernor() = default;
+    ~MemoryGovernor() { stop(); }
+
+    MemoryGovernor(const MemoryGovernor&) = delete;
+    MemoryGovernor& operator=(const MemoryGovernor&) = delete;
+
+    bool start(const Config& cfg, Hooks hooks);
+    void stop();
+
+    bool refusingHello() const {
+        return refusing_.load(std::memory_order_relaxed);
+    }
+    size_t lastUsage() const { return usage_.load(std::memory_order_relaxed); }
+    size_t limit() const { return cfg_.limitBytes; }
+    // 最近一次超限时执行到第几个降级动作（0 表示未降级）
+    size_t level() const { return level_.load(std::memory_order_relaxed); }
+
+    // 解析降级顺序，例如 "hello,history,heaviest"；有未知项时返回 false
+    static bool parseOrder(const std::string& text, std::vector<Action>& out);
+
+   private:
+    void loop();
+    void check();
+
+   private:
+    Config cfg_;
+    Hooks hooks_;
+    std::thread thread_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool running_{false};
+
+    std::atomic<bool> refusing_{false};
+    std::atomic<size_t> usage_{0};
+    std::atomic<size_t> level_{0};
+};
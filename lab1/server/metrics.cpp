@@ -0,0 +1,366 @@
+#include "metrics.h"
+
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "common/protocol.h"
+
+namespace metrics {
+namespace {
+
+// 直方图桶：第 i 个桶上界为 2^(i+10) 纳秒（约 1us 到 1s），最后一个为 +Inf
+constexpr int kBuckets = 22;
+
+struct Shard {
+    std::atomic<uint64_t> counters[kCounterCount]{};
+    std::atomic<uint64_t> framesIn[256]{};
+    std::atomic<uint64_t> framesOut[256]{};
+    std::atomic<uint64_t> buckets[kHistogramCount][kBuckets]{};
+    std::atomic<uint64_t> sumNs[kHistogramCount]{};
+};
+
+// 仅所属线程写入：普通 load + store 即可，避免原子加的总线锁开销
+inline void bump(std::atomic<uint64_t>& a, uint64_t n) {
+    a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+/**
+ * 分片注册表：所有分片常驻，线程退出时归还空闲列表
+ */
+class Registry {
+   public:
+    static Registry& instance() {
+        static Registry* r = new Registry();  // 不析构，避免退出顺序问题
+        return *r;
+    }
+
+    Shard* acquire() {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!free_.empty()) {
+            Shard* s = free_.back();
+            free_.pop_back();
+            return s;
+        }
+        all_.push_back(std::make_unique<Shard>());
+        return all_.back().get();
+    }
+
+    void release(Shard* s) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        free_.push_back(s);
+    }
+
+    // 在锁内遍历所有分片（采集时调用，频率很低）
+    template <typename Fn>
+    void forEach(Fn&& fn) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (const auto& s : all_) fn(*s);
+    }
+
+   private:
+    std::mutex mtx_;
+    std::vector<std::unique_ptr<Shard>> all_;
+    std::vector<Shard*> free_;
+};
+
+struct ShardHandle {
+    Shard* shard = Registry::instance().acquire();
+    ~ShardHandle() { Registry::instance().release(shard); }
+};
+
+inline Shard& local() {
+    thread_local ShardHandle handle;
+    return *handle.shard;
+}
+
+const char* typeName(uint8_t t) {
+    using chatproto::MsgType;
+    switch (static_cast<MsgType>(t)) {
+        case MsgType::HELLO: return "hello";
+        case MsgType::CHAT: return "chat";
+        case MsgType::BYE: return "bye";
+        case MsgType::SEARCH: return "search";
+        case MsgType::STREAM_BEGIN: return "stream_begin";
+        case MsgType::STREAM_CHUNK: return "stream_chunk";
+        case MsgType::STREAM_END: return "stream_end";
+        case MsgType::CHAT_TRACED: return "chat_traced";
+        case MsgType::RECEIPTS: return "receipts";
+        case MsgType::MULTICAST_ON: return "multicast_on";
+        case MsgType::NACK: return "nack";
+        case MsgType::USER_JOIN: return "user_join";
+        case MsgType::USER_LEAVE: return "user_leave";
+        case MsgType::SERVER_BROADCAST: return "server_broadcast";
+        case MsgType::SEARCH_RESULT: return "search_result";
+        case MsgType::SERVER_STREAM_BEGIN: return "server_stream_begin";
+        case MsgType::SERVER_STREAM_CHUNK: return "server_stream_chunk";
+        case MsgType::SERVER_STREAM_END: return "server_stream_end";
+        case MsgType::MAILBOX: return "mailbox";
+        case MsgType::SERVER_BROADCAST_TRACED:
+            return "server_broadcast_traced";
+        case MsgType::RECEIPT: return "receipt";
+        case MsgType::MULTICAST_GROUP: return "multicast_group";
+        case MsgType::MULTICAST_START: return "multicast_start";
+        case MsgType::REPAIR_LOST: return "repair_lost";
+        case MsgType::REFUSED: return "refused";
+    }
+    return nullptr;
+}
+
+struct CounterInfo {
+    const char* name;
+    const char* help;
+};
+
+const CounterInfo kCounters[kCounterCount] = {
+    {"chat_connections_accepted_total", "Accepted TCP/Unix connections"},
+    {"chat_connections_rejected_total",
+     "Connections rejected by pending-handshake limits"},
+    {"chat_connections_expired_total",
+     "Connections closed for missing the HELLO deadline"},
+    {"chat_sessions_opened_total", "Sessions admitted after HELLO"},
+    {"chat_sessions_closed_total", "Sessions that ended"},
+    {"chat_slow_consumers_total",
+     "Clients dropped for exceeding the outbound queue limit"},
+    {"chat_bytes_in_total", "Bytes received including frame headers"},
+    {"chat_bytes_out_total", "Bytes sent including frame headers"},
+    {"chat_filter_bytes_total", "CHAT bytes scanned by the banned-term filter"},
+    {"chat_filter_nanoseconds_total",
+     "Time spent in the banned-term filter; bytes / time is per-core rate"},
+    {"chat_filter_matches_total", "CHAT messages with banned terms masked"},
+    {"chat_memory_hello_refused_total",
+     "HELLOs refused while over the memory limit"},
+    {"chat_memory_history_trimmed_bytes_total",
+     "Search history bytes dropped while over the memory limit"},
+    {"chat_memory_disconnects_total",
+     "Sessions disconnected as heaviest while over the memory limit"},
+    {"chat_multicast_datagrams_total",
+     "Multicast datagrams sent, including heartbeats"},
+    {"chat_multicast_bytes_total", "Multicast bytes sent"},
+    {"chat_multicast_repairs_total",
+     "Chat broadcasts resent over TCP after a NACK"},
+    {"chat_multicast_lost_total",
+     "NACKed chat broadcasts already evicted from the repair ring"},
+    {"chat_mailbox_dropped_total",
+     "Broadcasts not kept for offline users because the mailbox fell behind"},
+    {"chat_search_dropped_total",
+     "Broadcasts never indexed because the search indexer fell behind"},
+};
+
+const CounterInfo kHistograms[kHistogramCount] = {
+    {"chat_broadcast_fanout_seconds",
+     "Time to enqueue one broadcast to every recipient"},
+    {"chat_clients_lock_wait_seconds", "Time spent waiting for clientsMtx_"},
+    {"chat_trace_uplink_seconds",
+     "Traced messages: client send to server receive"},
+    {"chat_trace_process_seconds",
+     "Traced messages: server receive to broadcast enqueue"},
+    {"chat_trace_queue_seconds",
+     "Traced messages: broadcast enqueue to socket write, per recipient"},
+};
+
+void header(std::string& out, const char* name, const char* help,
+            const char* type) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+void renderFrames(std::string& out, const char* name, const char* help,
+                  const uint64_t (&counts)[256]) {
+    header(out, name, help, "counter");
+    for (int t = 0; t < 256; ++t) {
+        if (counts[t] == 0) continue;
+        const char* tn = typeName(static_cast<uint8_t>(t));
+        char label[16];
+        if (!tn) {
+            std::snprintf(label, sizeof(label), "0x%02x", t);
+            tn = label;
+        }
+        out += name;
+        out += "{type=\"";
+        out += tn;
+        out += "\"} ";
+        out += std::to_string(counts[t]);
+        out += '\n';
+    }
+}
+
+}  // namespace
+
+void inc(Counter c, uint64_t n) { bump(local().counters[c], n); }
+
+void frameIn(uint8_t type, size_t bytes) {
+    Shard& s = local();
+    bump(s.framesIn[type], 1);
+    bump(s.counters[BYTES_IN], bytes);
+}
+
+void frameOut(uint8_t type, size_t bytes) {
+    Shard& s = local();
+    bump(s.framesOut[type], 1);
+    bump(s.counters[BYTES_OUT], bytes);
+}
+
+void observe(Histogram h, uint64_t ns) {
+    Shard& s = local();
+    // 桶下标为 (ns >> 10) 的二进制位数，超出范围归入 +Inf
+    int idx = 0;
+    for (uint64_t v = ns >> 10; v != 0 && idx < kBuckets - 1; v >>= 1) ++idx;
+    bump(s.buckets[h][idx], 1);
+    bump(s.sumNs[h], ns);
+}
+
+/**
+ * 汇总所有分片并输出 Prometheus 文本格式
+ */
+std::string render() {
+    uint64_t counters[kCounterCount] = {};
+    uint64_t in[256] = {}, out[256] = {};
+    uint64_t buckets[kHistogramCount][kBuckets] = {};
+    uint64_t sumNs[kHistogramCount] = {};
+    Registry::instance().forEach([&](const Shard& s) {
+        for (int i = 0; i < kCounterCount; ++i)
+            counters[i] += s.counters[i].load(std::memory_order_relaxed);
+        for (int t = 0; t < 256; ++t) {
+            in[t] += s.framesIn[t].load(std::memory_order_relaxed);
+            out[t] += s.framesOut[t].load(std::memory_order_relaxed);
+        }
+        for (int h = 0; h < kHistogramCount; ++h) {
+            for (int b = 0; b < kBuckets; ++b) {
+                buckets[h][b] +=
+                    s.buckets[h][b].load(std::memory_order_relaxed);
+            }
+            sumNs[h] += s.sumNs[h].load(std::memory_order_relaxed);
+        }
+    });
+
+    std::string text;
+    for (int i = 0; i < kCounterCount; ++i) {
+        header(text, kCounters[i].name, kCounters[i].help, "counter");
+        text += kCounters[i].name;
+        text += ' ';
+        text += std::to_string(counters[i]);
+        text += '\n';
+    }
+    renderFrames(text, "chat_frames_in_total", "Frames received by type", in);
+    renderFrames(text, "chat_frames_out_total", "Frames sent by type", out);
+
+    char num[64];
+    for (int h = 0; h < kHistogramCount; ++h) {
+        const char* name = kHistograms[h].name;
+        header(text, name, kHistograms[h].help, "histogram");
+        uint64_t cumulative = 0;
+        for (int b = 0; b < kBuckets; ++b) {
+            cumulative += buckets[h][b];
+            text += name;
+            if (b == kBuckets - 1) {
+                text += "_bucket{le=\"+Inf\"} ";
+            } else {
+                std::snprintf(num, sizeof(num), "%.9g",
+                              static_cast<double>(1ull << (b + 10)) / 1e9);
+                text += "_bucket{le=\"";
+                text += num;
+                text += "\"} ";
+            }
+            text += std::to_string(cumulative);
+            text += '\n';
+        }
+        std::snprintf(num, sizeof(num), "%.9f",
+                      static_cast<double>(sumNs[h]) / 1e9);
+        text += name;
+        text += "_sum ";
+        text += num;
+        text += '\n';
+        text += name;
+        text += "_count ";
+        text += std::to_string(cumulative);
+        text += '\n';
+    }
+    return text;
+}
+
+/**
+ * 启动导出端点
+ * @param port 本地 HTTP 端口
+ * @param fn 生成响应正文的回调
+ */
+bool Exporter::start(uint16_t port, RenderFn fn) {
+    if (running_.load()) return true;
+    sock_ = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock_ == INVALID_SOCKET) return false;
+    u_long yes = 1;
+    setsockopt(sock_, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes,
+               sizeof(yes));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);  // 只对本机开放
+    addr.sin_port = htons(port);
+    if (bind(sock_, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+        listen(sock_, 16) == SOCKET_ERROR) {
+        closesocket(sock_);
+        sock_ = INVALID_SOCKET;
+        return false;
+    }
+    render_ = std::move(fn);
+    running_.store(true);
+    thread_ = std::thread(&Exporter::serveLoop, this);
+    return true;
+}
+
+void Exporter::stop() {
+    if (!running_.exchange(false)) return;
+    if (thread_.joinable()) thread_.join();
+    closesocket(sock_);
+    sock_ = INVALID_SOCKET;
+}
+
+/**
+ * 串行处理采集请求；每 200ms 检查一次停止标志
+ */
+void Exporter::serveLoop() {
+    while (running_.load()) {
+        WSAPOLLFD pfd{};
+        pfd.fd = sock_;
+        pfd.events = POLLIN;
+        if (WSAPoll(&pfd, 1, 200) <= 0) continue;
+        SOCKET cs = accept(sock_, nullptr, nullptr);
+        if (cs == INVALID_SOCKET) continue;
+        serveOne(cs);
+        closesocket(cs);
+    }
+}
+
+/**
+ * 读取请求头（内容忽略）并返回指标文本
+ * @param cs 客户端套接字
+ */
+void Exporter::serveOne(SOCKET cs) {
+    std::string req;
+    char buf[1024];
+    while (req.find("\r\n\r\n") == std::string::npos && req.size() < 8192) {
+        WSAPOLLFD pfd{};
+        pfd.fd = cs;
+        pfd.events = POLLIN;
+        if (WSAPoll(&pfd, 1, 1000) <= 0) return;  // 慢客户端直接放弃
+        int n = recv(cs, buf, sizeof(buf), 0);
+        if (n <= 0) return;
+        req.append(buf, static_cast<size_t>(n));
+    }
+    std::string body = render_ ? render_() : std::string();
+    std::string resp =
+        "HTTP/1.0 200 OK\r\n"
+        "Content-Type: text/plain; version=0.0.4\r\n"
+        "Content-Length: " +
+        std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+    chatproto::sendAll(cs, resp.data(), static_cast<int>(resp.size()));
+}
+
+}  // namespace metrics
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+/**
+ * 服务端内部指标（Prometheus 文本格式导出）
+ * - 每个线程写自己的分片：只有所属线程写入，使用 relaxed 读-改-写（普通
+ *   load/store，无锁前缀指令），采集线程 relaxed 读取后求和
+ * - 线程退出时分片归还空闲列表供新线程复用，累计值不丢失
+ */
+namespace metrics {
+
+// 计数器
+enum Counter {
+    CONN_ACCEPTED,        // 接受的 TCP/Unix 连接
+    CONN_REJECTED,        // 超出待握手上限被拒绝的连接
+    CONN_EXPIRED,         // HELLO 超时被关闭的连接
+    SESSIONS_OPENED,      // 完成握手的会话
+    SESSIONS_CLOSED,      // 结束的会话
+    SLOW_CONSUMERS,       // 因发送队列积压被断开的客户端
+    BYTES_IN,             // 接收字节数（含帧头）
+    BYTES_OUT,            // 发送字节数（含帧头）
+    FILTER_BYTES,         // 经过违禁词过滤的字节数
+    FILTER_NANOS,         // 违禁词过滤耗时（纳秒），与上项相除即单核吞吐量
+    FILTER_MATCHES,       // 命中违禁词的消息数
+    MEM_HELLO_REFUSED,    // 内存超限时拒绝的 HELLO
+    MEM_HISTORY_TRIMMED,  // 内存超限时丢弃的检索历史（字节，估算）
+    MEM_DISCONNECTS,      // 内存超限时断开的会话
+    MCAST_DATAGRAMS,      // 发出的组播数据报（含心跳）
+    MCAST_BYTES,          // 组播发送字节数
+    MCAST_REPAIRS,        // 经 TCP 补发的聊天广播
+    MCAST_LOST,           // 请求补发时已淘汰的聊天广播
+    MAILBOX_DROPPED,      // 邮箱线程落后时未进入离线邮箱的广播
+    SEARCH_DROPPED,       // 索引线程落后时未建索引即丢弃的广播
+    kCounterCount
+};
+
+// 直方图（单位：纳秒，导出为秒）
+enum Histogram {
+    BROADCAST_FANOUT,   // 一次广播入队到所有接收者的耗时
+    CLIENTS_LOCK_WAIT,  // 等待 clientsMtx_ 的耗时
+    // 以下仅统计 CHAT_TRACED 消息
+    TRACE_UPLINK,   // 客户端发送到服务端接收（同机时有意义）
+    TRACE_PROCESS,  // 服务端接收到入队（过滤、编码）
+    TRACE_QUEUE,    // 入队到写线程写出（发送队列等待）
+    kHistogramCount
+};
+
+void inc(Counter c, uint64_t n = 1);
+void frameIn(uint8_t type, size_t bytes);   // 按消息类型统计入站帧
+void frameOut(uint8_t type, size_t bytes);  // 按消息类型统计出站帧
+void observe(Histogram h, uint64_t ns);
+
+// 单调时钟纳秒数
+inline uint64_t nowNs() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+// 汇总所有分片，输出计数器与直方图（Prometheus 文本格式）
+std::string render();
+
+/**
+ * 本地 HTTP 导出端点：对任意请求返回 render 回调的结果
+ */
+class Exporter {
+   public:
+    using RenderFn = std::function<std::string()>;
+
+    Exporter() = default;
+    ~Exporter() { stop(); }
+
+    Exporter(const Exporter&) = delete;
+    Exporter& operator=(const Exporter&) = delete;
+
+    // 仅绑定 127.0.0.1
+    bool start(uint16_t port, RenderFn fn);
+    void stop();
+
+   private:
+    void serveLoop();
+    void serveOne(SOCKET cs);
+
+   private:
+    SOCKET sock_{INVALID_SOCKET};
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    RenderFn render_;
+};
+
+}  // namespace metrics
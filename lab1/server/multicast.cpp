@@ -0,0 +1,180 @@
+#include "multicast.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+#include "common/protocol.h"
+#include "metrics.h"
+#include "receipts.h"
+
+using namespace chatproto;
+
+/**
+ * 创建组播发送套接字并启动心跳线程
+ * @param cfg 组播配置
+ * @return 组地址或接口地址无效、套接字创建失败时返回 false
+ */
+bool MulticastPublisher::start(const Config& cfg) {
+    if (running_.load()) return true;
+    cfg_ = cfg;
+    dest_ = sockaddr_in{};
+    dest_.sin_family = AF_INET;
+    dest_.sin_port = htons(cfg_.port);
+    if (inet_pton(AF_INET, cfg_.group.c_str(), &dest_.sin_addr) != 1)
+        return false;
+    in_addr iface{};
+    iface.s_addr = htonl(INADDR_ANY);
+    if (!cfg_.iface.empty() &&
+        inet_pton(AF_INET, cfg_.iface.c_str(), &iface) != 1)
+        return false;
+
+    SOCKET s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == INVALID_SOCKET) return false;
+    int ttl = cfg_.ttl;
+    int loop = 1;  // 同机的客户端也能收到
+    if (setsockopt(s, IPPROTO_IP, IP_MULTICAST_TTL,
+                   reinterpret_cast<const char*>(&ttl), sizeof(ttl)) != 0 ||
+        setsockopt(s, IPPROTO_IP, IP_MULTICAST_LOOP,
+                   reinterpret_cast<const char*>(&loop), sizeof(loop)) != 0 ||
+        setsockopt(s, IPPROTO_IP, IP_MULTICAST_IF,
+                   reinterpret_cast<const char*>(&iface),
+                   sizeof(iface)) != 0) {
+        closesocket(s);
+        return false;
+    }
+    sock_ = s;
+    instance_ = static_cast<uint32_t>(std::random_device{}());
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        history_.clear();
+        historyBase_ = 0;
+        lastSeq_ = 0;
+        historyBytes_.store(0, std::memory_order_relaxed);
+    }
+    running_.store(true);
+    heartbeat_ = std::thread(&MulticastPublisher::heartbeatLoop, this);
+    return true;
+}
+
+void MulticastPublisher::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!running_.load()) return;
+        running_.store(false);
+    }
+    cv_.notify_all();
+    if (heartbeat_.joinable()) heartbeat_.join();
+    std::lock_guard<std::mutex> lock(mtx_);
+    closesocket(sock_);
+    sock_ = INVALID_SOCKET;
+    history_.clear();
+    historyBytes_.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * 发送一条聊天广播并放入补发环
+ * @param seq 房间序号
+ * @param wire 已编码的 SERVER_BROADCAST(_TRACED) 帧
+ */
+void MulticastPublisher::publish(uint64_t seq, const Wire& wire) {
+    // 带回执的帧改存副本：补发环不推迟发送者的送达回执
+    Wire kept = ReceiptTracker::tracked(wire)
+                    ? std::make_shared<const std::string>(*wire)
+                    : wire;
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!running_.load(std::memory_order_relaxed)) return;
+    datagram_.clear();
+    putU32(datagram_, instance_);
+    putU64(datagram_, seq);
+    if (wire->size() <= kMaxFrame) {
+        datagram_ += *wire;
+        // 追踪帧：组播的写出时间即发送时间（TCP 路径由各写线程填入）
+        constexpr size_t kWriteStamp = 12 + 5 + SEQ_HEADER_SIZE + 24;
+        if (static_cast<MsgType>((*wire)[0]) ==
+                MsgType::SERVER_BROADCAST_TRACED &&
+            datagram_.size() >= kWriteStamp + 8)
+            setU64(&datagram_[kWriteStamp], traceNowUs());
+    }
+    sendDatagram(datagram_);
+    lastSeq_ = seq;
+    lastSendNs_ = metrics::nowNs();
+
+    // 序号不连续（只在停止过程中同步分发时可能出现）则重新开始
+    if (history_.empty() || seq != historyBase_ + history_.size()) {
+        history_.clear();
+        historyBytes_.store(0, std::memory_order_relaxed);
+        historyBase_ = seq;
+    }
+    size_t bytes = historyBytes_.load(std::memory_order_relaxed);
+    bytes += kept->size();
+    history_.push_back(std::move(kept));
+    while (history_.size() > cfg_.historyFrames ||
+           (bytes > cfg_.historyBytes && history_.size() > 1)) {
+        bytes -= history_.front()->size();
+        history_.pop_front();
+        ++historyBase_;
+    }
+    historyBytes_.store(bytes, std::memory_order_relaxed);
+}
+
+/**
+ * 取出待补发的帧
+ * @param first 起始序号
+ * @param count 条数
+ * @param out 输出：仍在补发环中的帧，按序号顺序追加
+ * @return 从 first 开始已被淘汰（无法补发）的条数
+ * @note 尚未发送的序号既不补发也不计入淘汰
+ */
+uint32_t MulticastPublisher::collect(uint64_t first, uint32_t count,
+                                     std::vector<Wire>& out) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    uint64_t end = std::min(first + count, lastSeq_ + 1);
+    uint64_t ringStart = history_.empty() ? lastSeq_ + 1 : historyBase_;
+    uint32_t lost = 0;
+    if (first < ringStart && first < end)
+        lost = static_cast<uint32_t>(std::min(end, ringStart) - first);
+    for (uint64_t s = std::max(first, ringStart); s < end; ++s) {
+        out.push_back(history_[s - historyBase_]);
+    }
+    return lost;
+}
+
+std::string MulticastPublisher::groupInfo() const {
+    std::string info;
+    putU32(info, instance_);
+    info.push_back(static_cast<char>(cfg_.port >> 8));
+    info.push_back(static_cast<char>(cfg_.port & 0xFF));
+    info += cfg_.group;
+    return info;
+}
+
+/**
+ * 心跳线程：空闲超过一个周期时重发最新序号的数据报头
+ */
+void MulticastPublisher::heartbeatLoop() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (running_.load()) {
+        cv_.wait_for(lock, std::chrono::milliseconds(kHeartbeatMs),
+                     [this] { return !running_.load(); });
+        if (!running_.load()) break;
+        uint64_t now = metrics::nowNs();
+        if (lastSeq_ == 0 || now - lastSendNs_ < kHeartbeatMs * 1000000ull)
+            continue;
+        std::string header;
+        putU32(header, instance_);
+        putU64(header, lastSeq_);
+        sendDatagram(header);
+        lastSendNs_ = now;
+    }
+}
+
+// 调用方持有 mtx_
+void MulticastPublisher::sendDatagram(const std::string& d) {
+    int n = sendto(sock_, d.data(), static_cast<int>(d.size()), 0,
+                   reinterpret_cast<const sockaddr*>(&dest_), sizeof(dest_));
+    if (n == static_cast<int>(d.size())) {
+        metrics::inc(metrics::MCAST_DATAGRAMS);
+        metrics::inc(metrics::MCAST_BYTES, d.size());
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "outbound_queue.h"
+
+/**
+ * 局域网组播分发（可选）：聊天广播只向一个 IPv4 组播组发送一次
+ * - 已加入组播的会话不再经 TCP 收到聊天广播，服务端出口流量与在线人数无关
+ * - 数据报：[4 实例号][8 房间序号][完整的广播帧]；帧超过 kMaxFrame 时只发
+ *   前 12 字节，接收方据此立即经 TCP 请求补发
+ * - 最近的帧保留在补发环中（按条数与字节数限制）；客户端发现缺号后经 TCP
+ *   发送 NACK，由其会话的发送队列补发原帧，已不在环中的序号回复 REPAIR_LOST
+ * - 空闲时每 kHeartbeatMs 重发一次最新序号的数据报头，接收方据此发现尾部丢失
+ */
+class MulticastPublisher {
+   public:
+    using Wire = OutboundQueue::Wire;
+
+    struct Config {
+        std::string group;  // 组播地址（IPv4），空表示不启用
+        uint16_t port = 0;
+        std::string iface;  // 发送接口的地址（空表示由路由决定）
+        int ttl = 1;        // 只在本网段内传播
+        size_t historyFrames = 8192;            // 补发环保留的帧数上限
+        size_t historyBytes = 8 * 1024 * 1024;  // 补发环的字节上限
+    };
+
+    MulticastPublisher() = default;
+    ~MulticastPublisher() { stop(); }
+
+    MulticastPublisher(const MulticastPublisher&) = delete;
+    MulticastPublisher& operator=(const MulticastPublisher&) = delete;
+
+    bool start(const Config& cfg);  // 创建发送套接字并启动心跳线程
+    void stop();
+    bool enabled() const { return running_.load(std::memory_order_relaxed); }
+
+    // 发送一条聊天广播并放入补发环（分发线程按序号顺序调用）
+    void publish(uint64_t seq, const Wire& wire);
+    // 取出 [first, first + count) 中仍在补发环里的帧，返回其中已被淘汰的条数
+    // （从 first 开始连续）
+    uint32_t collect(uint64_t first, uint32_t count, std::vector<Wire>& out);
+    // MULTICAST_GROUP 帧的负载：[4 实例号][2 端口][组地址]
+    std::string groupInfo() const;
+
+    size_t memoryBytes() const {
+        return historyBytes_.load(std::memory_order_relaxed);
+    }
+
+   private:
+    void heartbeatLoop();
+    void sendDatagram(const std::string& d);
+
+   private:
+    // 单个数据报携带的帧上限：不超过以太网 MTU，避免 IP 分片放大丢包
+    static constexpr size_t kMaxFrame = 1400;
+    static constexpr int kHeartbeatMs = 200;  // 空闲时的心跳周期
+
+    Config cfg_;
+    SOCKET sock_{INVALID_SOCKET};
+    sockaddr_in dest_{};
+    uint32_t instance_{0};  // 每次启动随机生成，接收方据此忽略其他实例
+    std::atomic<bool> running_{false};
+    std::thread heartbeat_;
+    std::condition_variable cv_;
+
+    std::mutex mtx_;            // 保护以下成员与 sock_ 上的发送
+    std::deque<Wire> history_;  // 序号 [historyBase_, historyBase_ + size)
+    uint64_t historyBase_{0};
+    uint64_t lastSeq_{0};                  // 最近发送的序号
+    uint64_t lastSendNs_{0};               // 最近一次发送的时间
+    std::string datagram_;                 // 复用的发送缓冲
+    std::atomic<size_t> historyBytes_{0};  // 补发环中帧的字节数
+};
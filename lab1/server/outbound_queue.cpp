@@ -0,0 +1,127 @@
+#include "outbound_queue.h"
+
+/**
+ * 入队普通帧
+ * @param frame 已编码的帧
+ * @return 是否入队成功
+ */
+bool OutboundQueue::push(Wire frame) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!admit(frame, false)) return false;
+        control_.push_back(std::move(frame));
+    }
+    cv_.notify_one();
+    return true;
+}
+
+/**
+ * 入队流帧
+ * @param streamId 服务端流编号
+ * @param frame 已编码的帧
+ * @return 是否入队成功
+ */
+bool OutboundQueue::pushStream(uint32_t streamId, Wire frame) {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!admit(frame, true)) return false;
+        auto& q = streams_[streamId];
+        if (q.empty()) ready_.push_back(streamId);  // 重新加入轮转
+        q.push_back(std::move(frame));
+    }
+    cv_.notify_one();
+    return true;
+}
+
+/**
+ * 取出下一帧
+ * @param out 输出帧
+ * @return 队列关闭时返回 false
+ */
+bool OutboundQueue::pop(Wire& out) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    cv_.wait(lock,
+             [this] { return closed_ || !control_.empty() || !ready_.empty(); });
+    if (closed_) return false;
+    take(out);
+    return true;
+}
+
+/**
+ * 非阻塞取出下一帧
+ * @param out 输出帧
+ * @return 队列为空或已关闭时返回 false
+ */
+bool OutboundQueue::tryPop(Wire& out) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (closed_ || (control_.empty() && ready_.empty())) return false;
+    take(out);
+    return true;
+}
+
+/**
+ * 关闭队列，丢弃未发送的帧
+ */
+void OutboundQueue::close() {
+    // 帧在锁外释放：带回执的帧在释放时会回调发送者的回执状态
+    std::deque<Wire> control;
+    std::unordered_map<uint32_t, std::deque<Wire>> streams;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        closed_ = true;
+        control.swap(control_);
+        streams.swap(streams_);
+        ready_.clear();
+        bytes_ = 0;
+        streamBytes_ = 0;
+    }
+    cv_.notify_all();
+}
+
+size_t OutboundQueue::queuedBytes() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return bytes_ + streamBytes_;
+}
+
+size_t OutboundQueue::streamQueuedBytes() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return streamBytes_;
+}
+
+size_t OutboundQueue::spareBytes() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return closed_ ? 0 : maxBytes_ - bytes_;
+}
+
+bool OutboundQueue::admit(const Wire& frame, bool stream) {
+    size_t& used = stream ? streamBytes_ : bytes_;
+    size_t limit = stream ? maxStreamBytes_ : maxBytes_;
+    if (closed_ || used + frame->size() > limit) return false;
+    used += frame->size();
+    return true;
+}
+
+void OutboundQueue::take(Wire& out) {
+    bool takeControl =
+        !control_.empty() && (ready_.empty() || burst_ < kControlBurst);
+    if (takeControl) {
+        out = std::move(control_.front());
+        control_.pop_front();
+        ++burst_;
+        bytes_ -= out->size();
+    } else {
+        // 轮转：取队首流的一个分片，仍有分片则放回队尾
+        uint32_t id = ready_.front();
+        ready_.pop_front();
+        auto it = streams_.find(id);
+        out = std::move(it->second.front());
+        it->second.pop_front();
+        if (it->second.empty()) {
+            streams_.erase(it);
+        } else {
+            ready_.push_back(id);
+        }
+        burst_ = 0;
+        streamBytes_ -= out->size();
+    }
+}
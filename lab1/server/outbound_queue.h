@@ -0,0 +1,61 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * 单个客户端的发送队列，由会话的写线程消费
+ * - 普通帧（聊天、加入/离开、检索结果）优先发送
+ * - 流分片按流轮转，每次只发送一个分片，大文件不会长时间占用套接字
+ * - 连续发送 kControlBurst 个普通帧后让出一次给流分片，避免流被饿死
+ * - 普通帧与流帧各有字节上限：上传中的大文件不会占用聊天消息的额度
+ */
+class OutboundQueue {
+   public:
+    // 已编码的完整帧（帧头 + 负载），广播时多个队列共享同一份数据
+    using Wire = std::shared_ptr<const std::string>;
+
+    OutboundQueue(size_t maxBytes, size_t maxStreamBytes)
+        : maxBytes_(maxBytes), maxStreamBytes_(maxStreamBytes) {}
+
+    // 入队普通帧；队列已关闭或普通帧超过字节上限时返回 false
+    bool push(Wire frame);
+    // 入队流帧（同一流内保持顺序）；队列已关闭或流帧超过字节上限时返回 false
+    bool pushStream(uint32_t streamId, Wire frame);
+    // 阻塞取出下一帧；队列关闭时返回 false
+    bool pop(Wire& out);
+    // 非阻塞取出下一帧；队列为空或已关闭时返回 false（仿真模式使用）
+    bool tryPop(Wire& out);
+    // 关闭队列并唤醒写线程
+    void close();
+
+    size_t queuedBytes() const;        // 普通帧与流帧合计
+    size_t streamQueuedBytes() const;  // 流帧
+    // 普通帧还能入队的字节数；队列已关闭时为 0
+    size_t spareBytes() const;
+
+   private:
+    // 检查关闭状态与对应类别的字节上限（需持锁）
+    bool admit(const Wire& frame, bool stream);
+    void take(Wire& out);  // 按优先级与轮转顺序取出一帧（需持锁且非空）
+
+   private:
+    static constexpr int kControlBurst = 8;
+
+    mutable std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<Wire> control_;                                // 普通帧
+    std::unordered_map<uint32_t, std::deque<Wire>> streams_;  // 各流待发分片
+    std::deque<uint32_t> ready_;  // 有待发分片的流（轮转顺序）
+    size_t bytes_{0};             // 已排队的普通帧字节数
+    size_t streamBytes_{0};       // 已排队的流帧字节数
+    size_t maxBytes_;             // 普通帧字节上限
+    size_t maxStreamBytes_;       // 流帧字节上限
+    int burst_{0};                // 连续发送的普通帧数
+    bool closed_{false};
+};
@@ -0,0 +1,142 @@
+#include "receipts.h"
+
+#include <chrono>
+
+#include "common/protocol.h"
+
+using namespace chatproto;
+
+/**
+ * 创建带回执的共享帧
+ * @param id 消息编号
+ * @param frame 已编码的完整帧（new 分配，由返回的共享指针接管）
+ */
+OutboundQueue::Wire ReceiptTracker::track(uint64_t id, std::string* frame) {
+    return OutboundQueue::Wire(frame, Deleter{shared_from_this(), id, 0});
+}
+
+/**
+ * 分发完成
+ * @param wire 已放入各接收者队列的帧
+ * @param recipients 成功入队的接收者数
+ * @note 在分发线程上按提交顺序调用，受理编号单调递增
+ */
+void ReceiptTracker::accepted(const OutboundQueue::Wire& wire,
+                              uint32_t recipients) {
+    auto* d = std::get_deleter<Deleter>(wire);
+    if (!d) return;
+    d->recipients = recipients;  // 分发持有引用，删除器此时尚未执行
+    d->tracker->accepted_.store(d->id, std::memory_order_relaxed);
+    d->tracker->markDirty();
+}
+
+bool ReceiptTracker::tracked(const OutboundQueue::Wire& wire) {
+    return std::get_deleter<Deleter>(wire) != nullptr;
+}
+
+void ReceiptTracker::Deleter::operator()(const std::string* p) const {
+    delete p;
+    tracker->onDelivered(id, recipients);
+}
+
+void ReceiptTracker::onDelivered(uint64_t id, uint32_t recipients) {
+    if (!deliveries_) return;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (id != delivered_ + 1) {
+            early_.emplace(id, recipients);
+            return;  // 前面还有未送达的消息
+        }
+        delivered_ = id;
+        reach_ = recipients;
+        for (auto it = early_.begin();
+             it != early_.end() && it->first == delivered_ + 1;
+             it = early_.erase(it)) {
+            delivered_ = it->first;
+            reach_ = it->second;
+        }
+    }
+    markDirty();
+}
+
+void ReceiptTracker::markDirty() {
+    if (!scheduled_.exchange(true, std::memory_order_acq_rel))
+        batcher_->schedule(shared_from_this());
+}
+
+void ReceiptTracker::detach() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    queue_ = nullptr;
+}
+
+/**
+ * 生成回执帧：[8 已受理][8 已送达][4 已送达那条消息的接收者数]
+ * @note 先清除登记标记再读取状态，读取之后的变化会重新登记
+ */
+void ReceiptTracker::flush() {
+    scheduled_.store(false, std::memory_order_release);
+    uint64_t accepted = accepted_.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!queue_) return;
+    if (accepted == sentAccepted_ && delivered_ == sentDelivered_) return;
+    sentAccepted_ = accepted;
+    sentDelivered_ = delivered_;
+    std::string payload;
+    putU64(payload, accepted);
+    putU64(payload, deliveries_ ? delivered_ : 0);
+    putU32(payload, deliveries_ ? reach_ : 0);
+    // 持锁入队：detach 之后会话才会销毁，队列指针在此期间有效
+    queue_->push(std::make_shared<const std::string>(
+        encodeFrame(MsgType::RECEIPT, payload)));
+}
+
+/**
+ * 启动批量发送线程
+ * @param intervalMs 合并周期（毫秒）
+ */
+void ReceiptBatcher::start(int intervalMs) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (running_) return;
+    intervalMs_ = intervalMs;
+    running_ = true;
+    thread_ = std::thread(&ReceiptBatcher::loop, this);
+}
+
+void ReceiptBatcher::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!running_) return;
+        running_ = false;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+    pending_.clear();
+}
+
+/**
+ * 登记有变化的会话
+ * @param tracker 回执状态
+ */
+void ReceiptBatcher::schedule(std::shared_ptr<ReceiptTracker> tracker) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!running_) return;
+    pending_.push_back(std::move(tracker));
+    if (pending_.size() == 1) cv_.notify_one();
+}
+
+void ReceiptBatcher::loop() {
+    std::vector<std::shared_ptr<ReceiptTracker>> batch;
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (running_) {
+        cv_.wait(lock, [this] { return !pending_.empty() || !running_; });
+        // 等待一个周期，期间的变化合并到同一帧
+        cv_.wait_for(lock, std::chrono::milliseconds(intervalMs_),
+                     [this] { return !running_; });
+        if (!running_) break;
+        batch.swap(pending_);
+        lock.unlock();
+        for (auto& t : batch) t->flush();
+        batch.clear();  // 可能释放最后一个引用，不持锁
+        lock.lock();
+    }
+}
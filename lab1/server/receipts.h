@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "outbound_queue.h"
+
+class ReceiptBatcher;
+
+/**
+ * 单个会话的消息回执（累积确认）
+ * - 消息编号：本连接内第 N 条 CHAT / CHAT_TRACED（从 1 开始），收发双方各自
+ *   计数，上行不增加字节
+ * - 受理：编号为 id 的广播已放入所有在线接收者的队列，accepted 前移到 id
+ * - 送达（可选）：广播帧的最后一个引用释放时计为送达，即各接收者的写线程已
+ *   写出（或接收者已断开而丢弃）；乱序完成的编号暂存，delivered 只连续前移
+ * - 帧本身携带回执：带自定义删除器的共享帧，分发与写线程的路径不变
+ * - 回执帧不逐条发送：状态变化后交给 ReceiptBatcher，每个周期最多一帧
+ */
+class ReceiptTracker : public std::enable_shared_from_this<ReceiptTracker> {
+   public:
+    /**
+     * @param batcher 回执帧的批量发送者
+     * @param queue 所属会话的发送队列
+     * @param base 开启回执时已处理的消息数（此前的消息不再确认）
+     * @param deliveries 是否同时报告送达
+     */
+    ReceiptTracker(ReceiptBatcher* batcher, OutboundQueue* queue,
+                   uint64_t base, bool deliveries)
+        : batcher_(batcher),
+          queue_(queue),
+          deliveries_(deliveries),
+          accepted_(base),
+          delivered_(base),
+          sentAccepted_(base),
+          sentDelivered_(base) {}
+
+    // 为编号 id 的广播创建带回执的共享帧（接管 frame 的所有权）
+    OutboundQueue::Wire track(uint64_t id, std::string* frame);
+    // 分发完成：记录接收者数并前移受理编号（帧不带回执时忽略）
+    static void accepted(const OutboundQueue::Wire& wire, uint32_t recipients);
+    // 帧是否带回执（长期保存该帧的一方应改存副本，以免推迟送达）
+    static bool tracked(const OutboundQueue::Wire& wire);
+
+    void detach();  // 会话结束：之后不再发送回执帧
+    void flush();   // 状态有变化时生成回执帧并入队（ReceiptBatcher 调用）
+
+   private:
+    // 共享帧的删除器：最后一个引用释放时报告送达
+    struct Deleter {
+        std::shared_ptr<ReceiptTracker> tracker;
+        uint64_t id;
+        uint32_t recipients;
+        void operator()(const std::string* p) const;
+    };
+
+    void onDelivered(uint64_t id, uint32_t recipients);
+    void markDirty();
+
+   private:
+    ReceiptBatcher* batcher_;
+    std::mutex mtx_;
+    OutboundQueue* queue_;  // 会话结束后置空（受 mtx_ 保护）
+    const bool deliveries_;
+    std::atomic<uint64_t> accepted_;
+    std::atomic<bool> scheduled_{false};  // 已交给 ReceiptBatcher、尚未发送
+
+    // 以下受 mtx_ 保护
+    uint64_t delivered_;
+    uint32_t reach_{0};                   // delivered_ 那条消息的接收者数
+    std::map<uint64_t, uint32_t> early_;  // 已送达但前面仍有未送达的编号
+    uint64_t sentAccepted_;               // 上一帧回执的内容
+    uint64_t sentDelivered_;
+};
+
+/**
+ * 回执帧的批量发送线程
+ * - 会话的回执状态变化时登记一次；等待一个周期后统一生成回执帧
+ * - 同一周期内的多次变化合并为一帧，回执流量与消息速率无关
+ */
+class ReceiptBatcher {
+   public:
+    ReceiptBatcher() = default;
+    ~ReceiptBatcher() { stop(); }
+
+    ReceiptBatcher(const ReceiptBatcher&) = delete;
+    ReceiptBatcher& operator=(const ReceiptBatcher&) = delete;
+
+    void start(int intervalMs);  // 合并周期（毫秒）
+    void stop();
+    void schedule(std::shared_ptr<ReceiptTracker> tracker);
+
+   private:
+    void loop();
+
+   private:
+    int intervalMs_{5};
+    std::thread thread_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool running_{false};
+    std::vector<std::shared_ptr<ReceiptTracker>> pending_;
+};
@@ -0,0 +1,533 @@
+#include "search_index.h"
+
+#include <algorithm>
+#include <chrono>
+#include <unordered_set>
+
+#include "metrics.h"
+
+namespace {
+// 缓冲段达到该文档数后封存
+constexpr size_t kSealDocs = 4096;
+// 缓冲段中最早的消息等待超过该时间后封存，保证新消息很快可被检索
+// （按缓冲段开始时刻计时，持续有少量消息写入时也不会一直等到 kSealDocs 条）
+constexpr auto kSealDelay = std::chrono::milliseconds(50);
+// 文档与倒排表的内存上限，超过后丢弃最旧的段，降到上限的 3/4
+constexpr size_t kMaxIndexBytes = 256u << 20;
+// 待建索引队列的内存上限，索引线程跟不上时丢弃最旧的待处理消息
+constexpr size_t kMaxQueuedBytes = 32u << 20;
+// 段数量超过该值时触发后台合并
+constexpr size_t kMergeTrigger = 8;
+// 每次合并的相邻段数量
+constexpr size_t kMergeFactor = 4;
+// 单个拉丁词项的最大字节数
+constexpr size_t kMaxTermBytes = 32;
+
+/**
+ * 解码一个 UTF-8 码点，非法序列按单字节跳过
+ * @param s 字符串
+ * @param i 当前下标，返回时指向下一个码点
+ */
+uint32_t nextCodepoint(const std::string& s, size_t& i) {
+    auto b = static_cast<uint8_t>(s[i]);
+    size_t n = b < 0x80 ? 1 : (b >> 5) == 0x6 ? 2 : (b >> 4) == 0xE ? 3
+                                        : (b >> 3) == 0x1E ? 4 : 0;
+    if (n == 0 || i + n > s.size()) {
+        ++i;
+        return 0xFFFD;
+    }
+    uint32_t cp = n == 1 ? b : b & (0xFF >> (n + 1));
+    for (size_t k = 1; k < n; ++k) {
+        cp = (cp << 6) | (static_cast<uint8_t>(s[i + k]) & 0x3F);
+    }
+    i += n;
+    return cp;
+}
+
+void appendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+// 中日韩表意文字、假名与谚文音节：按字切分
+bool isCjk(uint32_t cp) {
+    return (cp >= 0x3040 && cp <= 0x30FF) ||  // 平假名、片假名
+           (cp >= 0x3400 && cp <= 0x4DBF) ||  // 扩展 A
+           (cp >= 0x4E00 && cp <= 0x9FFF) ||  // 基本区
+           (cp >= 0xAC00 && cp <= 0xD7AF) ||  // 谚文音节
+           (cp >= 0xF900 && cp <= 0xFAFF) ||  // 兼容表意文字
+           (cp >= 0x20000 && cp <= 0x2FA1F);  // 扩展 B 及以后
+}
+
+// 拉丁词字符：ASCII 字母数字，以及标点/符号区以外的其他字母
+bool isWordChar(uint32_t cp) {
+    if (cp < 0x80) {
+        return (cp >= '0' && cp <= '9') || (cp >= 'a' && cp <= 'z') ||
+               (cp >= 'A' && cp <= 'Z');
+    }
+    if (cp < 0xC0 || cp == 0xD7 || cp == 0xF7) return false;
+    if (cp >= 0x2000 && cp <= 0x2BFF) return false;  // 通用标点与符号
+    if (cp >= 0x3000 && cp <= 0x303F) return false;  // CJK 标点
+    if (cp >= 0xFE30 && cp <= 0xFE4F) return false;  // CJK 兼容标点
+    if (cp >= 0xFF00 && cp <= 0xFFEF) return false;  // 全角标点（字母数字已折叠）
+    if (cp >= 0x1F000) return false;                 // 表情与其他符号
+    return !isCjk(cp);
+}
+
+// 全角 ASCII 折叠为半角，大写转小写
+uint32_t foldCase(uint32_t cp) {
+    if (cp >= 0xFF01 && cp <= 0xFF5E) cp -= 0xFEE0;
+    if (cp >= 'A' && cp <= 'Z') cp += 'a' - 'A';
+    return cp;
+}
+}  // namespace
+
+/**
+ * 启动索引线程与合并线程
+ */
+void SearchIndex::start() {
+    if (running_.exchange(true)) return;
+    indexThread_ = std::thread(&SearchIndex::indexLoop, this);
+    mergeThread_ = std::thread(&SearchIndex::mergeLoop, this);
+}
+
+/**
+ * 停止后台线程；队列中剩余消息会在索引线程退出前处理完毕
+ */
+void SearchIndex::stop() {
+    if (!running_.exchange(false)) return;
+    queueCv_.notify_all();
+    {
+        std::lock_guard<std::mutex> lock(segMtx_);
+        mergeCv_.notify_all();
+    }
+    if (indexThread_.joinable()) indexThread_.join();
+    if (mergeThread_.joinable()) mergeThread_.join();
+}
+
+/**
+ * 提交一条广播消息，仅入队，不在调用线程上分词
+ * @param from 发送者昵称
+ * @param text 消息文本
+ */
+void SearchIndex::add(const std::string& from, const std::string& text) {
+    if (!running_.load(std::memory_order_relaxed)) return;
+    Doc doc{from, text};
+    size_t bytes = docBytes(doc);
+    size_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(queueMtx_);
+        // 超过上限时先丢弃最旧的待处理消息，与 trimOldest 一样优先保留新消息
+        while (!queue_.empty() && queuedBytes_ + bytes > kMaxQueuedBytes) {
+            size_t b = docBytes(queue_.front());
+            queuedBytes_ -= b;
+            pendingBytes_.fetch_sub(b, std::memory_order_relaxed);
+            queue_.pop_front();
+            ++dropped;
+        }
+        queuedBytes_ += bytes;
+        pendingBytes_.fetch_add(bytes, std::memory_order_relaxed);
+        queue_.push_back(std::move(doc));
+    }
+    if (dropped > 0) metrics::inc(metrics::SEARCH_DROPPED, dropped);
+    queueCv_.notify_one();
+}
+
+/**
+ * 分词
+ * @param utf8 UTF-8 文本
+ * @param forQuery 查询分词：CJK 连续串只输出二元组（单字串输出单字）
+ * @note 索引时 CJK 同时输出单字与二元组，保证单字与多字查询都能命中
+ */
+std::vector<std::string> SearchIndex::tokenize(const std::string& utf8,
+                                               bool forQuery) {
+    std::vector<std::string> out;
+    std::string word;
+    std::vector<uint32_t> run;  // 当前 CJK 连续串
+
+    auto flushWord = [&] {
+        if (!word.empty()) out.push_back(std::move(word));
+        word.clear();
+    };
+    auto flushRun = [&] {
+        for (size_t k = 0; k < run.size(); ++k) {
+            if (!forQuery || run.size() == 1) {
+                std::string uni;
+                appendUtf8(uni, run[k]);
+                out.push_back(std::move(uni));
+            }
+            if (k + 1 < run.size()) {
+                std::string bi;
+                appendUtf8(bi, run[k]);
+                appendUtf8(bi, run[k + 1]);
+                out.push_back(std::move(bi));
+            }
+        }
+        run.clear();
+    };
+
+    size_t i = 0;
+    while (i < utf8.size()) {
+        uint32_t cp = foldCase(nextCodepoint(utf8, i));
+        if (isCjk(cp)) {
+            flushWord();
+            run.push_back(cp);
+        } else if (isWordChar(cp)) {
+            flushRun();
+            if (word.size() < kMaxTermBytes) appendUtf8(word, cp);
+        } else {
+            flushWord();
+            flushRun();
+        }
+    }
+    flushWord();
+    flushRun();
+    return out;
+}
+
+/**
+ * 查询
+ * @param query 查询文本
+ * @param limit 最多返回条数
+ * @return 命中的消息，从新到旧
+ */
+std::vector<SearchIndex::Hit> SearchIndex::search(const std::string& query,
+                                                  size_t limit) const {
+    std::vector<std::string> terms = tokenize(query, true);
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+    std::vector<Hit> hits;
+    if (terms.empty() || limit == 0) return hits;
+
+    auto segs = snapshot();  // 快照之后无锁检索
+    std::vector<uint32_t> ids;
+    std::vector<const std::string*> lists;
+    std::vector<uint32_t> cur, next, merged;
+    for (auto it = segs->rbegin(); it != segs->rend() && ids.size() < limit;
+         ++it) {
+        const Segment& seg = **it;
+        lists.clear();
+        for (const auto& t : terms) {
+            auto p = seg.postings.find(t);
+            if (p == seg.postings.end()) break;
+            lists.push_back(&p->second);
+        }
+        if (lists.size() != terms.size()) continue;  // 有词项未出现在该段
+        // 从最短的倒排表开始求交集
+        std::sort(lists.begin(), lists.end(),
+                  [](const std::string* a, const std::string* b) {
+                      return a->size() < b->size();
+                  });
+        decodePostings(*lists[0], cur);
+        for (size_t k = 1; k < lists.size() && !cur.empty(); ++k) {
+            decodePostings(*lists[k], next);
+            merged.clear();
+            std::set_intersection(cur.begin(), cur.end(), next.begin(),
+                                  next.end(), std::back_inserter(merged));
+            cur.swap(merged);
+        }
+        for (auto r = cur.rbegin(); r != cur.rend() && ids.size() < limit; ++r)
+            ids.push_back(*r);
+    }
+
+    std::shared_lock<std::shared_mutex> lock(docsMtx_);
+    hits.reserve(ids.size());
+    for (uint32_t id : ids) {
+        if (id < docBase_) continue;  // 快照之后被内存限制丢弃
+        const Doc& d = docs_[id - docBase_];
+        hits.push_back({id, d.from, d.text});
+    }
+    return hits;
+}
+
+/**
+ * 索引线程：批量取出队列中的消息，分词后写入缓冲段
+ */
+void SearchIndex::indexLoop() {
+    using Clock = std::chrono::steady_clock;
+    std::unordered_map<std::string, std::vector<uint32_t>> buf;
+    uint32_t firstDoc = 0;
+    size_t docCount = 0;
+    Clock::time_point sealAt;  // 缓冲段的封存时刻，缓冲段非空时有效
+    std::deque<Doc> batch;
+    std::unordered_set<std::string> seen;
+    auto sealBuffer = [&] {
+        seal(buf, firstDoc, firstDoc + docCount - 1, docCount);
+        docCount = 0;
+        size_t used = memoryBytes();
+        if (used > kMaxIndexBytes) trimOldest(used - kMaxIndexBytes / 4 * 3);
+    };
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(queueMtx_);
+            auto ready = [this] {
+                return !queue_.empty() || !running_.load();
+            };
+            if (docCount > 0) {
+                queueCv_.wait_until(lock, sealAt, ready);
+            } else {
+                queueCv_.wait(lock, ready);
+            }
+            if (queue_.empty() && !running_.load()) break;
+            batch.swap(queue_);
+            queuedBytes_ = 0;
+        }
+
+        if (!batch.empty()) {
+            uint32_t base;
+            {
+                std::shared_lock<std::shared_mutex> lock(docsMtx_);
+                base = docBase_ + static_cast<uint32_t>(docs_.size());
+            }
+            if (docCount == 0) {
+                firstDoc = base;
+                sealAt = Clock::now() + kSealDelay;
+            }
+            for (size_t k = 0; k < batch.size(); ++k) {
+                seen.clear();
+                for (auto& t : tokenize(batch[k].text, false)) {
+                    if (seen.insert(t).second) {
+                        buf[t].push_back(base + static_cast<uint32_t>(k));
+                    }
+                }
+            }
+            {
+                // 文档先于段发布，保证检索到的 docId 一定可读
+                std::unique_lock<std::shared_mutex> lock(docsMtx_);
+                for (auto& d : batch) {
+                    // 从待处理转入文档存储，memoryBytes() 始终计入这部分内存
+                    size_t b = docBytes(d);
+                    docBytes_.fetch_add(b, std::memory_order_relaxed);
+                    pendingBytes_.fetch_sub(b, std::memory_order_relaxed);
+                    docs_.push_back(std::move(d));
+                }
+            }
+            docCount += batch.size();
+            batch.clear();
+        }
+        // 缓冲段写满或等待到期：封存，使其可被检索
+        if (docCount >= kSealDocs || (docCount > 0 && Clock::now() >= sealAt)) {
+            sealBuffer();
+        }
+    }
+    if (docCount > 0) sealBuffer();
+}
+
+/**
+ * 封存缓冲段：压缩倒排表并发布到段列表
+ */
+void SearchIndex::seal(
+    std::unordered_map<std::string, std::vector<uint32_t>>& buf,
+    uint32_t firstDoc, uint32_t lastDoc, size_t docCount) {
+    auto seg = std::make_shared<Segment>();
+    seg->firstDoc = firstDoc;
+    seg->lastDoc = lastDoc;
+    seg->docCount = docCount;
+    seg->postings.reserve(buf.size());
+    for (auto& [term, ids] : buf) {
+        std::string enc;
+        uint32_t prev = 0;
+        for (uint32_t id : ids) {
+            appendVarint(enc, id - prev);
+            prev = id;
+        }
+        seg->postings.emplace(term, std::move(enc));
+    }
+    buf.clear();
+    seg->bytes = postingsBytes(*seg);
+    segBytes_.fetch_add(seg->bytes, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(segMtx_);
+    auto list = std::make_shared<SegmentList>(*segments_);
+    list->push_back(std::move(seg));
+    segments_ = std::move(list);
+    if (segments_->size() > kMergeTrigger) mergeCv_.notify_one();
+}
+
+/**
+ * 合并线程：段数量过多时，选取总文档数最小的相邻 kMergeFactor 个段合并
+ */
+void SearchIndex::mergeLoop() {
+    while (true) {
+        SegmentList parts;
+        {
+            std::unique_lock<std::mutex> lock(segMtx_);
+            mergeCv_.wait(lock, [this] {
+                return !running_.load() || segments_->size() > kMergeTrigger;
+            });
+            if (!running_.load()) return;
+            const SegmentList& segs = *segments_;
+            size_t best = 0, bestDocs = SIZE_MAX;
+            for (size_t i = 0; i + kMergeFactor <= segs.size(); ++i) {
+                size_t docs = 0;
+                for (size_t k = 0; k < kMergeFactor; ++k)
+                    docs += segs[i + k]->docCount;
+                if (docs < bestDocs) {
+                    bestDocs = docs;
+                    best = i;
+                }
+            }
+            parts.assign(segs.begin() + best,
+                         segs.begin() + best + kMergeFactor);
+        }
+
+        SegmentPtr merged = mergeSegments(parts);  // 锁外合并
+
+        std::lock_guard<std::mutex> lock(segMtx_);
+        // 段列表只会在末尾追加、在开头丢弃：首段仍在则被合并的段仍然连续存在
+        const SegmentList& segs = *segments_;
+        auto first = std::find(segs.begin(), segs.end(), parts.front());
+        if (first == segs.end()) continue;  // 合并期间被 trimOldest 丢弃
+        for (const auto& p : parts)
+            segBytes_.fetch_sub(p->bytes, std::memory_order_relaxed);
+        segBytes_.fetch_add(merged->bytes, std::memory_order_relaxed);
+        auto list = std::make_shared<SegmentList>(segs.begin(), first);
+        list->push_back(std::move(merged));
+        list->insert(list->end(), first + kMergeFactor, segs.end());
+        segments_ = std::move(list);
+    }
+}
+
+/**
+ * 合并若干相邻段（docId 区间不重叠且递增）
+ * @param parts 按 docId 排序的段
+ */
+SearchIndex::SegmentPtr SearchIndex::mergeSegments(const SegmentList& parts) {
+    auto seg = std::make_shared<Segment>();
+    seg->firstDoc = parts.front()->firstDoc;
+    seg->lastDoc = parts.back()->lastDoc;
+    std::unordered_map<std::string, uint32_t> lastId;  // 每个词项最后写入的 docId
+    std::vector<uint32_t> ids;
+    for (const auto& part : parts) {
+        seg->docCount += part->docCount;
+        for (const auto& [term, enc] : part->postings) {
+            decodePostings(enc, ids);
+            auto [it, fresh] = lastId.emplace(term, 0);
+            std::string& out = seg->postings[term];
+            uint32_t prev = fresh ? 0 : it->second;
+            for (uint32_t id : ids) {
+                appendVarint(out, id - prev);
+                prev = id;
+            }
+            it->second = prev;
+        }
+    }
+    seg->bytes = postingsBytes(*seg);
+    return seg;
+}
+
+/**
+ * 估算倒排表占用：词项与编码长度，加上每个哈希表节点的固定开销
+ * @param seg 段
+ */
+size_t SearchIndex::postingsBytes(const Segment& seg) {
+    constexpr size_t kNodeOverhead = 96;  // 节点、两个 std::string 与桶指针
+    size_t n = sizeof(Segment);
+    for (const auto& [term, enc] : seg.postings)
+        n += term.capacity() + enc.capacity() + kNodeOverhead;
+    return n;
+}
+
+size_t SearchIndex::docBytes(const Doc& d) {
+    return sizeof(Doc) + d.from.capacity() + d.text.capacity();
+}
+
+size_t SearchIndex::memoryBytes() const {
+    return docBytes_.load(std::memory_order_relaxed) +
+           segBytes_.load(std::memory_order_relaxed) +
+           pendingBytes_.load(std::memory_order_relaxed);
+}
+
+/**
+ * 丢弃最旧的段及其文档（内存限制下的降级：最早的历史不再可检索）
+ * @param bytes 期望释放的字节数
+ * @return 实际释放的字节数（估算）
+ */
+size_t SearchIndex::trimOldest(size_t bytes) {
+    size_t avgDoc;
+    {
+        std::shared_lock<std::shared_mutex> lock(docsMtx_);
+        if (docs_.empty()) return 0;
+        avgDoc = docBytes_.load(std::memory_order_relaxed) / docs_.size();
+    }
+    size_t freed = 0;
+    uint32_t lastDoc = 0;
+    {
+        std::lock_guard<std::mutex> lock(segMtx_);
+        const SegmentList& segs = *segments_;
+        size_t n = 0, expect = 0;  // expect 含段内文档的估算，用于决定丢弃几段
+        for (; n < segs.size() && expect < bytes; ++n) {
+            expect += segs[n]->bytes + segs[n]->docCount * avgDoc;
+            freed += segs[n]->bytes;
+            lastDoc = segs[n]->lastDoc;
+        }
+        if (n == 0) return 0;
+        for (size_t k = 0; k < n; ++k)
+            segBytes_.fetch_sub(segs[k]->bytes, std::memory_order_relaxed);
+        segments_ = std::make_shared<SegmentList>(segs.begin() + n, segs.end());
+    }
+    // 段已不可见，再丢弃其文档；正在进行的检索用 docBase_ 跳过
+    std::unique_lock<std::shared_mutex> lock(docsMtx_);
+    while (!docs_.empty() && docBase_ <= lastDoc) {
+        size_t b = docBytes(docs_.front());
+        docBytes_.fetch_sub(b, std::memory_order_relaxed);
+        freed += b;
+        docs_.pop_front();
+        ++docBase_;
+    }
+    return freed;
+}
+
+std::shared_ptr<const SearchIndex::SegmentList> SearchIndex::snapshot() const {
+    std::lock_guard<std::mutex> lock(segMtx_);
+    return segments_;
+}
+
+size_t SearchIndex::pendingDocs() const {
+    std::lock_guard<std::mutex> lock(queueMtx_);
+    return queue_.size();
+}
+
+size_t SearchIndex::segmentCount() const { return snapshot()->size(); }
+
+// 无符号 LEB128 编码
+void SearchIndex::appendVarint(std::string& out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+// 解码差值 varint 倒排表为升序 docId
+void SearchIndex::decodePostings(const std::string& enc,
+                                 std::vector<uint32_t>& out) {
+    out.clear();
+    uint32_t prev = 0;
+    size_t i = 0;
+    while (i < enc.size()) {
+        uint32_t v = 0;
+        int shift = 0;
+        uint8_t b;
+        do {
+            b = static_cast<uint8_t>(enc[i++]);
+            v |= static_cast<uint32_t>(b & 0x7F) << shift;
+            shift += 7;
+        } while ((b & 0x80) && i < enc.size());
+        prev += v;
+        out.push_back(prev);
+    }
+}
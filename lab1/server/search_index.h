@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * 聊天历史全文检索索引（增量倒排索引）
+ * - 写入：广播路径只把消息放入队列，由索引线程分词并构建内存缓冲段
+ * - 段：缓冲段封存后不可变，倒排表按 docId 差值 + varint 压缩
+ * - 合并：后台合并线程把相邻的小段合并成大段，控制段数量
+ * - 查询：在锁内复制段列表快照后无锁检索，不阻塞广播线程
+ */
+class SearchIndex {
+   public:
+    struct Hit {
+        uint32_t docId;
+        std::string from;  // 发送者昵称（UTF-8）
+        std::string text;  // 消息文本（UTF-8）
+    };
+
+    SearchIndex() = default;
+    ~SearchIndex() { stop(); }
+
+    SearchIndex(const SearchIndex&) = delete;
+    SearchIndex& operator=(const SearchIndex&) = delete;
+
+    void start();
+    void stop();
+
+    // 提交一条广播消息（仅入队，O(1)）；队列超过上限时丢弃最旧的待处理消息
+    void add(const std::string& from, const std::string& text);
+    // 查询：所有词项均命中（AND），按时间从新到旧返回至多 limit 条
+    std::vector<Hit> search(const std::string& query, size_t limit) const;
+
+    size_t pendingDocs() const;   // 尚未建索引的消息数
+    size_t segmentCount() const;  // 当前段数
+    size_t memoryBytes() const;   // 待处理消息、文档与倒排表占用的内存（估算）
+    // 丢弃最旧的段及其文档，直到释放至少 bytes 字节或只剩缓冲中的消息
+    size_t trimOldest(size_t bytes);
+
+    // 分词：拉丁字母/数字按词切分并转小写，CJK 字符输出单字与相邻二元组
+    static std::vector<std::string> tokenize(const std::string& utf8,
+                                             bool forQuery);
+
+   private:
+    // 不可变段：term -> 压缩倒排表（docId 升序，差值 varint 编码）
+    struct Segment {
+        std::unordered_map<std::string, std::string> postings;
+        uint32_t firstDoc{0};  // 段内最小 docId
+        uint32_t lastDoc{0};   // 段内最大 docId
+        size_t docCount{0};
+        size_t bytes{0};  // 倒排表占用（估算）
+    };
+    using SegmentPtr = std::shared_ptr<const Segment>;
+    using SegmentList = std::vector<SegmentPtr>;
+
+    struct Doc {
+        std::string from;
+        std::string text;
+    };
+
+    void indexLoop();  // 索引线程：分词并封存缓冲段
+    void mergeLoop();  // 合并线程：合并相邻小段
+    void seal(std::unordered_map<std::string, std::vector<uint32_t>>& buf,
+              uint32_t firstDoc, uint32_t lastDoc, size_t docCount);
+    std::shared_ptr<const SegmentList> snapshot() const;
+    static SegmentPtr mergeSegments(const SegmentList& parts);
+    static size_t postingsBytes(const Segment& seg);
+    static size_t docBytes(const Doc& d);
+    static void appendVarint(std::string& out, uint32_t v);
+    static void decodePostings(const std::string& enc,
+                               std::vector<uint32_t>& out);
+
+   private:
+    // 写入队列
+    mutable std::mutex queueMtx_;
+    std::condition_variable queueCv_;
+    std::deque<Doc> queue_;
+    size_t queuedBytes_{0};  // queue_ 中消息的占用（估算），受 queueMtx_ 保护
+
+    // 文档存储（docId - docBase_ 即下标）
+    mutable std::shared_mutex docsMtx_;
+    std::deque<Doc> docs_;
+    uint32_t docBase_{0};  // 已丢弃的最旧文档数
+
+    std::atomic<size_t> docBytes_{0};   // 文档占用（估算）
+    std::atomic<size_t> segBytes_{0};   // 所有段的倒排表占用（估算）
+    std::atomic<size_t> pendingBytes_{0};  // 队列及索引线程中尚未入库的消息
+
+    // 段列表快照（写时复制）
+    mutable std::mutex segMtx_;
+    std::condition_variable mergeCv_;
+    std::shared_ptr<const SegmentList> segments_{
+        std::make_shared<SegmentList>()};
+
+    std::atomic<bool> running_{false};
+    std::thread indexThread_;
+    std::thread mergeThread_;
+};
@@ -0,0 +1,36 @@
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include "simulation.h"
+
+int main(int argc, char **argv) {
+    // 用法：chat_sim [seed] [clients] [messages]
+    Simulation::Config cfg;
+    if (argc >= 2) cfg.seed = std::stoull(argv[1]);
+    if (argc >= 3) cfg.clients = static_cast<uint32_t>(std::stoul(argv[2]));
+    if (argc >= 4) cfg.messages = std::stoull(argv[3]);
+    if (cfg.clients == 0) {
+        std::cerr << "clients must be positive" << std::endl;
+        return 1;
+    }
+
+    Simulation sim(cfg);
+    Simulation::Report r = sim.run();
+
+    char digest[32];
+    std::snprintf(digest, sizeof(digest), "%016llx",
+                  static_cast<unsigned long long>(r.digest));
+    std::cout << "seed " << cfg.seed << ", clients " << cfg.clients
+              << ", messages " << cfg.messages << std::endl;
+    std::cout << "events " << r.events << ", frames in " << r.framesIn
+              << ", frames out " << r.framesOut << ", bytes out "
+              << r.bytesOut << std::endl;
+    std::cout << "joins " << r.joins << ", leaves " << r.leaves
+              << ", evictions " << r.evictions << ", seq errors "
+              << r.seqErrors << std::endl;
+    std::cout << "virtual time " << r.virtualUs / 1000 << " ms, wall time "
+              << static_cast<long long>(r.wallMs) << " ms" << std::endl;
+    std::cout << "digest " << digest << std::endl;
+    return 0;
+}
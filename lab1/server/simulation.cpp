@@ -0,0 +1,314 @@
+#include "simulation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+
+using namespace chatproto;
+
+namespace {
+
+// 将一段字节并入摘要（按 8 字节分组的 FNV 变体）
+uint64_t mix(uint64_t h, const char* p, size_t n) {
+    constexpr uint64_t kPrime = 1099511628211ull;
+    while (n >= 8) {
+        uint64_t w;
+        std::memcpy(&w, p, 8);
+        h = (h ^ w) * kPrime;
+        p += 8;
+        n -= 8;
+    }
+    while (n--) h = (h ^ static_cast<uint8_t>(*p++)) * kPrime;
+    return h;
+}
+
+const char* const kWords[] = {"hello", "world", "lunch", "deploy", "build",
+                              "review", "ping",  "later", "你好",  "测试"};
+
+}  // namespace
+
+/**
+ * 运行仿真直到事件耗尽
+ * @return 统计与结果摘要；同一配置多次运行的摘要完全相同
+ */
+Simulation::Report Simulation::run() {
+    auto wall0 = std::chrono::steady_clock::now();
+    // 被驱逐的会话延后到当前事件结束时释放：驱逐可能发生在该会话自己的
+    // handleFrame 调用栈中
+    server_.disposeHook_ = [this](ClientSession* s) {
+        auto it = index_.find(s);
+        if (it != index_.end()) clients_[it->second].evicted = true;
+        evicted_.push_back(s);
+        return true;
+    };
+
+    clients_.resize(cfg_.clients);
+    for (uint32_t i = 0; i < cfg_.clients; ++i) {
+        clients_[i].slow = rng_.below(1000) < cfg_.slowPermille;
+        schedule(rng_.below(cfg_.thinkUs), i, Ev::CONNECT);
+    }
+
+    while (!events_.empty()) {
+        Event e = events_.top();
+        events_.pop();
+        now_ = e.at;
+        if (e.epoch != clients_[e.client].epoch) continue;  // 连接已断开
+        ++report_.events;
+        switch (e.kind) {
+            case Ev::CONNECT: connect(e.client); break;
+            case Ev::SEND: send(e.client); break;
+            case Ev::SERVER_READ: serverRead(e.client); break;
+            case Ev::SERVER_WRITE: serverWrite(e.client); break;
+            case Ev::CLIENT_READ: clientRead(e.client); break;
+        }
+        reap();
+    }
+
+    // 收尾：与 stop() 相同，直接释放仍在线的会话
+    server_.disposeHook_ = nullptr;
+    std::vector<ClientSession*> rest;
+    {
+        std::lock_guard<std::mutex> lock(server_.clientsMtx_);
+        rest.swap(server_.clients_);
+    }
+    server_.dispose(rest);
+    server_.reapRetired(true);
+    index_.clear();
+
+    report_.virtualUs = now_;
+    report_.digest = 1469598103934665603ull;
+    for (const auto& c : clients_) {
+        report_.digest = mix(report_.digest,
+                             reinterpret_cast<const char*>(&c.digest), 8);
+    }
+    report_.wallMs = std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - wall0)
+                         .count();
+    return report_;
+}
+
+/**
+ * 安排事件
+ * @param delayUs 相对当前虚拟时间的延迟
+ * @param idx 客户端下标
+ * @param kind 事件类型
+ */
+void Simulation::schedule(uint64_t delayUs, uint32_t idx, Ev kind) {
+    events_.push({now_ + delayUs, seq_++, idx, clients_[idx].epoch, kind});
+}
+
+/**
+ * 建立会话：相当于准入阶段收到 HELLO 后的 admit()，但不启动线程
+ */
+void Simulation::connect(uint32_t idx) {
+    Client& c = clients_[idx];
+    c.session = server_.attach(INVALID_SOCKET, "u" + std::to_string(idx));
+    index_[c.session] = idx;
+    ++report_.joins;
+    c.session->onJoin();
+    schedule(rng_.below(2ull * cfg_.thinkUs), idx, Ev::SEND);
+    schedule(c.slow ? cfg_.slowTickUs : cfg_.writeTickUs, idx,
+             Ev::SERVER_WRITE);
+}
+
+/**
+ * 客户端写出一帧：聊天为主，夹杂检索、大文件流与断开重连
+ */
+void Simulation::send(uint32_t idx) {
+    Client& c = clients_[idx];
+    MsgType type;
+    std::string payload;
+    uint64_t next = rng_.below(2ull * cfg_.thinkUs);
+    if (c.streamId != 0) {
+        // 流进行中：连续发送分片，最后发送 STREAM_END
+        putU32(payload, c.streamId);
+        if (c.streamLeft == 0) {
+            type = MsgType::STREAM_END;
+            payload.push_back(0);
+            c.streamId = 0;
+        } else {
+            type = MsgType::STREAM_CHUNK;
+            size_t n = std::min<uint64_t>(c.streamLeft, STREAM_CHUNK_SIZE);
+            payload.append(n, static_cast<char>('a' + idx % 26));
+            c.streamLeft -= n;
+            next /= 16;
+        }
+    } else if (sent_ >= cfg_.messages) {
+        return;  // 发送完毕，不再安排
+    } else {
+        uint64_t r = rng_.below(1000);
+        if (r < 5) {
+            type = MsgType::BYE;
+        } else if (r < 15) {
+            type = MsgType::SEARCH;
+            payload = kWords[rng_.below(std::size(kWords))];
+        } else if (r < 20) {
+            type = MsgType::STREAM_BEGIN;
+            c.streamId = c.nextStreamId++;
+            c.streamLeft = 1 + rng_.below(64 * 1024);
+            putU32(payload, c.streamId);
+            putU64(payload, c.streamLeft);
+            payload += "blob" + std::to_string(c.streamId);
+        } else {
+            type = MsgType::CHAT;
+            payload = chatText();
+            ++sent_;
+        }
+    }
+    c.up.buf += encodeFrame(type, payload);
+    transmit(idx, c.up, Ev::SERVER_READ);
+    if (type != MsgType::BYE) schedule(next, idx, Ev::SEND);
+}
+
+/**
+ * 会话处理线程：读取已到达的字节，逐帧交给 handleFrame
+ */
+void Simulation::serverRead(uint32_t idx) {
+    Client& c = clients_[idx];
+    c.up.pending = false;
+    c.up.delivered = std::min(c.up.buf.size(), c.up.delivered + chunk());
+    MsgType type;
+    size_t len;
+    while (parseFrame(c.up, type, len)) {
+        std::string payload = c.up.buf.substr(c.up.off + 5, len);
+        c.up.off += 5 + len;
+        ++report_.framesIn;
+        bool keep = c.session->handleFrame(type, payload);
+        if (c.evicted) return;  // 由 reap 收尾
+        if (!keep) {
+            // BYE 或协议错误：与 run() 退出时相同的收尾
+            ClientSession* s = c.session;
+            s->onLeave();
+            index_.erase(s);
+            delete s;
+            ++report_.leaves;
+            disconnect(idx);
+            return;
+        }
+    }
+    if (c.up.delivered < c.up.buf.size()) {
+        transmit(idx, c.up, Ev::SERVER_READ);
+    }
+    c.up.compact();
+}
+
+/**
+ * 会话写线程：每个周期最多写出 budget 帧到内存套接字
+ */
+void Simulation::serverWrite(uint32_t idx) {
+    Client& c = clients_[idx];
+    uint32_t budget = c.slow ? cfg_.slowBudget : cfg_.writeBudget;
+    OutboundQueue::Wire wire;
+    uint32_t n = 0;
+    while (n < budget && c.session->outq_.tryPop(wire)) {
+        c.down.buf += *wire;
+        ++n;
+    }
+    if (n > 0) transmit(idx, c.down, Ev::CLIENT_READ);
+    // 发送结束且队列已空时不再调度，使事件队列最终耗尽
+    if (n == 0 && sent_ >= cfg_.messages) return;
+    schedule(c.slow ? cfg_.slowTickUs : cfg_.writeTickUs, idx,
+             Ev::SERVER_WRITE);
+}
+
+/**
+ * 客户端读取：按帧并入摘要
+ */
+void Simulation::clientRead(uint32_t idx) {
+    Client& c = clients_[idx];
+    c.down.pending = false;
+    c.down.delivered =
+        std::min(c.down.buf.size(), c.down.delivered + chunk());
+    MsgType type;
+    size_t len;
+    while (parseFrame(c.down, type, len)) {
+        const char* f = c.down.buf.data() + c.down.off;
+        c.digest = mix(c.digest, f, 5 + len);
+        if (type == MsgType::SERVER_BROADCAST && len >= SEQ_HEADER_SIZE) {
+            // 同一连接内的聊天广播应按房间序号逐一递增
+            uint64_t seq = getU64(f + 5);
+            if (c.lastSeq != 0 && seq != c.lastSeq + 1) ++report_.seqErrors;
+            c.lastSeq = seq;
+        }
+        c.down.off += 5 + len;
+        ++report_.framesOut;
+        report_.bytesOut += 5 + len;
+    }
+    if (c.down.delivered < c.down.buf.size()) {
+        transmit(idx, c.down, Ev::CLIENT_READ);
+    }
+    c.down.compact();
+}
+
+/**
+ * 从已到达的字节中解析一帧的帧头
+ * @param p 管道
+ * @param type 输出消息类型
+ * @param len 输出负载长度
+ * @return 已到达完整一帧时返回 true
+ */
+bool Simulation::parseFrame(Pipe& p, MsgType& type, size_t& len) {
+    size_t avail = p.delivered - p.off;
+    if (avail < 5) return false;
+    const char* h = p.buf.data() + p.off;
+    len = getU32(h + 1);
+    if (avail < 5 + len) return false;
+    type = static_cast<MsgType>(static_cast<uint8_t>(h[0]));
+    return true;
+}
+
+/**
+ * 会话已释放：使该客户端未处理的事件失效，稍后重连
+ */
+void Simulation::disconnect(uint32_t idx) {
+    Client& c = clients_[idx];
+    c.session = nullptr;
+    c.evicted = false;
+    ++c.epoch;
+    c.up.clear();
+    c.down.clear();
+    c.streamId = 0;
+    c.streamLeft = 0;
+    c.lastSeq = 0;
+    if (sent_ < cfg_.messages) {
+        schedule(rng_.below(2ull * cfg_.thinkUs), idx, Ev::CONNECT);
+    }
+}
+
+/**
+ * 释放被驱逐的会话；收尾广播可能继续驱逐其他会话
+ */
+void Simulation::reap() {
+    while (!evicted_.empty()) {
+        ClientSession* s = evicted_.back();
+        evicted_.pop_back();
+        uint32_t idx = index_[s];
+        index_.erase(s);
+        ++report_.evictions;
+        s->onLeave();  // 真实服务器中由被关闭会话的 run() 执行
+        delete s;
+        disconnect(idx);
+    }
+}
+
+/**
+ * 写端有新数据：若对端尚无读事件则在一个网络时延后安排
+ */
+void Simulation::transmit(uint32_t idx, Pipe& p, Ev readEv) {
+    if (p.pending) return;
+    p.pending = true;
+    schedule(cfg_.latencyUs + rng_.below(cfg_.latencyUs + 1), idx, readEv);
+}
+
+size_t Simulation::chunk() { return 1 + rng_.below(8192); }
+
+std::string Simulation::chatText() {
+    std::string text = "m" + std::to_string(sent_);
+    uint64_t words = 1 + rng_.below(6);
+    for (uint64_t i = 0; i < words; ++i) {
+        text.push_back(' ');
+        text += kWords[rng_.below(std::size(kWords))];
+    }
+    return text;
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdint>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "chat_server.h"
+
+/**
+ * 确定性仿真：在单线程上用内存套接字、虚拟时钟和带种子的调度器驱动
+ * ChatServer 的会话逻辑（握手后的收帧处理、广播入队、写队列出队）
+ * - 不创建任何线程与真实套接字；同一种子的两次运行产生完全相同的事件序列，
+ *   结果摘要可用于二分定位顺序问题与性能回退
+ * - 内存套接字每次只交付随机长度的字节，覆盖半包、粘包
+ * - 慢客户端按较长周期、较小额度读取，可复现慢消费者驱逐
+ * - 握手准入阶段与检索索引的后台线程不参与仿真（SEARCH 查询空索引）
+ */
+class Simulation {
+   public:
+    struct Config {
+        uint64_t seed = 1;
+        uint32_t clients = 100;        // 客户端数量
+        uint64_t messages = 200000;    // 发送的 CHAT 总数
+        uint32_t thinkUs = 100000;     // 客户端平均发送间隔（虚拟微秒）
+        uint32_t latencyUs = 200;      // 单向网络基础时延
+        uint32_t writeTickUs = 10000;  // 写线程一次调度的周期
+        uint32_t writeBudget = 256;    // 每周期最多写出的帧数
+        uint32_t slowPermille = 20;    // 慢客户端比例（千分比）
+        uint32_t slowTickUs = 500000;  // 慢客户端的写周期
+        uint32_t slowBudget = 16;      // 慢客户端每周期写出的帧数
+    };
+
+    struct Report {
+        uint64_t events = 0;       // 处理的事件数
+        uint64_t framesIn = 0;     // 服务端收到的帧
+        uint64_t framesOut = 0;    // 客户端收到的帧
+        uint64_t bytesOut = 0;     // 客户端收到的字节
+        uint64_t joins = 0;        // 建立的会话
+        uint64_t leaves = 0;       // 主动离开（BYE）
+        uint64_t evictions = 0;    // 慢消费者驱逐
+        uint64_t seqErrors = 0;    // 同一连接内房间序号不连续的聊天广播
+        uint64_t virtualUs = 0;    // 结束时的虚拟时间
+        uint64_t digest = 0;       // 全部客户端收到的字节序列摘要
+        double wallMs = 0;         // 实际耗时
+    };
+
+    explicit Simulation(const Config& cfg) : cfg_(cfg), rng_(cfg.seed) {}
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    Report run();
+
+   private:
+    // SplitMix64：跨平台结果一致（标准库分布的实现各不相同）
+    struct Rng {
+        explicit Rng(uint64_t seed) : s(seed) {}
+        uint64_t next() {
+            uint64_t z = (s += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+        uint64_t below(uint64_t n) { return n ? next() % n : 0; }
+        uint64_t s;
+    };
+
+    // 内存套接字的一个方向：写端追加，读端只能看到已“到达”的字节
+    struct Pipe {
+        std::string buf;
+        size_t off = 0;        // 已读位置
+        size_t delivered = 0;  // 已到达位置
+        bool pending = false;  // 是否已安排读事件
+        void clear() {
+            buf.clear();
+            off = delivered = 0;
+            pending = false;
+        }
+        // 丢弃已读部分，避免持续写入时缓冲区无限增长
+        void compact() {
+            if (off == buf.size()) {
+                buf.clear();
+                off = delivered = 0;
+            } else if (off >= 64 * 1024) {
+                buf.erase(0, off);
+                delivered -= off;
+                off = 0;
+            }
+        }
+    };
+
+    struct Client {
+        ClientSession* session = nullptr;  // nullptr 表示离线
+        uint32_t epoch = 0;  // 每次断开递增，使旧事件失效
+        bool slow = false;
+        bool evicted = false;  // 本事件中已被驱逐，等待 reap
+        Pipe up;               // 客户端 -> 服务端
+        Pipe down;             // 服务端 -> 客户端
+        uint32_t streamId = 0;    // 进行中的流（0 表示无）
+        uint64_t streamLeft = 0;  // 流剩余字节
+        uint32_t nextStreamId = 1;
+        uint64_t digest = 1469598103934665603ull;  // FNV-1a
+        uint64_t lastSeq = 0;  // 本连接收到的最新房间序号（0 表示尚未收到）
+    };
+
+    enum class Ev : uint8_t {
+        CONNECT,       // 建立会话（握手已完成）
+        SEND,          // 客户端写出一帧
+        SERVER_READ,   // 会话处理线程读取
+        SERVER_WRITE,  // 会话写线程出队
+        CLIENT_READ    // 客户端读取
+    };
+
+    struct Event {
+        uint64_t at;
+        uint64_t seq;  // 同一时刻按安排顺序执行
+        uint32_t client;
+        uint32_t epoch;
+        Ev kind;
+        bool operator>(const Event& o) const {
+            return at != o.at ? at > o.at : seq > o.seq;
+        }
+    };
+
+    void schedule(uint64_t delayUs, uint32_t idx, Ev kind);
+    void connect(uint32_t idx);
+    void send(uint32_t idx);
+    void serverRead(uint32_t idx);
+    void serverWrite(uint32_t idx);
+    void clientRead(uint32_t idx);
+    void disconnect(uint32_t idx);  // 会话已释放：清理并安排重连
+    bool parseFrame(Pipe& p, chatproto::MsgType& type, size_t& len);
+    void reap();  // 释放本事件中被驱逐的会话
+    void transmit(uint32_t idx, Pipe& p, Ev readEv);  // 安排对端读事件
+    size_t chunk();  // 一次读到的随机字节数
+    std::string chatText();
+
+   private:
+    Config cfg_;
+    Rng rng_;
+    ChatServer server_;
+    std::vector<Client> clients_;
+    std::unordered_map<ClientSession*, uint32_t> index_;  // 会话 -> 客户端
+    std::vector<ClientSession*> evicted_;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events_;
+    uint64_t now_ = 0;
+    uint64_t seq_ = 0;
+    uint64_t sent_ = 0;  // 已发送的 CHAT 数
+    Report report_;
+};
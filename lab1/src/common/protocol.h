@@ -4,37 +4,145 @@
 // 帧格式: [1字节类型][4字节负载长度大端][负载字节]
 // 所有负载中的字符串均为 UTF-8。
 
+#ifdef _WIN32
 #ifndef NOMINMAX
 #define NOMINMAX
 #endif
 #include <windows.h>
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 
+#include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <optional>
 #include <string>
 #include <vector>
 
+#ifndef _WIN32
+// POSIX：补齐协议与客户端用到的 Winsock 名称，两端代码保持一致
+using SOCKET = int;
+static constexpr SOCKET INVALID_SOCKET = -1;
+static constexpr int SOCKET_ERROR = -1;
+static constexpr int SD_SEND = SHUT_WR;
+static constexpr int SD_BOTH = SHUT_RDWR;
+inline int closesocket(SOCKET s) { return ::close(s); }
+#endif
+
 namespace chatproto {
 
+// 对端已关闭时 send 返回错误而不是触发 SIGPIPE
+#if defined(MSG_NOSIGNAL)
+static constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static constexpr int SEND_FLAGS = 0;
+#endif
+
 // 默认服务器端口
 static constexpr uint16_t DEFAULT_PORT = 5000;
 // 最大负载长度（64 KiB）
 static constexpr uint32_t MAX_PAYLOAD = 64 * 1024;
+// 流分片的数据长度（分片越小，与聊天帧交错得越细）
+static constexpr uint32_t STREAM_CHUNK_SIZE = 16 * 1024;
+// 追踪帧的时间戳头：客户端发送、服务端接收、服务端入队、服务端写出各 8 字节
+static constexpr uint32_t TRACE_HEADER_SIZE = 32;
+// 聊天广播的房间序号（8 字节），位于负载开头
+static constexpr uint32_t SEQ_HEADER_SIZE = 8;
+// RECEIPTS 的标志位：开启回执、同时报告送达
+static constexpr uint8_t RECEIPTS_ON = 0x01;
+static constexpr uint8_t RECEIPTS_DELIVERIES = 0x02;
 
 // 消息类型枚举
 enum class MsgType : uint8_t {
     HELLO = 0x01,  // C->S: payload = UTF-8 昵称
     CHAT = 0x02,   // C->S: payload = UTF-8 文本
     BYE = 0x03,  // C->S: payload = UTF-8 昵称 (可选); 客户端打算断开连接
+    SEARCH = 0x04,  // C->S: payload = UTF-8 查询文本
+    // 大数据流（流编号由发送方分配，仅在本连接内有效）
+    STREAM_BEGIN = 0x05,  // C->S: [4 流编号][8 总长度][UTF-8 名称]
+    STREAM_CHUNK = 0x06,  // C->S: [4 流编号][数据]
+    STREAM_END = 0x07,    // C->S: [4 流编号][1 状态: 0 完成, 1 中止]
+    // 带时延追踪的聊天（可选扩展，时间戳为 traceNowUs）
+    CHAT_TRACED = 0x08,  // C->S: [8 客户端发送时间][UTF-8 文本]
+    // 消息回执：编号为本连接内 CHAT/CHAT_TRACED 的序号（从 1 开始）
+    RECEIPTS = 0x09,  // C->S: [1 标志: bit0 开启回执, bit1 同时报告送达]
+    // 组播模式：已加入组播组，此后聊天广播改经组播接收（负载为空）
+    MULTICAST_ON = 0x0A,
+    NACK = 0x0B,  // C->S: [8 起始房间序号][4 条数]，请求经 TCP 补发
 
     USER_JOIN = 0x11,        // S->C: payload = UTF-8 昵称
     USER_LEAVE = 0x12,       // S->C: payload = UTF-8 昵称
-    SERVER_BROADCAST = 0x13  // S->C: payload = UTF-8: from + '\n' + text
+    SERVER_BROADCAST = 0x13,  // S->C: [8 房间序号][from + '\n' + text]
+    SEARCH_RESULT = 0x14,  // S->C: payload = 若干条 from + '\n' + text，以 '\0' 分隔
+    // 服务端转发的流（流编号由服务端重新分配，全局唯一）
+    SERVER_STREAM_BEGIN = 0x15,  // S->C: [4 流编号][8 总长度][from + '\n' + 名称]
+    SERVER_STREAM_CHUNK = 0x16,  // S->C: [4 流编号][数据]
+    SERVER_STREAM_END = 0x17,    // S->C: [4 流编号][1 状态]
+    // 离线邮箱：HELLO 后一次性投递离线期间的广播，可分为多帧
+    MAILBOX = 0x18,  // S->C: [1 是否最后一批][若干完整的 SERVER_BROADCAST(_TRACED) 帧]
+    // 对 CHAT_TRACED 的广播：服务端写线程在发送前填入写出时间
+    SERVER_BROADCAST_TRACED = 0x19,  // S->C: [8 房间序号][32 时间戳头][from + '\n' + text]
+    // 累积回执：编号不超过 N 的消息均已受理/送达，每隔几毫秒至多一帧
+    RECEIPT = 0x1A,  // S->C: [8 已受理][8 已送达][4 已送达消息的接收者数]
+    // 组播模式（服务端启用时）：HELLO 后告知组地址；数据报为
+    // [4 实例号][8 房间序号][完整的广播帧（过大时省略）]
+    MULTICAST_GROUP = 0x1B,  // S->C: [4 实例号][2 端口][组地址（IPv4 文本）]
+    MULTICAST_START = 0x1C,  // S->C: [8 房间序号]，从该序号起不再经 TCP 发送
+    REPAIR_LOST = 0x1D,  // S->C: [8 起始房间序号][4 条数]，已无法补发
+    // 握手被拒绝（如服务端内存超限），服务端随后关闭连接
+    REFUSED = 0x1E  // S->C: UTF-8 原因
 };
 
+/**
+ * 以大端序追加整数
+ * @param out 输出缓冲
+ * @param v 整数值
+ */
+inline void putU32(std::string& out, uint32_t v) {
+    for (int shift = 24; shift >= 0; shift -= 8)
+        out.push_back(static_cast<char>((v >> shift) & 0xFF));
+}
+inline void putU64(std::string& out, uint64_t v) {
+    for (int shift = 56; shift >= 0; shift -= 8)
+        out.push_back(static_cast<char>((v >> shift) & 0xFF));
+}
+
+/**
+ * 读取大端序整数（调用方保证长度足够）
+ * @param p 数据指针
+ */
+inline uint32_t getU32(const char* p) {
+    uint32_t v = 0;
+    for (int i = 0; i < 4; ++i) v = (v << 8) | static_cast<uint8_t>(p[i]);
+    return v;
+}
+inline uint64_t getU64(const char* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) v = (v << 8) | static_cast<uint8_t>(p[i]);
+    return v;
+}
+// 原地写入大端序 64 位整数（调用方保证长度足够）
+inline void setU64(char* p, uint64_t v) {
+    for (int i = 7; i >= 0; --i, v >>= 8) p[i] = static_cast<char>(v & 0xFF);
+}
+
+/**
+ * 追踪时间戳：系统时钟微秒数
+ * @note 同机的客户端与服务端共用同一时钟；跨机时上行/下行两段含时钟偏差
+ */
+inline uint64_t traceNowUs() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count());
+}
+
 /**
  * 发送所有数据的辅助函数
  * @param s 套接字
@@ -44,7 +152,7 @@ enum class MsgType : uint8_t {
 inline bool sendAll(SOCKET s, const char* data, int len) {
     int sent = 0;  // 已发送字节数
     while (sent < len) {
-        int n = send(s, data + sent, len - sent, 0);
+        int n = send(s, data + sent, len - sent, SEND_FLAGS);
         if (n == SOCKET_ERROR || n == 0) return false;
         sent += n;
     }
@@ -90,6 +198,20 @@ inline bool sendFrame(SOCKET s, MsgType type, const std::string& payload) {
     return true;
 }
 
+/**
+ * 将一帧编码为帧头 + 负载的连续字节，便于一次编码多次发送
+ * @param type 消息类型
+ * @param payload 负载数据（调用方保证不超过 MAX_PAYLOAD）
+ */
+inline std::string encodeFrame(MsgType type, const std::string& payload) {
+    std::string out;
+    out.reserve(5 + payload.size());
+    out.push_back(static_cast<char>(type));
+    putU32(out, static_cast<uint32_t>(payload.size()));
+    out += payload;
+    return out;
+}
+
 /**
  * 接收数据帧
  * @param s 套接字
@@ -112,6 +234,7 @@ inline bool recvFrame(SOCKET s, MsgType& typeOut, std::string& payloadOut) {
     return recvAll(s, payloadOut.data(), static_cast<int>(len));
 }
 
+#ifdef _WIN32
 /**
  * 将 UTF-16 字符串转换为 UTF-8 字符串
  * @param w UTF-16 字符串
@@ -144,5 +267,6 @@ inline std::wstring utf8_to_utf16(const std::string& s) {
     MultiByteToWideChar(CP_UTF8, 0, s.c_str(), (int)s.size(), out.data(), size);
     return out;
 }
+#endif  // _WIN32
 
 }  // namespace chatproto
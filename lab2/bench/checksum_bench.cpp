@@ -0,0 +1,129 @@
+// checksum_bench.cpp
+// 校验和/CRC32C 微基准：先核对各实现结果一致，再测量每个数据包的校验开销
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "checksum.h"
+#include "rtp.h"
+
+using namespace rtp;
+using namespace std;
+
+namespace {
+	// 改动前的逐字实现（每加一个 16 位字折叠一次进位），作为结果与耗时的基准
+	uint32_t reference_sum(uint32_t sum, const uint8_t* data, size_t len) {
+		size_t i = 0;
+		while (i + 1 < len) {
+			sum += static_cast<uint16_t>((data[i] << 8) | data[i + 1]);
+			sum = (sum & 0xFFFF) + (sum >> 16);
+			i += 2;
+		}
+		if (i < len) {
+			sum += static_cast<uint16_t>(data[i] << 8);
+			sum = (sum & 0xFFFF) + (sum >> 16);
+		}
+		return sum;
+	}
+
+	// 各种长度与起始偏移（未对齐）下核对结果逐位一致
+	bool verify(const vector<uint8_t>& data) {
+		const uint8_t* check = reinterpret_cast<const uint8_t*>("123456789");
+		if (crc32c(0, check, 9) != 0xE3069283u || crc32c_scalar(0, check, 9) != 0xE3069283u) {
+			cerr << "crc32c check value mismatch" << endl;
+			return false;
+		}
+		vector<uint8_t> ones(4096, 0xFF);  // 全 0xFF：检验 0 与 0xFFFF 两种表示的折叠结果
+		const vector<uint8_t>* buffers[] = {&data, &ones};
+		for (size_t offset = 0; offset < 4; ++offset) {
+			for (size_t len = 0; len + offset <= 4096; len += (len < 256 ? 1 : 7)) {
+				for (const vector<uint8_t>* buf : buffers) {
+					const uint8_t* p = buf->data() + offset;
+					uint32_t expected = reference_sum(0, p, len);
+					if (ones_complement_sum(0, p, len) != expected ||
+						ones_complement_sum_scalar(0, p, len) != expected) {
+						cerr << "ones' complement sum mismatch: len=" << len << " offset=" << offset << endl;
+						return false;
+					}
+					if (crc32c(0, p, len) != crc32c_scalar(0, p, len)) {
+						cerr << "crc32c mismatch: len=" << len << " offset=" << offset << endl;
+						return false;
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	volatile uint64_t g_sink = 0;  // 保留计算结果，防止被编译器优化掉
+
+	template <typename F>
+	void measure(const string& name, size_t iterations, F&& body) {
+		auto start = chrono::steady_clock::now();
+		uint64_t sink = 0;
+		for (size_t i = 0; i < iterations; ++i) {
+			sink += body(i);
+		}
+		double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+		g_sink = g_sink + sink;
+		cout << "  " << left << setw(34) << name << right << fixed << setprecision(1) << setw(8) << ns / iterations
+			 << " ns/packet" << endl;
+	}
+}  // namespace
+
+int main(int argc, char** argv) {
+	size_t iterations = argc >= 2 ? static_cast<size_t>(stoull(argv[1])) : 2000000;
+
+	std::mt19937 rng(12345);
+	vector<uint8_t> data(4096);
+	for (auto& b : data) {
+		b = static_cast<uint8_t>(rng());
+	}
+	if (!verify(data)) {
+		return 1;
+	}
+	cout << "results identical; backends: checksum=" << ones_complement_backend() << ", crc32c=" << crc32c_backend()
+		 << endl;
+
+	// 满载数据段：20 字节包头 + MAX_PAYLOAD
+	const size_t packet_len = sizeof(PacketHeader) + MAX_PAYLOAD;
+	// 每次换一个起始偏移，避免只测到同一缓存行
+	auto at = [&](size_t i) { return data.data() + (i & 63); };
+	cout << "per packet (" << packet_len << " bytes), " << iterations << " iterations:" << endl;
+	measure("checksum, per-word fold (before)", iterations,
+			[&](size_t i) { return reference_sum(0, at(i), packet_len); });
+	measure("checksum, scalar", iterations,
+			[&](size_t i) { return ones_complement_sum_scalar(0, at(i), packet_len); });
+	measure(string("checksum, ") + ones_complement_backend(), iterations,
+			[&](size_t i) { return ones_complement_sum(0, at(i), packet_len); });
+	measure("crc32c, table", iterations, [&](size_t i) { return crc32c_scalar(0, at(i), packet_len); });
+	measure(string("crc32c, ") + crc32c_backend(), iterations, [&](size_t i) { return crc32c(0, at(i), packet_len); });
+
+	// 一个数据包的发送端 + 接收端校验：serialize_header（负载原处参与计算）与 parse_packet（校验整个报文）
+	for (uint16_t flags : {FLAG_DATA, static_cast<uint16_t>(FLAG_DATA | FLAG_CRC)}) {
+		PacketHeader hdr{};
+		hdr.flags = flags;
+		hdr.len = static_cast<uint16_t>(MAX_PAYLOAD);
+		vector<uint8_t> wire(MAX_PACKET);
+		size_t wire_len = serialize_packet(hdr, data.data(), MAX_PAYLOAD, wire.data());
+		uint8_t head[sizeof(PacketHeader) + CRC_TRAILER_SIZE];
+		size_t parsed = 0;
+		measure(string("serialize_header + parse, ") + ((flags & FLAG_CRC) ? "crc32c" : "checksum"), iterations,
+				[&](size_t i) {
+					hdr.seq = static_cast<uint32_t>(i);
+					size_t trailer_len = serialize_header(hdr, data.data(), MAX_PAYLOAD, head);
+					PacketView view{};
+					parsed += parse_packet(wire.data(), wire_len, view) ? 1 : 0;
+					return static_cast<uint64_t>(head[sizeof(PacketHeader) - 1] + trailer_len);
+				});
+		if (parsed != iterations) {
+			cerr << "parse_packet rejected a valid packet" << endl;
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,124 @@
+// batch_io.h
+// 批量收发数据报：Linux 下使用 sendmmsg/recvmmsg（可选 UDP GSO/GRO），其他平台逐个聚集发送/recvfrom
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#endif
+
+#include "packet_pool.h"
+#include "rtp.h"
+
+namespace rtp {
+	using std::size_t;
+	using std::vector;
+
+	constexpr size_t MAX_DATAGRAM = 2048;		// 单个接收缓冲大小（大于最大报文）
+	constexpr size_t MAX_GRO_BUFFER = 65536;	// 开启 GRO 后单个接收缓冲大小（可容纳合并后的整段）
+	constexpr size_t MAX_GSO_BYTES = 65000;		// 单次分段卸载的总字节数上限（UDP 报文不超过 64KB）
+	constexpr size_t MAX_GSO_SEGMENTS = 64;		// 单次分段卸载的段数上限（内核 UDP_MAX_SEGMENTS）
+
+	/**
+	 * 发送批次
+	 * 批次只保存序列化后的包头（及 CRC 尾部），负载引用调用方的缓冲，flush 时每个包以“包头 + 负载 + 尾部”
+	 * 三段 iovec 聚集发送，一次系统调用全部发往同一目的地址
+	 * 开启 GSO 后，连续的等长数据包合成一条消息交给内核按 UDP_SEGMENT 切分（最后一个可以更短）
+	 */
+	class SendBatch {
+	   public:
+		explicit SendBatch(size_t capacity = 64);
+
+		/**
+		 * 尝试开启 UDP 分段卸载（GSO）
+		 * @return 内核支持返回 true；不支持时保持逐个数据报发送
+		 */
+		bool enable_gso(socket_t sock);
+		bool gso_enabled() const { return gso_; }
+
+		/**
+		 * 把包头序列化到批次的下一个位置，负载只记录指针、不复制（调用方在 full() 时先 flush）
+		 * @param payload 负载缓冲，须在 flush 返回前保持有效且不被改写
+		 */
+		void push(const PacketHeader& hdr, const uint8_t* payload, size_t payload_len);
+		bool full() const { return count_ >= capacity_; }
+		bool empty() const { return count_ == 0; }
+
+		/**
+		 * 发送全部待发包并清空批次
+		 * @param sock 套接字
+		 * @param to 目的地址
+		 * @return 成功发送的包数（发送缓冲满等原因未发出的包按丢包处理，由重传恢复）
+		 * 内核拒绝分段卸载时关闭 GSO，剩余的包逐个数据报重发
+		 */
+		size_t flush(socket_t sock, const sockaddr_in& to);
+
+	   private:
+		size_t capacity_;
+		bool gso_{false};
+		PacketPool headers_;					// capacity 个包头缓冲，包头之后存放 CRC 尾部
+		vector<const uint8_t*> payloads_;		// 各包负载（调用方缓冲）
+		vector<size_t> payload_lens_;			// 各包负载长度
+		vector<size_t> trailer_lens_;			// 各包 CRC 尾部长度（未使用 CRC 时为 0）
+		size_t count_{0};						// 已放入的包数
+#ifdef __linux__
+		// 从第 first 个包起组装消息，返回消息数；starts_[i] 为第 i 条消息的首个包
+		size_t build_messages(size_t first, const sockaddr_in& to);
+
+		vector<mmsghdr> msgs_;
+		vector<iovec> iovs_;  // 每个包三项：包头（构造时登记）、负载、尾部，一条消息引用其中连续的一段
+		vector<size_t> starts_;
+		vector<char> control_;	// 每条消息的 UDP_SEGMENT 控制信息
+#endif
+	};
+
+	/**
+	 * 接收批次
+	 * 一次读取套接字中已到达的多个数据报，缓冲区预先分配并重复使用
+	 * 开启 GRO 后，内核合并的缓冲按段长切回单个数据报，调用方看到的仍是逐个数据报
+	 */
+	class RecvBatch {
+	   public:
+		explicit RecvBatch(size_t capacity = 32);
+
+		/**
+		 * 尝试开启 UDP 接收合并（GRO），成功时把接收缓冲扩大到 MAX_GRO_BUFFER
+		 * @return 内核支持返回 true
+		 */
+		bool enable_gro(socket_t sock);
+		bool gro_enabled() const { return gro_; }
+
+		/**
+		 * 读取已到达的数据报（应在套接字可读后调用）
+		 * @return 读到的数据报个数（合并缓冲已拆开），其他平台为 0 或 1
+		 */
+		size_t receive(socket_t sock);
+
+		const uint8_t* data(size_t i) const { return views_[i].data; }
+		size_t size(size_t i) const { return views_[i].size; }
+		const sockaddr_in& from(size_t i) const { return addrs_[views_[i].slot]; }
+
+	   private:
+		struct View {
+			const uint8_t* data;
+			size_t size;
+			size_t slot;  // 所在接收缓冲（决定来源地址）
+		};
+
+		void allocate(size_t buffer_size);
+
+		size_t capacity_;
+		bool gro_{false};
+		PacketPool pool_;  // capacity 个接收缓冲，地址在分配时登记到 iovs_
+		vector<sockaddr_in> addrs_;
+		vector<View> views_;
+#ifdef __linux__
+		vector<mmsghdr> msgs_;
+		vector<iovec> iovs_;
+		vector<char> control_;	// 每个缓冲的 UDP_GRO 控制信息
+#endif
+	};
+
+}  // namespace rtp
@@ -0,0 +1,38 @@
+// checksum.h
+// 报文完整性校验：16 位反码和（SSE2/AVX2/NEON 向量化，结果与逐字计算逐位一致）与 CRC32C（硬件指令）
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rtp {
+	using std::size_t;
+
+	/**
+	 * 累加 16 位大端字的反码和（len 为奇数时末字节补 0）
+	 * @param sum 之前各段的部分和（首段传 0），前面各段长度须为偶数
+	 * @return 折叠进位后的部分和（0..0xFFFF），取反即为校验和
+	 * 运行时选择可用的向量实现，主体按本机字节序累加、最后交换字节，与逐字折叠的结果逐位一致
+	 */
+	uint32_t ones_complement_sum(uint32_t sum, const uint8_t* data, size_t len);
+
+	// 标量实现（不使用向量指令），结果与 ones_complement_sum 相同
+	uint32_t ones_complement_sum_scalar(uint32_t sum, const uint8_t* data, size_t len);
+
+	// 当前使用的反码和实现名称（"avx2"、"sse2"、"neon" 或 "scalar"）
+	const char* ones_complement_backend();
+
+	/**
+	 * 计算 CRC32C（Castagnoli 多项式，与 iSCSI/ext4 相同）
+	 * @param crc 之前各段的结果（首段传 0），可分段连续计算
+	 * 运行时选择 SSE4.2 或 ARMv8 CRC 指令，不支持时查表
+	 */
+	uint32_t crc32c(uint32_t crc, const uint8_t* data, size_t len);
+
+	// 查表实现，结果与 crc32c 相同
+	uint32_t crc32c_scalar(uint32_t crc, const uint8_t* data, size_t len);
+
+	// 当前使用的 CRC32C 实现名称（"sse4.2"、"armv8" 或 "table"）
+	const char* crc32c_backend();
+
+}  // namespace rtp
@@ -0,0 +1,51 @@
+// event_loop.h
+// 套接字事件等待：Linux 下使用 epoll + timerfd，其他平台退回 select
+#pragma once
+
+#include <cstdint>
+
+#include "rtp.h"
+
+namespace rtp {
+
+	/**
+	 * 单套接字事件循环
+	 * 调用方给出下一个截止时间（now_ms 时间轴上的绝对毫秒数），wait_until 在套接字可读或到达截止时间时返回，
+	 * 不再按固定间隔轮询：既不会空转，也不会越过重传/探测计时器的到期时间
+	 * - Linux：timerfd 以 CLOCK_MONOTONIC 绝对时间布防（与 steady_clock 同一时钟），
+	 *   截止时间不变时不重复布防；epoll 同时等待套接字与 timerfd
+	 * - 其他平台：select，超时由截止时间换算
+	 */
+	class EventLoop {
+	   public:
+		EventLoop() = default;
+		~EventLoop();
+		EventLoop(const EventLoop&) = delete;
+		EventLoop& operator=(const EventLoop&) = delete;
+
+		// 注册要等待的套接字，返回是否成功
+		bool open(socket_t sock);
+		void close();
+
+		/**
+		 * 等待套接字可读或到达截止时间
+		 * @param deadline_ms 截止时间（now_ms 时间轴），0 表示无限等待
+		 * @return 套接字可读返回 true，到达截止时间或出错返回 false
+		 */
+		bool wait_until(uint64_t deadline_ms);
+
+		// 相对超时版本：timeout_ms < 0 表示无限等待
+		bool wait_for(int timeout_ms);
+
+	   private:
+		socket_t sock_{INVALID_SOCKET_VALUE};
+#ifdef __linux__
+		bool arm_timer(uint64_t deadline_ms);
+
+		int epoll_fd_{-1};		  // epoll 实例
+		int timer_fd_{-1};		  // 截止时间计时器
+		uint64_t armed_at_{0};	  // 当前布防的截止时间（0 表示未布防）
+#endif
+	};
+
+}  // namespace rtp
@@ -0,0 +1,47 @@
+// mapped_file.h
+// 只读映射整个输入文件：POSIX 下 mmap + madvise，Windows 下 CreateFileMapping + MapViewOfFile
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace rtp {
+	using std::string;
+
+	/**
+	 * 只读文件映射
+	 * 段负载直接指向映射中的位置，发送与重传都不再读文件、不复制，内存占用由页缓存承担，不随窗口大小增长
+	 * 映射期间文件被其他进程截短时，访问越界的页会触发 SIGBUS（与直接读取文件不同，无法逐次检查）
+	 */
+	class MappedFile {
+	   public:
+		MappedFile() = default;
+		~MappedFile();
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		/**
+		 * 映射整个文件，并提示内核按顺序访问、提前读入
+		 * @return 成功返回 true；空文件也算成功（data() 为空）
+		 */
+		bool open(const string& path);
+		void close();
+
+		/**
+		 * 释放 offset 之前已不再访问的页（已确认的数据），进程常驻内存不随已发送的数据量增长
+		 * 页缓存中的数据不受影响；积累到 DISCARD_STEP 才调用一次，其他平台无操作
+		 */
+		void discard_before(uint64_t offset);
+
+		const uint8_t* data() const { return data_; }
+		uint64_t size() const { return size_; }
+
+	   private:
+		static constexpr uint64_t DISCARD_STEP = 1 << 20;  // 每次至少释放 1MB
+
+		const uint8_t* data_{nullptr};
+		uint64_t size_{0};
+		uint64_t discarded_{0};	 // 已释放到的偏移（页对齐）
+	};
+
+}  // namespace rtp
@@ -0,0 +1,113 @@
+// output_file.h
+// 接收端输出文件：数据段按偏移写入，后台写盘线程把成批的数据合并为大块 pwritev
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rtp {
+	using std::size_t;
+	using std::string;
+	using std::vector;
+
+	/**
+	 * 按偏移写入的输出文件
+	 * 每个数据段到达时就确定了它在文件中的位置（(seq - 首段序号) * MAX_PAYLOAD）。
+	 * write_at 把负载复制进当前批次（接收缓冲随即可被重用），批次写满后交给后台写盘线程；
+	 * 批次组成环，写盘线程按偏移排序后把首尾相接的段合并为一次 pwritev，网络循环从不等待磁盘
+	 * - Linux：fallocate 预先分配空间，pwritev 写出
+	 * - 其他 POSIX 平台：ftruncate 预先扩展，pwrite 逐块写出
+	 * - Windows：SetEndOfFile 预先扩展，WriteFile（OVERLAPPED 指定偏移）逐块写出
+	 */
+	class OutputFile {
+	   public:
+		OutputFile() = default;
+		~OutputFile();
+		OutputFile(const OutputFile&) = delete;
+		OutputFile& operator=(const OutputFile&) = delete;
+
+		// 创建（或截断）输出文件并启动写盘线程
+		bool open(const string& path);
+
+		/**
+		 * 预先分配 size 字节（发送端在握手时通告文件大小），应在第一次 write_at 之前调用
+		 * @return 文件系统不支持预分配时退回扩展文件长度；都失败返回 false（不影响之后的写入）
+		 */
+		bool preallocate(uint64_t size);
+
+		/**
+		 * 把一段数据复制进当前批次，稍后由写盘线程写到 offset 处
+		 * @return 全部批次都在等待写盘（超出 free_slots 通告的空间）时返回 false，数据未被接收，调用方应当作丢包
+		 */
+		bool write_at(uint64_t offset, const uint8_t* data, size_t len);
+
+		/**
+		 * 不等待写盘还能接收多少段 len 字节的数据（当前批次剩余空间 + 空闲批次）
+		 * 接收端据此缩小通告窗口，磁盘跟不上时让发送端放慢，而不是丢包
+		 */
+		size_t free_slots(size_t len) const;
+
+		/**
+		 * 等待全部数据写完，把文件截断到 length（已按序收齐的长度）并关闭
+		 * 传输中断时文件只保留连续到达的前缀，预分配的其余部分被截掉
+		 * @return 是否所有写入都成功
+		 */
+		bool finish(uint64_t length);
+
+		bool is_open() const;
+
+	   private:
+		static constexpr size_t BATCH_BYTES = 1 << 20;	// 每个批次的数据容量
+		static constexpr size_t RING_SIZE = 4;			// 批次个数：一个在填充时其余可在排队或写盘
+
+		// 一段数据：文件中的 offset 处，存放在批次 data 的 pos 处
+		struct Piece {
+			uint64_t offset;
+			size_t pos;
+			size_t len;
+		};
+		struct Batch {
+			std::unique_ptr<uint8_t[]> data;  // BATCH_BYTES 字节，首次写入时才占用物理页
+			size_t used{0};
+			vector<Piece> pieces;
+		};
+		// 合并后的一块连续内存
+		struct Block {
+			const uint8_t* data;
+			size_t len;
+		};
+
+		void submit();				  // 把正在填充的批次交给写盘线程
+		bool acquire();				  // 取下一个空闲批次开始填充，没有则返回 false
+		void run();					  // 写盘线程主循环
+		bool write_batch(Batch& batch);	 // 排序、合并并写出一个批次（写盘线程）
+		bool write_run(uint64_t offset, const Block* blocks, size_t count);	 // 把若干块连续写到 offset 处
+		void stop();
+		void close();
+
+		vector<Batch> ring_;
+		size_t fill_{0};		 // 正在填充的批次（仅网络循环使用）
+		bool filling_{false};	 // ring_[fill_] 是否归网络循环所有（仅网络循环使用）
+
+		vector<Block> blocks_;	// 写盘线程合并出的内存块（仅写盘线程使用）
+
+		std::thread thread_;
+		mutable std::mutex mutex_;
+		std::condition_variable cv_;
+		size_t write_{0};	   // 写盘线程下一个要写的批次，受 mutex_ 保护
+		size_t queued_{0};	   // 已提交、尚未写完的批次数，受 mutex_ 保护
+		bool stop_{false};	   // 受 mutex_ 保护
+		bool failed_{false};   // 有写入失败，受 mutex_ 保护
+#ifdef _WIN32
+		void* handle_{nullptr};	 // HANDLE
+#else
+		int fd_{-1};
+#endif
+	};
+
+}  // namespace rtp
@@ -0,0 +1,43 @@
+// packet_pool.h
+// 预先分配的对齐数据包缓冲池
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rtp {
+	using std::size_t;
+
+	/**
+	 * 固定数量、固定大小的数据包缓冲
+	 * 启动时一次分配一整块内存，每个缓冲按缓存行对齐，之后只按下标取用，收发路径上不再分配内存
+	 * 缓冲的归属由使用者约定（批次按顺序使用，窗口按序号取模），池本身不做借还
+	 */
+	class PacketPool {
+	   public:
+		static constexpr size_t ALIGNMENT = 64;	 // 缓冲起始地址对齐（缓存行）
+
+		PacketPool() = default;
+		PacketPool(size_t count, size_t buffer_size);
+		~PacketPool();
+		PacketPool(const PacketPool&) = delete;
+		PacketPool& operator=(const PacketPool&) = delete;
+
+		// 重新分配（只应在初始化阶段调用，原有缓冲全部失效）
+		void reset(size_t count, size_t buffer_size);
+
+		uint8_t* buffer(size_t i) { return base_ + i * stride_; }
+		const uint8_t* buffer(size_t i) const { return base_ + i * stride_; }
+		size_t count() const { return count_; }
+		size_t buffer_size() const { return buffer_size_; }
+
+	   private:
+		void release();
+
+		uint8_t* base_{nullptr};
+		size_t count_{0};
+		size_t buffer_size_{0};
+		size_t stride_{0};	// 相邻缓冲的间距（buffer_size 向上取整到 ALIGNMENT）
+	};
+
+}  // namespace rtp
@@ -0,0 +1,59 @@
+// read_ahead.h
+// 输入文件预读：后台线程提前读入映射中即将发送的页，网络循环只发送已读入的数据
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace rtp {
+
+	/**
+	 * 映射文件的后台预读
+	 * 后台线程按顺序访问 [消费位置, 消费位置 + 预读窗口) 内的每一页，缺页（读盘）发生在该线程，
+	 * 读完一块就发布“已就绪”偏移；网络循环只发送就绪范围内的数据段，磁盘延迟不会阻塞 ACK 处理
+	 */
+	class ReadAhead {
+	   public:
+		ReadAhead() = default;
+		~ReadAhead();
+		ReadAhead(const ReadAhead&) = delete;
+		ReadAhead& operator=(const ReadAhead&) = delete;
+
+		/**
+		 * 启动后台线程
+		 * @param data 映射起始地址（在 stop 之前保持有效）
+		 * @param size 映射长度
+		 * @param window 预读窗口：最多领先消费位置的字节数
+		 */
+		void start(const uint8_t* data, uint64_t size, uint64_t window);
+		void stop();
+
+		// 网络循环即将发送到 offset：推进预读目标（前进不足一块时不唤醒后台线程）
+		void consume(uint64_t offset);
+
+		// [0, ready()) 已读入内存，访问不会等待磁盘
+		uint64_t ready() const { return ready_.load(std::memory_order_acquire); }
+
+	   private:
+		static constexpr uint64_t CHUNK = 256 * 1024;  // 每读入一块发布一次进度
+		static constexpr uint64_t PAGE = 4096;		   // 按页访问（页更大时只是多访问几次同一页）
+
+		void run();
+
+		const uint8_t* data_{nullptr};
+		uint64_t size_{0};
+		uint64_t window_{0};
+		uint64_t notified_{0};	// 最近一次通知后台线程的消费位置（仅网络循环使用）
+
+		std::thread thread_;
+		std::mutex mutex_;
+		std::condition_variable cv_;
+		uint64_t consumed_{0};	// 受 mutex_ 保护
+		bool stop_{false};		// 受 mutex_ 保护
+		std::atomic<uint64_t> ready_{0};
+	};
+
+}  // namespace rtp
@@ -2,34 +2,38 @@
 #pragma once
 
 #include <cstdint>
-#include <map>
 #include <vector>
 
+#include "rtp.h"
+
 namespace rtp {
-	using std::map;
 	using std::vector;
 
 	/**
 	 * 接收缓冲区管理
-	 * 负责乱序段缓存、连续段提取、SACK掩码生成
+	 * 负责记录窗口内各段的到达情况（空洞位图）、推进连续段、SACK掩码生成
+	 * 段负载由调用方按偏移直接写入输出文件，这里只按序号对窗口大小取模记录段长，不缓存数据
 	 */
 	class ReceiveBuffer {
 	   public:
 		explicit ReceiveBuffer(uint16_t window_size);
 
 		/**
-		 * 添加接收到的段到缓冲区
-		 * @param seq 段序号
-		 * @param data 段数据
-		 * @return 是否成功添加（false表示重复包或超出窗口）
+		 * 记录一个到达的段
+		 * @param seq 段序号（调用方保证在接收窗口内）
+		 * @param len 段长度（不超过 MAX_PAYLOAD）
+		 * @return 是否为新到达的段（false表示重复包或长度非法）
 		 */
-		bool add_segment(uint32_t seq, const vector<uint8_t>& data);
+		bool add_segment(uint32_t seq, size_t len);
+
+		// 序号为 seq 的段是否已到达
+		bool has_segment(uint32_t seq) const;
 
 		/**
-		 * 提取所有连续的段（从expected_seq开始），并推进expected_seq
-		 * @return 可以写入文件的连续数据列表
+		 * 从 expected_seq 起越过已到达的连续段，推进 expected_seq
+		 * @return 本次推进的字节数
 		 */
-		vector<vector<uint8_t>> extract_continuous_segments();
+		size_t advance();
 
 		// 构建SACK掩码（32位，标记expected_seq+1起的32个段）
 		// 位i=1表示序号expected_seq+1+i的段已到达
@@ -48,9 +52,16 @@ namespace rtp {
 		uint16_t get_window_size() const { return window_size_; }
 
 	   private:
-		uint32_t expected_seq_;					 // 下一个期望接受数据段的序号
-		uint16_t window_size_;					 // 接收窗口大小
-		map<uint32_t, vector<uint8_t>> buffer_;	 // 乱序段缓冲区
+		// 缓冲位置：记录当前占用它的段
+		struct Slot {
+			uint32_t seq{0};
+			uint16_t len{0};
+			bool present{false};
+		};
+
+		uint32_t expected_seq_;	 // 下一个期望接受数据段的序号
+		uint16_t window_size_;	 // 接收窗口大小
+		vector<Slot> slots_;	 // 窗口内各段的到达状态（按序号取模）
 	};
 
 }  // namespace rtp
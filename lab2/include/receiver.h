@@ -2,16 +2,17 @@
 #pragma once
 
 #include <cstdint>
-#include <fstream>
 #include <string>
 #include <vector>
 
+#include "batch_io.h"
+#include "event_loop.h"
+#include "output_file.h"
 #include "receive_buffer.h"
 #include "rtp.h"
 #include "transfer_stats.h"
 
 namespace rtp {
-	using std::ofstream;
 	using std::size_t;
 	using std::string;
 	using std::vector;
@@ -22,6 +23,9 @@ namespace rtp {
 		ReliableReceiver(uint16_t listen_port, string output_path, uint16_t window_size = 32);
 		~ReliableReceiver();
 
+		// 数据阶段开启 UDP GRO/GSO（内核不支持时自动退回普通收发）
+		void set_offload(bool enabled) { offload_ = enabled; }
+
 		int run();
 
 	   private:
@@ -36,13 +40,17 @@ namespace rtp {
 		 */
 		bool wait_for_packet(Packet& pkt, sockaddr_in& from, int timeout_ms);
 
+		// 套接字可读后读取并解析一个数据包
+		bool receive_packet(Packet& pkt, sockaddr_in& from);
+
 		/**
 		 * 发送原始数据包
 		 * @param hdr 包头
 		 * @param payload 负载数据
+		 * @param payload_len 负载长度
 		 * @return 发送的字节数
 		 */
-		int send_raw(const PacketHeader& hdr, const vector<uint8_t>& payload);
+		int send_raw(const PacketHeader& hdr, const uint8_t* payload = nullptr, size_t payload_len = 0);
 
 		// === 连接管理 ===
 		/**
@@ -60,30 +68,48 @@ namespace rtp {
 		void handle_fin(uint32_t fin_seq);
 
 		// === ACK发送 ===
+		PacketHeader make_ack(bool fin, uint32_t fin_ack) const;  // 按当前接收状态构造ACK
 		void send_ack(bool fin = false, uint32_t fin_ack = 0);
+		uint16_t advertised_window() const;	 // 通告窗口：接收窗口与写盘批次剩余空间中的较小者
+		void queue_ack();	// 普通ACK放入发送批次，本批数据包处理完后一起发出
+		void flush_acks();	// 发出批次中的全部ACK
 		void send_rst();  // 发送RST段，强制终止连接
+		void note_window(uint16_t wnd);	 // 记录通告窗口；从零重新打开时开始重发窗口更新
 
 		// === 数据处理 ===
-		void process_data_packet(const Packet& pkt, ofstream& out);
+		void process_data_packet(const PacketView& pkt);
 
 		// === Socket相关 ===
 		socket_t sock_{INVALID_SOCKET_VALUE};  // 接收端Socket
+		EventLoop loop_;					   // 等待套接字可读或超时
+		RecvBatch recv_batch_;				   // 一次 recvmmsg 读取的数据包
+		SendBatch ack_batch_;				   // 待发ACK（一次 sendmmsg 发出）
 		uint16_t listen_port_{0};			   // 监听端口
 		string output_path_;				   // 输出文件路径
 		uint16_t window_size_{0};			   // 接收窗口大小
+		uint16_t last_wnd_{0};				   // 最近一次ACK通告的窗口
+		bool reopen_pending_{false};		   // 窗口从零重新打开，尚未收到数据
+		int reopen_retries_{0};				   // 已重发的窗口更新次数
+		uint64_t reopen_retry_at_{0};		   // 下次重发窗口更新的时间
 		sockaddr_in client_{};				   // 客户端地址
 		uint32_t isn_{0};					   // 本端初始序号
 		uint32_t peer_isn_{0};				   // 对端初始序号
+		bool offload_{false};				   // 是否尝试开启 GRO/GSO
+		uint64_t file_size_{0};				   // 发送端在 SYN 中通告的文件大小
+		bool size_known_{false};			   // 发送端是否通告了文件大小
+		uint16_t integrity_{0};				   // 报文校验方式：0 为反码校验和，FLAG_CRC 为 CRC32C
 
 		// === 模块化组件 ===
 		ReceiveBuffer buffer_;	// 接收缓冲区
+		OutputFile output_;		// 输出文件（数据段按偏移写入，后台线程写盘）
 		TransferStats stats_;	// 统计信息
 
 		// === 统计 ===
-		size_t bytes_written_{0};			  // 写入文件的字节数
+		size_t bytes_written_{0};			  // 按序收齐的字节数（输出文件的有效长度）
 		uint32_t total_packets_received_{0};  // 总接收包数
 		uint32_t duplicate_packets_{0};		  // 重复包数
 		uint32_t out_of_order_packets_{0};	  // 乱序包数
+		uint32_t storage_drops_{0};			  // 写盘跟不上时丢弃的包数
 
 		// === 超时检测 ===
 		int consecutive_timeouts_{0};  // 连续超时次数
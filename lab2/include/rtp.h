@@ -2,18 +2,33 @@
 // Reliable Transport Protocol协议核心定义头文件
 #pragma once
 
+#ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
 
 #include <chrono>
 #include <cstdint>
 #include <string>
 #include <vector>
 
+#ifdef _WIN32
 using socket_t = SOCKET;
 constexpr socket_t INVALID_SOCKET_VALUE = INVALID_SOCKET;
+#else
+// POSIX：套接字即文件描述符，补齐两端代码用到的 Winsock 名称
+using socket_t = int;
+constexpr socket_t INVALID_SOCKET_VALUE = -1;
+inline int closesocket(socket_t s) { return ::close(s); }
+#endif
 
-inline bool socket_valid(socket_t s) { return s != INVALID_SOCKET; }
+inline bool socket_valid(socket_t s) { return s != INVALID_SOCKET_VALUE; }
 
 namespace rtp {
 	using std::size_t;
@@ -26,6 +41,7 @@ namespace rtp {
 	constexpr uint16_t FLAG_FIN = 0x04;	  // FIN
 	constexpr uint16_t FLAG_DATA = 0x08;  // 数据段
 	constexpr uint16_t FLAG_RST = 0x10;	  // RST，复位段，用于异常终止连接
+	constexpr uint16_t FLAG_CRC = 0x20;	  // 使用 CRC32C 校验：校验和字段为 0，负载后附 4 字节 CRC
 
 	constexpr int HANDSHAKE_TIMEOUT_MS = 8000;	// 握手超时时间（毫秒）
 	constexpr int DATA_TIMEOUT_MS = 50000;		// 数据传输超时时间（毫秒）
@@ -42,25 +58,65 @@ namespace rtp {
 	};
 #pragma pack(pop)
 
-	// 数据包结构体
+	constexpr size_t CRC_TRAILER_SIZE = 4;												  // CRC32C 尾部长度
+	constexpr size_t MAX_PACKET = sizeof(PacketHeader) + MAX_PAYLOAD + CRC_TRAILER_SIZE;  // 最大报文长度
+
+	// 数据包结构体（负载为独立副本，用于握手、挥手等控制流程）
 	struct Packet {
 		PacketHeader header{};
 		vector<uint8_t> payload;
 	};
 
+	// 数据包视图：负载直接指向接收缓冲，长度为 header.len，缓冲被重用前有效
+	struct PacketView {
+		PacketHeader header{};
+		const uint8_t* payload{nullptr};
+	};
+
 	// 计算校验和
 	uint16_t compute_checksum(const uint8_t* data, size_t len);
 
-	// 修改为大端序，组装数据包
-	vector<uint8_t> serialize_packet(const PacketHeader& header, const vector<uint8_t>& payload);
+	// 计算两段拼接后的校验和（head_len 须为偶数，两段分别原地计算，不拼接）
+	uint16_t compute_checksum(const uint8_t* head, size_t head_len, const uint8_t* data, size_t len);
+
+	/**
+	 * 修改为大端序，只组装包头；校验和覆盖包头与负载，负载原地参与计算、不复制
+	 * @param out 至少 sizeof(PacketHeader) + CRC_TRAILER_SIZE 字节
+	 * @return 尾部长度：header.flags 含 FLAG_CRC 时 CRC32C 写在 out + sizeof(PacketHeader)，
+	 *         由调用方放在负载之后发送，返回 CRC_TRAILER_SIZE；否则返回 0
+	 */
+	size_t serialize_header(const PacketHeader& header, const uint8_t* payload, size_t payload_len, uint8_t* out);
+
+	/**
+	 * 修改为大端序，把数据包组装到调用方提供的缓冲（至少 sizeof(PacketHeader) + payload_len + CRC_TRAILER_SIZE 字节）
+	 * @return 报文总长度
+	 */
+	size_t serialize_packet(const PacketHeader& header, const uint8_t* payload, size_t payload_len, uint8_t* out);
 
-	// 解析数据包并检验校验和
+	// 解析数据包并检验校验和（带 FLAG_CRC 的报文检验 CRC32C），负载不复制
+	bool parse_packet(const uint8_t* data, size_t len, PacketView& out);
+
+	// 解析数据包并检验校验和，负载复制到 out.payload
 	bool parse_packet(const uint8_t* data, size_t len, Packet& out);
 
+	constexpr size_t SYN_PAYLOAD_LEN = 8;  // SYN 负载：发送文件的总字节数（64 位大端）
+
+	// 把文件大小编码为 SYN 负载
+	void encode_file_size(uint64_t size, uint8_t* out);
+
+	/**
+	 * 从 SYN 负载读出文件大小
+	 * @return 负载长度不符（对端未通告大小）时返回 false
+	 */
+	bool decode_file_size(const vector<uint8_t>& payload, uint64_t& size);
+
 	// 生成初始序号（ISN），基于本地和远程地址的哈希
 	uint32_t generate_isn(const sockaddr_in& local, const sockaddr_in& remote);
 
-	// 获取当前时间戳（毫秒）
+	// 初始化套接字库（Windows 下调用 WSAStartup，其他平台无操作）
+	bool init_sockets();
+
+	// 获取当前时间戳（毫秒，steady_clock）
 	uint64_t now_ms();
 	string addr_to_string(const sockaddr_in& addr);
 
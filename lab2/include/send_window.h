@@ -3,14 +3,12 @@
 #pragma once
 
 #include <cstdint>
-#include <unordered_map>
 #include <vector>
 
 #include "rtp.h"
 
 namespace rtp {
 	using std::size_t;
-	using std::unordered_map;
 	using std::vector;
 
 	/**
@@ -21,8 +19,9 @@ namespace rtp {
 	   public:
 		// 数据段信息
 		struct SegmentInfo {
-			vector<uint8_t> data;		   // 段数据
-			bool data_loaded{false};	   // 是否已加载数据（按需从文件读取）
+			const uint8_t* data{nullptr};  // 段数据（指向输入文件映射中的位置，不复制）
+			size_t size{0};				   // 段数据长度
+			bool data_loaded{false};	   // 是否已定位段数据（按需计算在映射中的位置）
 			bool sent{false};			   // 是否已发送
 			bool acked{false};			   // 是否已确认
 			uint64_t last_send{0};		   // 最后发送时间（用于超时检测）
@@ -39,8 +38,10 @@ namespace rtp {
 		// 标记段为已确认，seq: 段序号（从1开始）
 		void mark_acked(uint32_t seq);
 
-		// 获取段信息
+		// 获取段信息（不存在时新建）
 		SegmentInfo& get_segment(uint32_t seq);
+		// 查找段信息：该段不在环中（已确认滑出或尚未发送）时返回 nullptr，不占用位置
+		SegmentInfo* find_segment(uint32_t seq);
 
 		// 检查所有段是否都已确认，左窗口边界推进到 total_segments_ + 1
 		bool all_acked() const;
@@ -69,10 +70,22 @@ namespace rtp {
 		size_t calculate_window_size(uint16_t local_window, uint16_t peer_window, double cwnd, size_t sack_bits) const;
 
 	   private:
-		unordered_map<uint32_t, SegmentInfo> segments_;	 // 在途/关注段（按需创建，避免全量切割）
-		uint32_t total_segments_;						 // 总段数
-		uint32_t base_seq_;								 // 窗口左边界（最小未确认序号）
-		uint32_t next_seq_;								 // 下一个待发送序号
+		// 环中的一个位置：记录当前占用它的段序号
+		struct Slot {
+			uint32_t seq{0};
+			bool used{false};
+			SegmentInfo info;
+		};
+		// 在途段不超过 SACK 位宽（32），SACK 扫描只对不低于左边界的ACK进行、只到 ack+32，
+		// 且只查找不新建（find_segment），环取 64 个位置不会有两个关注段冲突
+		static constexpr size_t RING_SIZE = 64;
+
+		Slot* find(uint32_t seq);  // 序号对应的位置正被该段占用时返回它，否则返回 nullptr
+
+		vector<Slot> ring_;			// 在途/关注段（按序号取模）
+		uint32_t total_segments_;	// 总段数
+		uint32_t base_seq_;			// 窗口左边界（最小未确认序号）
+		uint32_t next_seq_;			// 下一个待发送序号
 	};
 
 }  // namespace rtp
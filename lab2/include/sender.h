@@ -1,11 +1,14 @@
 #pragma once
 
 #include <cstdint>
-#include <fstream>
 #include <string>
 #include <vector>
 
+#include "batch_io.h"
 #include "congestion_control.h"
+#include "event_loop.h"
+#include "mapped_file.h"
+#include "read_ahead.h"
 #include "rtp.h"
 #include "send_window.h"
 #include "transfer_stats.h"
@@ -27,11 +30,20 @@ namespace rtp {
 					   uint16_t local_port = 0);
 		~ReliableSender();
 
+		// 数据阶段开启 UDP GSO/GRO（内核不支持时自动退回普通收发）
+		void set_offload(bool enabled) { offload_ = enabled; }
+		// 握手时提议使用 CRC32C 校验，接收端同意后整个连接的报文都带 CRC 尾部
+		void set_crc32c(bool enabled) { integrity_ = enabled ? FLAG_CRC : 0; }
+
 		int run();
 
 	   private:
 		bool wait_for_packet(Packet& pkt, sockaddr_in& from, int timeout_ms);
-		int send_raw(const PacketHeader& hdr, const vector<uint8_t>& payload);
+		bool receive_packet(Packet& pkt, sockaddr_in& from);  // 套接字可读后读取并解析一个数据包
+		int send_raw(const PacketHeader& hdr, const uint8_t* payload = nullptr, size_t payload_len = 0);
+		// 放入发送批次，稍后一起发送（只序列化包头，负载在 flush 前须保持有效）
+		void queue_raw(const PacketHeader& hdr, const uint8_t* payload, size_t payload_len);
+		void flush_sends();	 // 发出批次中的全部数据包
 		void send_rst();  // 发送RST段，强制终止连接
 
 		bool handshake();		// 执行三次握手建立连接
@@ -42,12 +54,13 @@ namespace rtp {
 
 		void transmit_segment(uint32_t seq);
 		size_t payload_len_for_seq(uint32_t seq) const;
-		bool load_segment_payload(uint32_t seq, vector<uint8_t>& out);
+		const uint8_t* segment_payload(uint32_t seq) const;	 // 段负载在输入文件映射中的位置
 		void try_send_data();
 		void process_network();
+		uint64_t next_deadline();  // 主循环的下一个截止时间（最早到期的计时器）
 
 		//   处理ACK相关
-		void handle_ack(const Packet& pkt);
+		void handle_ack(const PacketView& pkt);
 		// 处理新ACK，推进窗口
 		void handle_new_ack(uint32_t ack);
 		// 处理重复ACK，可能触发快速重传
@@ -66,19 +79,26 @@ namespace rtp {
 
 		// === Socket相关 ===
 		socket_t sock_{INVALID_SOCKET_VALUE};  // 本端Socket
+		EventLoop loop_;					   // 等待套接字可读或计时器到期
+		SendBatch send_batch_;				   // 待发数据段（一次 sendmmsg 发出）
+		RecvBatch recv_batch_;				   // 一次 recvmmsg 读取的ACK
 		sockaddr_in remote_{};
 		string dest_ip_;
 		uint16_t dest_port_{0};
 		uint16_t local_port_{0};
 		uint32_t isn_{0};
 		uint32_t peer_isn_{0};
+		bool offload_{false};
+		uint16_t integrity_{0};	 // 报文校验方式：0 为反码校验和，FLAG_CRC 为 CRC32C
 
 		// === 文件与配置 ===
 		string file_path_;
 		uint16_t window_size_{0};
 		uint16_t peer_wnd_{0};
 		uint64_t file_size_{0};
-		std::ifstream input_;
+		MappedFile input_;		 // 输入文件的只读映射
+		ReadAhead read_ahead_;	 // 后台预读（先于 input_ 析构，停止后才解除映射）
+		bool waiting_for_disk_{false};	// 下一个新数据段尚未读入，主循环短间隔轮询
 
 		// === 模块化组件 ===
 		SendWindow window_;				   // 发送窗口管理
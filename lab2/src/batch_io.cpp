@@ -0,0 +1,289 @@
+// batch_io.cpp
+// 批量收发数据报实现
+#include "batch_io.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <netinet/udp.h>
+
+#include <cerrno>
+#include <cstring>
+
+// 旧版 glibc 头文件可能缺少这些定义（取值来自 linux/udp.h）
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#elif !defined(_WIN32)
+#include <sys/uio.h>
+#endif
+
+namespace rtp {
+
+#ifdef __linux__
+	namespace {
+		constexpr size_t GSO_CONTROL_SIZE = CMSG_SPACE(sizeof(uint16_t));
+		constexpr size_t GRO_CONTROL_SIZE = CMSG_SPACE(sizeof(int));
+		constexpr size_t IOVS_PER_PACKET = 3;  // 包头、负载、CRC 尾部
+
+		// 内核不支持或网卡/路由不允许分段卸载时 sendmsg 返回的错误
+		bool gso_refused(int err) { return err == EIO || err == EINVAL || err == EOPNOTSUPP || err == ENOPROTOOPT; }
+	}  // namespace
+#endif
+
+	SendBatch::SendBatch(size_t capacity)
+		: capacity_(capacity),
+		  headers_(capacity, sizeof(PacketHeader) + CRC_TRAILER_SIZE),
+		  payloads_(capacity),
+		  payload_lens_(capacity),
+		  trailer_lens_(capacity) {
+#ifdef __linux__
+		msgs_.resize(capacity_);
+		iovs_.resize(capacity_ * IOVS_PER_PACKET);
+		starts_.resize(capacity_);
+		control_.resize(capacity_ * GSO_CONTROL_SIZE);
+		for (size_t i = 0; i < capacity_; ++i) {
+			iovs_[i * IOVS_PER_PACKET].iov_base = headers_.buffer(i);
+			iovs_[i * IOVS_PER_PACKET].iov_len = sizeof(PacketHeader);
+			iovs_[i * IOVS_PER_PACKET + 2].iov_base = headers_.buffer(i) + sizeof(PacketHeader);
+		}
+#endif
+	}
+
+	void SendBatch::push(const PacketHeader& hdr, const uint8_t* payload, size_t payload_len) {
+		// 校验和在负载原处计算，负载本身留到 flush 时由内核直接读取
+		trailer_lens_[count_] = serialize_header(hdr, payload, payload_len, headers_.buffer(count_));
+		payloads_[count_] = payload;
+		payload_lens_[count_] = payload_len;
+		++count_;
+	}
+
+	bool SendBatch::enable_gso(socket_t sock) {
+#ifdef __linux__
+		// 能读取 UDP_SEGMENT 选项说明内核支持 GSO（4.18+）
+		int value = 0;
+		socklen_t len = sizeof(value);
+		gso_ = getsockopt(sock, SOL_UDP, UDP_SEGMENT, &value, &len) == 0;
+#else
+		(void)sock;
+#endif
+		return gso_;
+	}
+
+#ifdef __linux__
+	size_t SendBatch::build_messages(size_t first, const sockaddr_in& to) {
+		size_t count = count_;
+		size_t msg_count = 0;
+		size_t i = first;
+		while (i < count) {
+			// 一段连续的等长包：总长与段数不超过内核上限，最后一个包允许更短
+			// 内核把消息中全部 iovec 视为连续数据再按 seg_size 切分，包头、负载、尾部分成多项不影响分段
+			size_t seg_size = sizeof(PacketHeader) + payload_lens_[i] + trailer_lens_[i];
+			size_t end = i + 1;
+			size_t bytes = seg_size;
+			if (gso_) {
+				while (end < count && end - i < MAX_GSO_SEGMENTS) {
+					size_t size = sizeof(PacketHeader) + payload_lens_[end] + trailer_lens_[end];
+					if (bytes + size > MAX_GSO_BYTES || size > seg_size) {
+						break;
+					}
+					bytes += size;
+					++end;
+					if (size < seg_size) {
+						break;
+					}
+				}
+			}
+
+			msghdr& hdr = msgs_[msg_count].msg_hdr;
+			hdr = msghdr{};
+			hdr.msg_name = const_cast<sockaddr_in*>(&to);
+			hdr.msg_namelen = sizeof(to);
+			hdr.msg_iov = &iovs_[i * IOVS_PER_PACKET];
+			hdr.msg_iovlen = (end - i) * IOVS_PER_PACKET;
+			if (end - i > 1) {
+				// 多个包合成一条消息，由内核按 seg_size 切回独立的数据报
+				char* control = control_.data() + msg_count * GSO_CONTROL_SIZE;
+				std::memset(control, 0, GSO_CONTROL_SIZE);
+				hdr.msg_control = control;
+				hdr.msg_controllen = GSO_CONTROL_SIZE;
+				cmsghdr* cm = CMSG_FIRSTHDR(&hdr);
+				cm->cmsg_level = SOL_UDP;
+				cm->cmsg_type = UDP_SEGMENT;
+				cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+				uint16_t gso_size = static_cast<uint16_t>(seg_size);
+				std::memcpy(CMSG_DATA(cm), &gso_size, sizeof(gso_size));
+			}
+			starts_[msg_count] = i;
+			++msg_count;
+			i = end;
+		}
+		return msg_count;
+	}
+#endif
+
+	size_t SendBatch::flush(socket_t sock, const sockaddr_in& to) {
+		size_t count = count_;
+		size_t sent = 0;
+#ifdef __linux__
+		for (size_t i = 0; i < count; ++i) {
+			// 负载项直接指向调用方缓冲（只读，iovec 接口要求非 const 指针）
+			iovs_[i * IOVS_PER_PACKET + 1].iov_base = const_cast<uint8_t*>(payloads_[i]);
+			iovs_[i * IOVS_PER_PACKET + 1].iov_len = payload_lens_[i];
+			iovs_[i * IOVS_PER_PACKET + 2].iov_len = trailer_lens_[i];
+		}
+		size_t next = 0;  // 第一个尚未发出的包
+		while (next < count) {
+			size_t msg_count = build_messages(next, to);
+			size_t done = 0;
+			int err = 0;
+			// sendmmsg 可能只发出一部分：从未发出的位置继续，出错时停止
+			while (done < msg_count) {
+				int n = sendmmsg(sock, msgs_.data() + done, static_cast<unsigned int>(msg_count - done), 0);
+				if (n <= 0) {
+					err = errno;
+					break;
+				}
+				done += static_cast<size_t>(n);
+			}
+			size_t stop = done < msg_count ? starts_[done] : count;
+			sent += stop - next;
+			next = stop;
+			if (done == msg_count || !gso_ || !gso_refused(err)) {
+				break;	// 全部发出，或与分段卸载无关的错误：剩余的包按丢包处理
+			}
+			// 内核拒绝分段卸载：关闭 GSO，剩余的包逐个数据报重发
+			gso_ = false;
+		}
+#elif defined(_WIN32)
+		for (size_t i = 0; i < count; ++i) {
+			WSABUF bufs[3];
+			bufs[0].buf = reinterpret_cast<CHAR*>(headers_.buffer(i));
+			bufs[0].len = static_cast<ULONG>(sizeof(PacketHeader));
+			bufs[1].buf = reinterpret_cast<CHAR*>(const_cast<uint8_t*>(payloads_[i]));
+			bufs[1].len = static_cast<ULONG>(payload_lens_[i]);
+			bufs[2].buf = reinterpret_cast<CHAR*>(headers_.buffer(i) + sizeof(PacketHeader));
+			bufs[2].len = static_cast<ULONG>(trailer_lens_[i]);
+			DWORD n = 0;
+			if (WSASendTo(sock, bufs, 3, &n, 0, reinterpret_cast<const sockaddr*>(&to), sizeof(to), nullptr,
+						  nullptr) == 0 &&
+				n > 0) {
+				++sent;
+			}
+		}
+#else
+		for (size_t i = 0; i < count; ++i) {
+			iovec iov[3];
+			iov[0].iov_base = headers_.buffer(i);
+			iov[0].iov_len = sizeof(PacketHeader);
+			iov[1].iov_base = const_cast<uint8_t*>(payloads_[i]);
+			iov[1].iov_len = payload_lens_[i];
+			iov[2].iov_base = headers_.buffer(i) + sizeof(PacketHeader);
+			iov[2].iov_len = trailer_lens_[i];
+			msghdr hdr{};
+			hdr.msg_name = const_cast<sockaddr_in*>(&to);
+			hdr.msg_namelen = sizeof(to);
+			hdr.msg_iov = iov;
+			hdr.msg_iovlen = 3;
+			if (sendmsg(sock, &hdr, 0) > 0) {
+				++sent;
+			}
+		}
+#endif
+		count_ = 0;
+		return sent;
+	}
+
+	RecvBatch::RecvBatch(size_t capacity) : capacity_(capacity), addrs_(capacity) { allocate(MAX_DATAGRAM); }
+
+	void RecvBatch::allocate(size_t buffer_size) {
+		pool_.reset(capacity_, buffer_size);
+		views_.clear();
+#ifdef __linux__
+		views_.reserve(gro_ ? capacity_ * MAX_GSO_SEGMENTS : capacity_);
+		msgs_.resize(capacity_);
+		iovs_.resize(capacity_);
+		control_.assign(capacity_ * GRO_CONTROL_SIZE, 0);
+		for (size_t i = 0; i < capacity_; ++i) {
+			iovs_[i].iov_base = pool_.buffer(i);
+			iovs_[i].iov_len = pool_.buffer_size();
+		}
+#else
+		views_.reserve(1);
+#endif
+	}
+
+	bool RecvBatch::enable_gro(socket_t sock) {
+#ifdef __linux__
+		int one = 1;
+		if (setsockopt(sock, SOL_UDP, UDP_GRO, &one, sizeof(one)) == 0) {
+			gro_ = true;
+			allocate(MAX_GRO_BUFFER);
+		}
+#else
+		(void)sock;
+#endif
+		return gro_;
+	}
+
+	size_t RecvBatch::receive(socket_t sock) {
+		views_.clear();
+#ifdef __linux__
+		for (size_t i = 0; i < capacity_; ++i) {
+			msghdr& hdr = msgs_[i].msg_hdr;
+			hdr = msghdr{};
+			hdr.msg_name = &addrs_[i];
+			hdr.msg_namelen = sizeof(sockaddr_in);	// 每次调用前重置，内核会改写
+			hdr.msg_iov = &iovs_[i];
+			hdr.msg_iovlen = 1;
+			if (gro_) {
+				hdr.msg_control = control_.data() + i * GRO_CONTROL_SIZE;
+				hdr.msg_controllen = GRO_CONTROL_SIZE;
+			}
+		}
+		// 不阻塞：套接字已可读，读完已到达的数据报即返回
+		int n = recvmmsg(sock, msgs_.data(), static_cast<unsigned int>(capacity_), MSG_DONTWAIT, nullptr);
+		if (n <= 0) {
+			return 0;
+		}
+		for (size_t i = 0; i < static_cast<size_t>(n); ++i) {
+			const uint8_t* base = pool_.buffer(i);
+			size_t len = msgs_[i].msg_len;
+			// 合并缓冲带有 UDP_GRO 控制信息，给出原始数据报的段长（最后一个可以更短）
+			size_t seg_size = 0;
+			msghdr& hdr = msgs_[i].msg_hdr;
+			for (cmsghdr* cm = gro_ ? CMSG_FIRSTHDR(&hdr) : nullptr; cm != nullptr; cm = CMSG_NXTHDR(&hdr, cm)) {
+				if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+					int value = 0;
+					std::memcpy(&value, CMSG_DATA(cm), sizeof(value));
+					seg_size = value > 0 ? static_cast<size_t>(value) : 0;
+				}
+			}
+			if (seg_size == 0 || seg_size >= len) {
+				views_.push_back({base, len, i});
+				continue;
+			}
+			for (size_t offset = 0; offset < len; offset += seg_size) {
+				views_.push_back({base + offset, std::min(seg_size, len - offset), i});
+			}
+		}
+		return views_.size();
+#else
+		socklen_t len = sizeof(sockaddr_in);
+		int n = recvfrom(sock, reinterpret_cast<char*>(pool_.buffer(0)), static_cast<int>(pool_.buffer_size()), 0,
+						 reinterpret_cast<sockaddr*>(&addrs_[0]), &len);
+		if (n <= 0) {
+			return 0;
+		}
+		views_.push_back({pool_.buffer(0), static_cast<size_t>(n), 0});
+		return views_.size();
+#endif
+	}
+
+}  // namespace rtp
@@ -0,0 +1,279 @@
+// checksum.cpp
+// 报文完整性校验实现
+#include "checksum.h"
+
+#include <algorithm>
+#include <cstring>
+
+// x86：SSE2 为 x86-64 基线指令，AVX2/SSE4.2 按函数开启并在运行时检测
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RTP_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define RTP_NEON 1
+#include <arm_neon.h>
+#endif
+#if defined(__ARM_FEATURE_CRC32)
+#define RTP_ARM_CRC 1
+#include <arm_acle.h>
+#endif
+
+namespace rtp {
+	namespace {
+		// 向量实现每轮给每个 32 位通道最多加 4 个 0xFFFF，分块后转入 64 位总和，通道不会溢出
+		constexpr size_t CHUNK_ROUNDS = 8192;
+
+		// 把宽累加和折叠回 16 位：值模 0xFFFF 不变，且仅当全部字为 0 时结果为 0，与逐字折叠逐位一致
+		uint32_t fold(uint64_t sum) {
+			while (sum >> 16) {
+				sum = (sum & 0xFFFF) + (sum >> 16);
+			}
+			return static_cast<uint32_t>(sum);
+		}
+
+		/**
+		 * 按大端字累加，不逐次折叠
+		 * 4 字节大端数 = 高 16 位 * 65536 + 低 16 位，模 0xFFFF 与两个字之和同余，因此一次取 4 字节
+		 */
+		uint64_t sum_be_words(const uint8_t* data, size_t len) {
+			uint64_t sum = 0;
+			size_t i = 0;
+			for (; i + 4 <= len; i += 4) {
+				sum += (static_cast<uint32_t>(data[i]) << 24) | (static_cast<uint32_t>(data[i + 1]) << 16) |
+					   (static_cast<uint32_t>(data[i + 2]) << 8) | data[i + 3];
+			}
+			if (i + 2 <= len) {
+				sum += static_cast<uint32_t>((data[i] << 8) | data[i + 1]);
+				i += 2;
+			}
+			if (i < len) {
+				// 剩余一个字节，补0处理
+				sum += static_cast<uint32_t>(data[i] << 8);
+			}
+			return sum;
+		}
+
+		// 向量实现：按本机（小端）字节序累加前 done 字节的 16 位字，剩余部分由调用方按标量处理
+		using NativeSum = uint64_t (*)(const uint8_t* data, size_t len, size_t& done);
+
+#ifdef __SSE2__
+		uint64_t sum_sse2(const uint8_t* data, size_t len, size_t& done) {
+			const __m128i zero = _mm_setzero_si128();
+			const uint8_t* p = data;
+			size_t rounds = len / 32;
+			uint64_t total = 0;
+			while (rounds > 0) {
+				size_t n = std::min(rounds, CHUNK_ROUNDS);
+				rounds -= n;
+				__m128i acc = zero;
+				for (; n > 0; --n, p += 32) {
+					__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+					__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16));
+					// 16 位字零扩展为 32 位后相加
+					acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(a, zero));
+					acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(a, zero));
+					acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(b, zero));
+					acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(b, zero));
+				}
+				uint32_t lanes[4];
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), acc);
+				total += static_cast<uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+			}
+			done = static_cast<size_t>(p - data);
+			return total;
+		}
+#endif
+
+#ifdef RTP_X86_DISPATCH
+		__attribute__((target("avx2"))) uint64_t sum_avx2(const uint8_t* data, size_t len, size_t& done) {
+			const __m256i zero = _mm256_setzero_si256();
+			const uint8_t* p = data;
+			size_t rounds = len / 64;
+			uint64_t total = 0;
+			while (rounds > 0) {
+				size_t n = std::min(rounds, CHUNK_ROUNDS);
+				rounds -= n;
+				__m256i acc = zero;
+				for (; n > 0; --n, p += 64) {
+					__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+					__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+					acc = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(a, zero));
+					acc = _mm256_add_epi32(acc, _mm256_unpackhi_epi16(a, zero));
+					acc = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(b, zero));
+					acc = _mm256_add_epi32(acc, _mm256_unpackhi_epi16(b, zero));
+				}
+				uint32_t lanes[8];
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+				for (uint32_t lane : lanes) {
+					total += lane;
+				}
+			}
+			done = static_cast<size_t>(p - data);
+			return total;
+		}
+#endif
+
+#ifdef RTP_NEON
+		uint64_t sum_neon(const uint8_t* data, size_t len, size_t& done) {
+			const uint8_t* p = data;
+			size_t rounds = len / 32;
+			uint64_t total = 0;
+			while (rounds > 0) {
+				size_t n = std::min(rounds, CHUNK_ROUNDS);
+				rounds -= n;
+				uint32x4_t acc = vdupq_n_u32(0);
+				for (; n > 0; --n, p += 32) {
+					// 相邻两个 16 位字相加后累加到 32 位通道
+					acc = vpadalq_u16(acc, vreinterpretq_u16_u8(vld1q_u8(p)));
+					acc = vpadalq_u16(acc, vreinterpretq_u16_u8(vld1q_u8(p + 16)));
+				}
+				uint64x2_t wide = vpaddlq_u32(acc);
+				total += vgetq_lane_u64(wide, 0) + vgetq_lane_u64(wide, 1);
+			}
+			done = static_cast<size_t>(p - data);
+			return total;
+		}
+#endif
+
+		struct OnesBackend {
+			const char* name;
+			NativeSum sum;	// 为空表示只用标量实现
+		};
+
+		OnesBackend select_ones_backend() {
+#ifdef RTP_X86_DISPATCH
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx2")) {
+				return {"avx2", sum_avx2};
+			}
+#endif
+#if defined(__SSE2__)
+			return {"sse2", sum_sse2};
+#elif defined(RTP_NEON)
+			return {"neon", sum_neon};
+#else
+			return {"scalar", nullptr};
+#endif
+		}
+
+		const OnesBackend& ones_backend() {
+			static const OnesBackend backend = select_ones_backend();
+			return backend;
+		}
+
+		// CRC32C 反射多项式
+		constexpr uint32_t CRC32C_POLY = 0x82F63B78u;
+
+		struct Crc32cTable {
+			uint32_t entries[256];
+			Crc32cTable() : entries() {
+				for (uint32_t i = 0; i < 256; ++i) {
+					uint32_t crc = i;
+					for (int bit = 0; bit < 8; ++bit) {
+						crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+					}
+					entries[i] = crc;
+				}
+			}
+		};
+
+		using CrcFunction = uint32_t (*)(uint32_t crc, const uint8_t* data, size_t len);
+
+#ifdef RTP_X86_DISPATCH
+		__attribute__((target("sse4.2"))) uint32_t crc32c_sse42(uint32_t crc, const uint8_t* data, size_t len) {
+			crc = ~crc;
+#ifdef __x86_64__
+			uint64_t wide = crc;
+			for (; len >= 8; len -= 8, data += 8) {
+				uint64_t value;
+				std::memcpy(&value, data, sizeof(value));
+				wide = _mm_crc32_u64(wide, value);
+			}
+			crc = static_cast<uint32_t>(wide);
+#endif
+			for (; len >= 4; len -= 4, data += 4) {
+				uint32_t value;
+				std::memcpy(&value, data, sizeof(value));
+				crc = _mm_crc32_u32(crc, value);
+			}
+			for (; len > 0; --len, ++data) {
+				crc = _mm_crc32_u8(crc, *data);
+			}
+			return ~crc;
+		}
+#endif
+
+#ifdef RTP_ARM_CRC
+		uint32_t crc32c_armv8(uint32_t crc, const uint8_t* data, size_t len) {
+			crc = ~crc;
+			for (; len >= 8; len -= 8, data += 8) {
+				uint64_t value;
+				std::memcpy(&value, data, sizeof(value));
+				crc = __crc32cd(crc, value);
+			}
+			for (; len > 0; --len, ++data) {
+				crc = __crc32cb(crc, *data);
+			}
+			return ~crc;
+		}
+#endif
+
+		struct CrcBackend {
+			const char* name;
+			CrcFunction crc;
+		};
+
+		CrcBackend select_crc_backend() {
+#ifdef RTP_X86_DISPATCH
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("sse4.2")) {
+				return {"sse4.2", crc32c_sse42};
+			}
+#endif
+#ifdef RTP_ARM_CRC
+			return {"armv8", crc32c_armv8};
+#else
+			return {"table", crc32c_scalar};
+#endif
+		}
+
+		const CrcBackend& crc_backend() {
+			static const CrcBackend backend = select_crc_backend();
+			return backend;
+		}
+	}  // namespace
+
+	uint32_t ones_complement_sum(uint32_t sum, const uint8_t* data, size_t len) {
+		const OnesBackend& backend = ones_backend();
+		uint64_t total = sum;
+		size_t done = 0;
+		if (backend.sum != nullptr) {
+			// 反码和与字节序无关（RFC 1071）：按小端读到的是交换了字节的字，折叠后交换回来即为大端字之和
+			uint32_t native = fold(backend.sum(data, len, done));
+			total += ((native & 0xFF) << 8) | (native >> 8);
+		}
+		total += sum_be_words(data + done, len - done);
+		return fold(total);
+	}
+
+	uint32_t ones_complement_sum_scalar(uint32_t sum, const uint8_t* data, size_t len) {
+		return fold(sum + sum_be_words(data, len));
+	}
+
+	const char* ones_complement_backend() { return ones_backend().name; }
+
+	uint32_t crc32c(uint32_t crc, const uint8_t* data, size_t len) { return crc_backend().crc(crc, data, len); }
+
+	uint32_t crc32c_scalar(uint32_t crc, const uint8_t* data, size_t len) {
+		static const Crc32cTable table;
+		crc = ~crc;
+		for (size_t i = 0; i < len; ++i) {
+			crc = table.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	const char* crc32c_backend() { return crc_backend().name; }
+
+}  // namespace rtp
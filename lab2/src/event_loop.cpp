@@ -0,0 +1,143 @@
+// event_loop.cpp
+// 套接字事件等待实现
+#include "event_loop.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+
+namespace rtp {
+
+	EventLoop::~EventLoop() { close(); }
+
+#ifdef __linux__
+	bool EventLoop::open(socket_t sock) {
+		close();
+		epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+		timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+		if (epoll_fd_ < 0 || timer_fd_ < 0) {
+			close();
+			return false;
+		}
+		// 套接字与计时器都只关心可读事件，用 fd 区分
+		epoll_event ev{};
+		ev.events = EPOLLIN;
+		ev.data.fd = sock;
+		if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, sock, &ev) != 0) {
+			close();
+			return false;
+		}
+		ev.data.fd = timer_fd_;
+		if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, timer_fd_, &ev) != 0) {
+			close();
+			return false;
+		}
+		sock_ = sock;
+		armed_at_ = 0;
+		return true;
+	}
+
+	void EventLoop::close() {
+		if (epoll_fd_ >= 0) {
+			::close(epoll_fd_);
+			epoll_fd_ = -1;
+		}
+		if (timer_fd_ >= 0) {
+			::close(timer_fd_);
+			timer_fd_ = -1;
+		}
+		sock_ = INVALID_SOCKET_VALUE;
+		armed_at_ = 0;
+	}
+
+	/**
+	 * 按绝对时间布防计时器
+	 * @param deadline_ms 截止时间（now_ms 时间轴），0 表示解除布防
+	 * 截止时间已过时计时器立即到期
+	 */
+	bool EventLoop::arm_timer(uint64_t deadline_ms) {
+		if (deadline_ms == armed_at_) {
+			return true;  // 截止时间未变，无需系统调用
+		}
+		itimerspec spec{};	// it_value 全 0 表示解除布防
+		spec.it_value.tv_sec = static_cast<time_t>(deadline_ms / 1000);
+		spec.it_value.tv_nsec = static_cast<long>((deadline_ms % 1000) * 1000000);
+		if (timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr) != 0) {
+			return false;
+		}
+		armed_at_ = deadline_ms;
+		return true;
+	}
+
+	bool EventLoop::wait_until(uint64_t deadline_ms) {
+		if (epoll_fd_ < 0 || !arm_timer(deadline_ms)) {
+			return false;
+		}
+		epoll_event events[2];
+		while (true) {
+			int n = epoll_wait(epoll_fd_, events, 2, -1);
+			if (n < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return false;
+			}
+			bool readable = false;
+			for (int i = 0; i < n; ++i) {
+				if (events[i].data.fd == timer_fd_) {
+					// 读出到期次数以清除可读状态；一次性计时器到期后即解除布防
+					uint64_t ticks = 0;
+					if (::read(timer_fd_, &ticks, sizeof(ticks)) == static_cast<ssize_t>(sizeof(ticks))) {
+						armed_at_ = 0;
+					}
+				} else {
+					readable = true;
+				}
+			}
+			if (readable) {
+				return true;
+			}
+			if (armed_at_ == 0) {
+				return false;  // 到达截止时间
+			}
+		}
+	}
+
+	bool EventLoop::wait_for(int timeout_ms) { return wait_until(timeout_ms < 0 ? 0 : now_ms() + timeout_ms); }
+#else
+	bool EventLoop::open(socket_t sock) {
+		sock_ = sock;
+		return socket_valid(sock_);
+	}
+
+	void EventLoop::close() { sock_ = INVALID_SOCKET_VALUE; }
+
+	bool EventLoop::wait_until(uint64_t deadline_ms) {
+		int timeout_ms = -1;
+		if (deadline_ms != 0) {
+			uint64_t now = now_ms();
+			timeout_ms = deadline_ms > now ? static_cast<int>(deadline_ms - now) : 0;
+		}
+		return wait_for(timeout_ms);
+	}
+
+	bool EventLoop::wait_for(int timeout_ms) {
+		fd_set rfds;  // 声明读文件描述符集合
+		FD_ZERO(&rfds);
+		FD_SET(sock_, &rfds);
+		timeval tv{};  // 超时结构体
+		if (timeout_ms >= 0) {
+			tv.tv_sec = timeout_ms / 1000;
+			tv.tv_usec = (timeout_ms % 1000) * 1000;
+		}
+		// 等待数据可读或超时（Winsock 忽略第一个参数）
+		int rv = select(static_cast<int>(sock_) + 1, &rfds, nullptr, nullptr, timeout_ms >= 0 ? &tv : nullptr);
+		return rv > 0;
+	}
+#endif
+
+}  // namespace rtp
@@ -0,0 +1,120 @@
+// mapped_file.cpp
+// 只读文件映射实现
+#include "mapped_file.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace rtp {
+
+	MappedFile::~MappedFile() { close(); }
+
+	bool MappedFile::open(const string& path) {
+		close();
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+								  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(file, &size)) {
+			CloseHandle(file);
+			return false;
+		}
+		size_ = static_cast<uint64_t>(size.QuadPart);
+		if (size_ == 0) {
+			// 空文件无法映射，也不需要映射
+			CloseHandle(file);
+			return true;
+		}
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		CloseHandle(file);	// 映射对象持有文件引用
+		if (mapping == nullptr) {
+			size_ = 0;
+			return false;
+		}
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);  // 视图持有映射对象引用，UnmapViewOfFile 时一并释放
+		if (view == nullptr) {
+			size_ = 0;
+			return false;
+		}
+		data_ = static_cast<const uint8_t*>(view);
+		return true;
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat st {};
+		if (fstat(fd, &st) != 0) {
+			::close(fd);
+			return false;
+		}
+		size_ = static_cast<uint64_t>(st.st_size);
+		if (static_cast<uint64_t>(static_cast<size_t>(size_)) != size_) {
+			// 32 位平台上超出地址空间的文件无法整体映射
+			::close(fd);
+			size_ = 0;
+			return false;
+		}
+		if (size_ == 0) {
+			// 空文件无法映射，也不需要映射
+			::close(fd);
+			return true;
+		}
+		void* addr = mmap(nullptr, static_cast<size_t>(size_), PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);  // 映射建立后文件描述符不再需要
+		if (addr == MAP_FAILED) {
+			size_ = 0;
+			return false;
+		}
+		// 顺序访问：加大预读并尽早回收已读过的页；提前读入：发送开始前就发起读盘，减少首轮缺页等待
+		madvise(addr, static_cast<size_t>(size_), MADV_SEQUENTIAL);
+		madvise(addr, static_cast<size_t>(size_), MADV_WILLNEED);
+		data_ = static_cast<const uint8_t*>(addr);
+		return true;
+#endif
+	}
+
+	void MappedFile::discard_before(uint64_t offset) {
+#ifdef _WIN32
+		(void)offset;
+#else
+		if (data_ == nullptr || offset < discarded_ + DISCARD_STEP) {
+			return;
+		}
+		uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+		uint64_t end = std::min(offset, size_) / page * page;
+		if (end <= discarded_) {
+			return;
+		}
+		// 只读私有映射中的页与页缓存共享，MADV_DONTNEED 只解除本进程的映射，之后再访问会重新从页缓存映射
+		madvise(const_cast<uint8_t*>(data_) + discarded_, static_cast<size_t>(end - discarded_), MADV_DONTNEED);
+		discarded_ = end;
+#endif
+	}
+
+	void MappedFile::close() {
+		if (data_ != nullptr) {
+#ifdef _WIN32
+			UnmapViewOfFile(data_);
+#else
+			munmap(const_cast<uint8_t*>(data_), static_cast<size_t>(size_));
+#endif
+		}
+		data_ = nullptr;
+		size_ = 0;
+		discarded_ = 0;
+	}
+
+}  // namespace rtp
@@ -0,0 +1,316 @@
+// output_file.cpp
+// 接收端输出文件实现
+#include "output_file.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace rtp {
+	namespace {
+#ifdef __linux__
+		// 一次 pwritev 的最大数组长度（POSIX 规定 IOV_MAX 不小于 16，Linux 为 1024）
+		constexpr size_t MAX_IOVS = 1024;
+#endif
+	}  // namespace
+
+	OutputFile::~OutputFile() { close(); }
+
+	bool OutputFile::open(const string& path) {
+		close();
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		handle_ = file;
+#else
+		fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd_ < 0) {
+			return false;
+		}
+#endif
+		if (ring_.empty()) {
+			ring_.resize(RING_SIZE);
+			for (Batch& batch : ring_) {
+				batch.data.reset(new uint8_t[BATCH_BYTES]);
+			}
+		}
+		for (Batch& batch : ring_) {
+			batch.used = 0;
+			batch.pieces.clear();
+		}
+		fill_ = 0;
+		filling_ = true;
+		write_ = 0;
+		queued_ = 0;
+		stop_ = false;
+		failed_ = false;
+		thread_ = std::thread(&OutputFile::run, this);
+		return true;
+	}
+
+	bool OutputFile::is_open() const {
+#ifdef _WIN32
+		return handle_ != nullptr;
+#else
+		return fd_ >= 0;
+#endif
+	}
+
+	bool OutputFile::preallocate(uint64_t size) {
+		if (!is_open() || size == 0) {
+			return false;
+		}
+#ifdef _WIN32
+		LARGE_INTEGER end{};
+		end.QuadPart = static_cast<LONGLONG>(size);
+		return SetFilePointerEx(static_cast<HANDLE>(handle_), end, nullptr, FILE_BEGIN) &&
+			   SetEndOfFile(static_cast<HANDLE>(handle_));
+#else
+#ifdef __linux__
+		// 一次分配出全部数据块：乱序写入不会产生碎片，也不会在传输中途才发现空间不足
+		if (fallocate(fd_, 0, 0, static_cast<off_t>(size)) == 0) {
+			return true;
+		}
+#endif
+		// 文件系统不支持预分配：只扩展长度（稀疏文件），写入位置仍然正确
+		return ftruncate(fd_, static_cast<off_t>(size)) == 0;
+#endif
+	}
+
+	bool OutputFile::write_at(uint64_t offset, const uint8_t* data, size_t len) {
+		if (!is_open() || len > BATCH_BYTES) {
+			return false;
+		}
+		if (len == 0) {
+			return true;
+		}
+		if (!filling_ && !acquire()) {
+			return false;
+		}
+		if (ring_[fill_].used + len > BATCH_BYTES) {
+			// 当前批次已满：交给写盘线程，换下一个空闲批次
+			submit();
+			if (!acquire()) {
+				return false;
+			}
+		}
+		Batch& batch = ring_[fill_];
+		std::memcpy(batch.data.get() + batch.used, data, len);
+		batch.pieces.push_back({offset, batch.used, len});
+		batch.used += len;
+		return true;
+	}
+
+	size_t OutputFile::free_slots(size_t len) const {
+		if (!is_open() || len == 0) {
+			return 0;
+		}
+		size_t idle = 0;  // 未在排队的批次数（含正在填充的）
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			idle = RING_SIZE - queued_;
+		}
+		size_t slots = 0;
+		if (filling_) {
+			slots += (BATCH_BYTES - ring_[fill_].used) / len;
+			idle--;
+		}
+		return slots + idle * (BATCH_BYTES / len);
+	}
+
+	void OutputFile::submit() {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			queued_++;
+		}
+		cv_.notify_all();
+		fill_ = (fill_ + 1) % RING_SIZE;
+		filling_ = false;
+	}
+
+	bool OutputFile::acquire() {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			// 已提交的批次从 write_ 起连续排列，fill_ 紧随其后，全部排队时 fill_ 就是写盘线程尚未写完的批次
+			if (queued_ >= RING_SIZE) {
+				return false;
+			}
+		}
+		Batch& batch = ring_[fill_];
+		batch.used = 0;
+		batch.pieces.clear();
+		filling_ = true;
+		return true;
+	}
+
+	void OutputFile::run() {
+		while (true) {
+			Batch* batch = nullptr;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				// 停止前先写完已提交的批次
+				cv_.wait(lock, [&] { return stop_ || queued_ > 0; });
+				if (queued_ == 0) {
+					return;
+				}
+				batch = &ring_[write_];
+			}
+			bool ok = write_batch(*batch);
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				write_ = (write_ + 1) % RING_SIZE;
+				queued_--;
+				failed_ = failed_ || !ok;
+			}
+			cv_.notify_all();
+		}
+	}
+
+	bool OutputFile::write_batch(Batch& batch) {
+		// 批次内按到达顺序存放，乱序段排序后与前后段在文件中重新连成一片
+		std::sort(batch.pieces.begin(), batch.pieces.end(),
+				  [](const Piece& a, const Piece& b) { return a.offset < b.offset; });
+		bool ok = true;
+		size_t i = 0;
+		while (i < batch.pieces.size()) {
+			uint64_t start = batch.pieces[i].offset;
+			uint64_t end = start;
+			blocks_.clear();
+			// 文件中首尾相接的段组成一次写入，在批次中也相邻的段合并为一块
+			for (; i < batch.pieces.size() && batch.pieces[i].offset == end; ++i) {
+				const Piece& piece = batch.pieces[i];
+				const uint8_t* data = batch.data.get() + piece.pos;
+				if (!blocks_.empty() && blocks_.back().data + blocks_.back().len == data) {
+					blocks_.back().len += piece.len;
+				} else {
+					blocks_.push_back({data, piece.len});
+				}
+				end += piece.len;
+			}
+			ok = write_run(start, blocks_.data(), blocks_.size()) && ok;
+		}
+		return ok;
+	}
+
+	bool OutputFile::write_run(uint64_t offset, const Block* blocks, size_t count) {
+#if defined(__linux__)
+		// 一次系统调用写出整段，被截断（短写）时从已写到的位置继续
+		iovec iov[MAX_IOVS];
+		size_t next = 0;
+		size_t skip = 0;  // 当前块中已写出的字节数
+		while (next < count) {
+			size_t n = 0;
+			for (size_t i = next; i < count && n < MAX_IOVS; ++i, ++n) {
+				size_t s = (i == next) ? skip : 0;
+				iov[n].iov_base = const_cast<uint8_t*>(blocks[i].data + s);
+				iov[n].iov_len = blocks[i].len - s;
+			}
+			ssize_t written = pwritev(fd_, iov, static_cast<int>(n), static_cast<off_t>(offset));
+			if (written < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return false;
+			}
+			offset += static_cast<uint64_t>(written);
+			size_t remaining = static_cast<size_t>(written);
+			while (next < count && remaining >= blocks[next].len - skip) {
+				remaining -= blocks[next].len - skip;
+				skip = 0;
+				next++;
+			}
+			skip += remaining;
+		}
+		return true;
+#else
+		for (size_t i = 0; i < count; ++i) {
+			const uint8_t* data = blocks[i].data;
+			size_t len = blocks[i].len;
+			while (len > 0) {
+#ifdef _WIN32
+				OVERLAPPED at{};
+				at.Offset = static_cast<DWORD>(offset);
+				at.OffsetHigh = static_cast<DWORD>(offset >> 32);
+				DWORD written = 0;
+				if (!WriteFile(static_cast<HANDLE>(handle_), data, static_cast<DWORD>(len), &written, &at)) {
+					return false;
+				}
+#else
+				ssize_t written = pwrite(fd_, data, len, static_cast<off_t>(offset));
+				if (written < 0) {
+					if (errno == EINTR) {
+						continue;
+					}
+					return false;
+				}
+#endif
+				data += written;
+				len -= static_cast<size_t>(written);
+				offset += static_cast<uint64_t>(written);
+			}
+		}
+		return true;
+#endif
+	}
+
+	bool OutputFile::finish(uint64_t length) {
+		if (!is_open()) {
+			return false;
+		}
+		if (filling_ && ring_[fill_].used > 0) {
+			submit();
+		}
+		stop();	 // 写盘线程写完全部已提交的批次后退出
+		bool ok = !failed_;
+#ifdef _WIN32
+		LARGE_INTEGER end{};
+		end.QuadPart = static_cast<LONGLONG>(length);
+		ok = SetFilePointerEx(static_cast<HANDLE>(handle_), end, nullptr, FILE_BEGIN) &&
+			 SetEndOfFile(static_cast<HANDLE>(handle_)) && ok;
+#else
+		ok = ftruncate(fd_, static_cast<off_t>(length)) == 0 && ok;
+#endif
+		close();
+		return ok;
+	}
+
+	void OutputFile::stop() {
+		if (!thread_.joinable()) {
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		cv_.notify_all();
+		thread_.join();
+	}
+
+	void OutputFile::close() {
+		stop();
+#ifdef _WIN32
+		if (handle_ != nullptr) {
+			CloseHandle(static_cast<HANDLE>(handle_));
+		}
+		handle_ = nullptr;
+#else
+		if (fd_ >= 0) {
+			::close(fd_);
+		}
+		fd_ = -1;
+#endif
+		filling_ = false;
+	}
+
+}  // namespace rtp
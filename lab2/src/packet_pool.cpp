@@ -0,0 +1,34 @@
+// packet_pool.cpp
+// 数据包缓冲池实现
+#include "packet_pool.h"
+
+#include <cstring>
+#include <new>
+
+namespace rtp {
+
+	PacketPool::PacketPool(size_t count, size_t buffer_size) { reset(count, buffer_size); }
+
+	PacketPool::~PacketPool() { release(); }
+
+	void PacketPool::reset(size_t count, size_t buffer_size) {
+		release();
+		count_ = count;
+		buffer_size_ = buffer_size;
+		stride_ = (buffer_size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+		size_t bytes = count_ * stride_;
+		if (bytes == 0) {
+			return;
+		}
+		base_ = static_cast<uint8_t*>(::operator new(bytes, std::align_val_t{ALIGNMENT}));
+		std::memset(base_, 0, bytes);  // 预先触碰全部页面，避免首次使用时缺页
+	}
+
+	void PacketPool::release() {
+		if (base_ != nullptr) {
+			::operator delete(base_, std::align_val_t{ALIGNMENT});
+			base_ = nullptr;
+		}
+	}
+
+}  // namespace rtp
@@ -0,0 +1,73 @@
+// read_ahead.cpp
+// 输入文件预读实现
+#include "read_ahead.h"
+
+#include <algorithm>
+
+namespace rtp {
+
+	ReadAhead::~ReadAhead() { stop(); }
+
+	void ReadAhead::start(const uint8_t* data, uint64_t size, uint64_t window) {
+		stop();
+		data_ = data;
+		size_ = size;
+		window_ = window;
+		notified_ = 0;
+		consumed_ = 0;
+		stop_ = false;
+		ready_.store(0, std::memory_order_release);
+		if (data_ != nullptr && size_ > 0) {
+			thread_ = std::thread(&ReadAhead::run, this);
+		}
+	}
+
+	void ReadAhead::stop() {
+		if (!thread_.joinable()) {
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stop_ = true;
+		}
+		cv_.notify_one();
+		thread_.join();
+	}
+
+	void ReadAhead::consume(uint64_t offset) {
+		if (offset < notified_ + CHUNK) {
+			return;
+		}
+		notified_ = offset;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			consumed_ = offset;
+		}
+		cv_.notify_one();
+	}
+
+	void ReadAhead::run() {
+		uint64_t pos = 0;
+		while (pos < size_) {
+			uint64_t target = 0;
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				// 领先消费位置一个预读窗口后休眠，等消费位置前进
+				cv_.wait(lock, [&] { return stop_ || pos < std::min(size_, consumed_ + window_); });
+				if (stop_) {
+					return;
+				}
+				target = std::min(size_, consumed_ + window_);
+			}
+			uint64_t end = std::min(target, pos + CHUNK);
+			// 访问每一页的一个字节：缺页读盘发生在本线程，网络循环之后访问时页已在内存中
+			volatile uint8_t sink = 0;
+			for (uint64_t off = pos; off < end; off = (off / PAGE + 1) * PAGE) {
+				sink = sink + data_[off];
+			}
+			pos = end;
+			ready_.store(pos, std::memory_order_release);
+		}
+	}
+
+}  // namespace rtp
@@ -1,40 +1,44 @@
 // 接收缓冲区实现
 #include "receive_buffer.h"
 
-#include <iostream>
+#include <algorithm>
 
 namespace rtp {
 	using std::vector;
-	ReceiveBuffer::ReceiveBuffer(uint16_t window_size) : expected_seq_(0), window_size_(window_size) {}
+	ReceiveBuffer::ReceiveBuffer(uint16_t window_size)
+		: expected_seq_(0),
+		  window_size_(window_size),
+		  slots_(std::max<size_t>(window_size, 1)) {}
+
+	bool ReceiveBuffer::has_segment(uint32_t seq) const {
+		const Slot& slot = slots_[seq % slots_.size()];
+		return slot.present && slot.seq == seq;
+	}
 
-	bool ReceiveBuffer::add_segment(uint32_t seq, const vector<uint8_t>& data) {
+	bool ReceiveBuffer::add_segment(uint32_t seq, size_t len) {
 		// 检查是否已存在
-		if (buffer_.find(seq) != buffer_.end()) {
+		if (has_segment(seq) || len > MAX_PAYLOAD) {
 			return false;
 		}
 
-		buffer_.emplace(seq, data);
+		// 窗口内的序号取模后互不冲突，位置上残留的只可能是已滑出窗口的旧段
+		Slot& slot = slots_[seq % slots_.size()];
+		slot.seq = seq;
+		slot.len = static_cast<uint16_t>(len);
+		slot.present = true;
 		return true;
 	}
 
-	vector<vector<uint8_t>> ReceiveBuffer::extract_continuous_segments() {
-		vector<vector<uint8_t>> result;
-
-		// 从expected_seq开始，提取所有连续的段
-		while (true) {
-			auto it = buffer_.find(expected_seq_);
-			if (it == buffer_.end()) {
-				break;	// 遇到缺口，停止提取
-			}
-
-			// 提取该段数据
-			result.push_back(std::move(it->second));
-			// 从缓冲区移除该段
-			buffer_.erase(it);
-			expected_seq_++;  // 推进期望序号
+	size_t ReceiveBuffer::advance() {
+		size_t bytes = 0;
+		// 滑动窗口：越过从期望序号开始的连续段，遇到缺口停止
+		while (has_segment(expected_seq_)) {
+			Slot& slot = slots_[expected_seq_ % slots_.size()];
+			slot.present = false;
+			bytes += slot.len;
+			expected_seq_++;
 		}
-
-		return result;
+		return bytes;
 	}
 
 	uint32_t ReceiveBuffer::build_sack_mask() const {
@@ -42,7 +46,7 @@ namespace rtp {
 		// 检查expected_seq之后的32个段是否已到达
 		for (uint32_t i = 0; i < 32; ++i) {
 			uint32_t seq = expected_seq_ + 1 + i;
-			if (buffer_.find(seq) != buffer_.end()) {
+			if (has_segment(seq)) {
 				mask |= (1u << i);	// 该段已到达，置位
 			}
 		}
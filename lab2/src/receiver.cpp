@@ -1,13 +1,11 @@
 #include "receiver.h"
 
-#include <fstream>
 #include <iostream>
 
 namespace rtp {
 	using std::cerr;
 	using std::cout;
 	using std::endl;
-	using std::ofstream;
 	using std::size_t;
 	using std::string;
 	using std::vector;
@@ -25,6 +23,11 @@ namespace rtp {
 		constexpr uint16_t SACK_WINDOW_LIMIT = 32;
 		// 最大连续超时次数（超过则认为sender已断开）
 		constexpr int MAX_CONSECUTIVE_TIMEOUTS = 10;
+		// 写盘跟不上、通告窗口缩小时的等待间隔：写盘线程腾出空间后尽快发出窗口更新
+		constexpr int STORAGE_POLL_MS = 1;
+		// 窗口从零重新打开后的窗口更新重发间隔与次数：这个ACK丢失时发送端只能等持续探测（首次 5 秒）
+		constexpr int WINDOW_UPDATE_RETRY_MS = 200;
+		constexpr int MAX_WINDOW_UPDATE_RETRIES = 10;
 	}  // namespace
 
 	// 窗口大小和SACK位图宽度保持一致
@@ -42,32 +45,18 @@ namespace rtp {
 	}
 
 	bool ReliableReceiver::wait_for_packet(Packet& pkt, sockaddr_in& from, int timeout_ms) {
-		fd_set rfds;		   // 声明读文件描述符集合
-		FD_ZERO(&rfds);		   // 清空集合
-		FD_SET(sock_, &rfds);  // 将socket加入集合
-		timeval tv{};		   // 超时结构体
-		if (timeout_ms >= 0) {
-			// 设置超时时间
-			tv.tv_sec = timeout_ms / 1000;			  // s
-			tv.tv_usec = (timeout_ms % 1000) * 1000;  // ms
-		}
-		// 等待数据可读或超时
-		// 它把 sock_ 交给内核监视可读事件，内核在有数据到达（或错误/关闭）时把 socket 标记为“可读”，select
-		// 就返回 >0，rfds 里该 socket 仍在集合。然后才去 recvfrom 把包读出来；如果到超时时间还没有可读，select 返回
-		// 0，视为超 时。
-		// nullptr 表示不设置超时，无限等待
-		int rv = select(0, &rfds, nullptr, nullptr, timeout_ms >= 0 ? &tv : nullptr);
-		if (rv <= 0) {
-			// 超时或出错
-			return false;
-		}
+		// 等待数据可读或超时：内核在有数据到达时把 socket 标记为“可读”，然后才去 recvfrom 把包读出来；
+		// 如果到超时时间还没有可读，视为超时。-1 表示不设置超时，无限等待
+		return loop_.wait_for(timeout_ms) && receive_packet(pkt, from);
+	}
 
+	bool ReliableReceiver::receive_packet(Packet& pkt, sockaddr_in& from) {
 		// 接收数据包
 		sockaddr_in peer{};
 		socklen_t len = sizeof(peer);  // 地址长度
-		vector<uint8_t> buf(2048);	   // 2KB
+		uint8_t buf[MAX_DATAGRAM];	   // 2KB
 		// 接收数据  flags=0 表示阻塞接收 ，记录发送方地址到 peer
-		int n = recvfrom(sock_, reinterpret_cast<char*>(buf.data()), static_cast<int>(buf.size()), 0,
+		int n = recvfrom(sock_, reinterpret_cast<char*>(buf), static_cast<int>(sizeof(buf)), 0,
 						 reinterpret_cast<sockaddr*>(&peer), &len);
 		if (n <= 0) {
 			// 接收失败
@@ -75,7 +64,7 @@ namespace rtp {
 		}
 
 		// 检验校验和并	将数据包解析到 pkt
-		if (!parse_packet(buf.data(), static_cast<size_t>(n), pkt)) {
+		if (!parse_packet(buf, static_cast<size_t>(n), pkt)) {
 			return false;
 		}
 
@@ -84,32 +73,80 @@ namespace rtp {
 		return true;
 	}
 
-	int ReliableReceiver::send_raw(const PacketHeader& hdr, const vector<uint8_t>& payload) {
-		// 序列化并发送数据包
-		auto buffer = serialize_packet(hdr, payload);
+	int ReliableReceiver::send_raw(const PacketHeader& hdr, const uint8_t* payload, size_t payload_len) {
+		// 按协商的校验方式序列化到栈上缓冲并发送数据包
+		PacketHeader out = hdr;
+		out.flags |= integrity_;
+		uint8_t buffer[MAX_PACKET];
+		size_t n = serialize_packet(out, payload, payload_len, buffer);
 		// 发送到客户端地址
-		return sendto(sock_, reinterpret_cast<const char*>(buffer.data()), static_cast<int>(buffer.size()), 0,
+		return sendto(sock_, reinterpret_cast<const char*>(buffer), static_cast<int>(n), 0,
 					  reinterpret_cast<const sockaddr*>(&client_), sizeof(client_));
 	}
 
 	/**
-	 * 发送ACK包
+	 * 构造ACK包
 	 * @param fin 是否为FIN+ACK包
 	 * @param fin_ack FIN的确认序号（仅在fin=true时有效）
 	 * 普通ACK携带SACK掩码，通告发送端乱序段的到达情况
 	 */
-	void ReliableReceiver::send_ack(bool fin, uint32_t fin_ack) {
+	PacketHeader ReliableReceiver::make_ack(bool fin, uint32_t fin_ack) const {
 		PacketHeader ack{};
 		ack.seq = isn_ + 1;	 // 本端下一个序号
 		// ack 是否为 FIN+ACK，否则就是下一个序号
 		ack.ack = fin ? fin_ack : buffer_.get_expected_seq();  // 期望接收的下一个序列号
 		// 设置标志位、窗口大小、SACK掩码
-		ack.flags = FLAG_ACK | (fin ? FLAG_FIN : 0);
-		ack.wnd = window_size_;								  // 通告接收窗口大小
+		ack.flags = FLAG_ACK | (fin ? FLAG_FIN : 0) | integrity_;
+		ack.wnd = advertised_window();						  // 通告接收窗口大小
 		ack.len = 0;										  // 普通ACK携带SACK掩码，FIN+ACK不携带
 		ack.sack_mask = fin ? 0 : buffer_.build_sack_mask();  // SACK掩码
-		// 发送带SACK掩码的ACK包
-		send_raw(ack, {});
+		return ack;
+	}
+
+	uint16_t ReliableReceiver::advertised_window() const {
+		if (!output_.is_open()) {
+			return window_size_;
+		}
+		// 只通告写盘批次放得下的段数，发送端在途数据不会超出暂存空间
+		return static_cast<uint16_t>(std::min<size_t>(window_size_, output_.free_slots(MAX_PAYLOAD)));
+	}
+
+	void ReliableReceiver::send_ack(bool fin, uint32_t fin_ack) {
+		// 立即发送带SACK掩码的ACK包
+		PacketHeader ack = make_ack(fin, fin_ack);
+		note_window(ack.wnd);
+		send_raw(ack);
+	}
+
+	void ReliableReceiver::note_window(uint16_t wnd) {
+		if (wnd == 0) {
+			reopen_pending_ = false;
+		} else if (last_wnd_ == 0) {
+			// 发送端看到零窗口后停发数据：在收到数据之前定期重发窗口更新
+			reopen_pending_ = true;
+			reopen_retries_ = 0;
+			reopen_retry_at_ = now_ms() + WINDOW_UPDATE_RETRY_MS;
+		}
+		last_wnd_ = wnd;
+	}
+
+	/**
+	 * ACK 在收到数据包时按当时的接收状态生成（每个数据包一个ACK，重复ACK计数与拥塞窗口增长不变），
+	 * 只是推迟到本批数据包处理完后再一起发送
+	 */
+	void ReliableReceiver::queue_ack() {
+		PacketHeader ack = make_ack(false, 0);
+		note_window(ack.wnd);
+		ack_batch_.push(ack, nullptr, 0);
+		if (ack_batch_.full()) {
+			flush_acks();
+		}
+	}
+
+	void ReliableReceiver::flush_acks() {
+		if (!ack_batch_.empty()) {
+			ack_batch_.flush(sock_, client_);
+		}
 	}
 
 	/**
@@ -124,7 +161,7 @@ namespace rtp {
 		rst.wnd = 0;
 		rst.len = 0;
 		rst.sack_mask = 0;
-		send_raw(rst, {});
+		send_raw(rst);
 		cout << "[RST] Sent RST segment to reset connection" << endl;
 	}
 
@@ -151,11 +188,20 @@ namespace rtp {
 			// 收到SYN，记录发送方的地址和ISN
 			client_ = from;
 			peer_isn_ = pkt.header.seq;
-			cout << "[DEBUG] Received SYN from " << addr_to_string(from) << endl;
+			// SYN 以 CRC32C 发出表示提议，以同样方式回复即同意，之后整个连接都使用 CRC32C
+			integrity_ = pkt.header.flags & FLAG_CRC;
+			// SYN 负载为文件大小；不带负载的 SYN 来自旧版本发送端，按未知大小处理
+			size_known_ = decode_file_size(pkt.payload, file_size_);
+			cout << "[DEBUG] Received SYN from " << addr_to_string(from)
+				 << ", integrity: " << (integrity_ ? "crc32c" : "checksum");
+			if (size_known_) {
+				cout << ", file size: " << file_size_;
+			}
+			cout << endl;
 
 			// 生成本端ISN
 			sockaddr_in local_info{};  // 本地地址信息
-			int local_len = sizeof(local_info);
+			socklen_t local_len = sizeof(local_info);
 			if (getsockname(sock_, reinterpret_cast<sockaddr*>(&local_info), &local_len) != 0) {
 				// 获取本地地址失败，使用通配地址
 				local_info.sin_family = AF_INET;				 // IPv4
@@ -178,7 +224,7 @@ namespace rtp {
 			// 等待ACK包
 			for (int attempt = 0; attempt < MAX_HANDSHAKE_RETRIES && !acked; ++attempt) {
 				// 在不同重试次数内发送SYN+ACK
-				send_raw(syn_ack, {});	// 发送SYN+ACK
+				send_raw(syn_ack);	// 发送SYN+ACK
 				// 等待ACK或数据包（隐式完成握手）
 				cout << "[DEBUG] Sent SYN+ACK (attempt " << (attempt + 1) << "/" << MAX_HANDSHAKE_RETRIES << ")"
 					 << endl;
@@ -226,11 +272,11 @@ namespace rtp {
 	/**
 	 * 处理接收到的数据包
 	 * 1. 检查是否为重复包或窗口外的包
-	 * 2. 将新包加入缓冲区
-	 * 3. 提取连续段并写入文件
+	 * 2. 按序号算出文件偏移，负载交给输出文件（复制进写盘批次，不等待磁盘）
+	 * 3. 越过连续到达的段，推进窗口左边界
 	 * 4. 发送ACK+SACK
 	 */
-	void ReliableReceiver::process_data_packet(const Packet& pkt, ofstream& out) {
+	void ReliableReceiver::process_data_packet(const PacketView& pkt) {
 		total_packets_received_++;		// 统计总接收包数
 		uint32_t seq = pkt.header.seq;	// 数据包序号
 
@@ -239,7 +285,7 @@ namespace rtp {
 			// 小于期望序号，重复包
 			duplicate_packets_++;
 			cout << "[DUP] Duplicate packet seq=" << seq << " (expected: " << buffer_.get_expected_seq() << ")" << endl;
-			send_ack();	 // 发送新的ack
+			queue_ack();  // 发送新的ack
 			return;
 		}
 
@@ -247,13 +293,29 @@ namespace rtp {
 			// 超出接收窗口
 			cout << "[OVERFLOW] Packet seq=" << seq << " out of window (expected: " << buffer_.get_expected_seq()
 				 << ", window: " << window_size_ << ")" << endl;
-			send_ack();	 // 发送新的ack
+			queue_ack();  // 发送新的ack
 			return;
 		}
 
-		// 将接受的数据添加到缓冲区
-		if (buffer_.add_segment(seq, pkt.payload)) {
+		// 除最后一段外每段都是满载，段在文件中的位置由序号唯一确定
+		uint64_t offset = static_cast<uint64_t>(seq - (peer_isn_ + 1)) * MAX_PAYLOAD;
+		if (pkt.header.len > MAX_PAYLOAD || (size_known_ && offset + pkt.header.len > file_size_)) {
+			// 长度非法或超出通告的文件大小，不是本次传输的数据
+			cout << "[OVERFLOW] Packet seq=" << seq << " beyond announced file size " << file_size_ << endl;
+			queue_ack();
+			return;
+		}
+
+		if (buffer_.has_segment(seq)) {
+			// 已经在缓冲区的重复包
+			duplicate_packets_++;
+			cout << "[DUP] Duplicate packet seq=" << seq << " (already buffered)" << endl;
+		} else if (!output_.write_at(offset, pkt.payload, pkt.header.len)) {
+			// 写盘批次全部在排队：磁盘跟不上网络，不接收该段（不等待磁盘），发送端会按丢包重传并降速
+			storage_drops_++;
+		} else {
 			// 新包成功添加
+			buffer_.add_segment(seq, pkt.header.len);
 			if (seq > buffer_.get_expected_seq()) {
 				// 如果不是期望的序号，统计乱序包
 				out_of_order_packets_++;
@@ -261,22 +323,13 @@ namespace rtp {
 				// ")"
 				// 	 << endl;
 			}
-		} else {
-			// 已经在缓冲区的重复包
-			duplicate_packets_++;
-			cout << "[DUP] Duplicate packet seq=" << seq << " (already buffered)" << endl;
 		}
 
-		// 滑动窗口：提取数据并，推进窗口左边界
-		auto segments = buffer_.extract_continuous_segments();
-		// 将提取到的数据写入文件
-		for (const auto& data : segments) {
-			out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
-			bytes_written_ += data.size();
-		}
+		// 滑动窗口：越过从期望序号开始的连续段，推进窗口左边界
+		bytes_written_ += buffer_.advance();
 
 		// 发送ACK+SACK
-		send_ack();
+		queue_ack();
 	}
 
 	/**
@@ -322,8 +375,7 @@ namespace rtp {
 	}
 
 	int ReliableReceiver::run() {
-		WSADATA wsa;  // WSA 2.2 版本
-		if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+		if (!init_sockets()) {
 			cerr << "WSAStartup failed" << endl;
 			return -1;
 		}
@@ -344,6 +396,10 @@ namespace rtp {
 			cerr << "Bind failed" << endl;
 			return 1;
 		}
+		if (!loop_.open(sock_)) {
+			cerr << "Failed to create event loop" << endl;
+			return 1;
+		}
 
 		// 执行三次握手
 		if (!do_handshake()) {
@@ -351,23 +407,48 @@ namespace rtp {
 			return 1;
 		}
 		cout << "Connection established with " << addr_to_string(client_) << endl;
+		if (offload_) {
+			// 握手完成后再开启：合并到达的数据段一次读出，成批的等长ACK经 GSO 发出
+			bool gro = recv_batch_.enable_gro(sock_);
+			bool gso = ack_batch_.enable_gso(sock_);
+			cout << "[DEBUG] UDP offload - GRO: " << (gro ? "on" : "off") << ", GSO: " << (gso ? "on" : "off") << endl;
+		}
 
-		// 打开输出文件
-		ofstream out(output_path_, std::ios::binary);
-		if (!out) {
+		// 打开输出文件，已知大小时一次预分配
+		if (!output_.open(output_path_)) {
 			cerr << "Cannot open output file" << endl;
 			return 1;
 		}
+		if (size_known_ && !output_.preallocate(file_size_)) {
+			cerr << "[WARN] Failed to preallocate " << file_size_ << " bytes for output file" << endl;
+		}
 
 		cout << "[DEBUG] Starting data reception - Window size: " << window_size_ << endl;
 		// 记录开始时间
 		stats_.set_start_time(now_ms());
 
-		while (true) {
-			Packet p{};
-			sockaddr_in from{};
+		bool closing = false;  // 收到RST/FIN或判定sender断开
+		last_wnd_ = window_size_;
+		while (!closing) {
+			// 通告窗口因写盘而缩小时短间隔轮询：写盘线程腾出空间后立即发送窗口更新，发送端不必等待探测
+			bool window_limited = last_wnd_ < window_size_;
+			if (window_limited && advertised_window() > last_wnd_) {
+				send_ack();
+				continue;
+			}
+			if (reopen_pending_ && now_ms() >= reopen_retry_at_) {
+				// 重发次数用完后交给发送端的零窗口探测
+				reopen_pending_ = ++reopen_retries_ < MAX_WINDOW_UPDATE_RETRIES;
+				reopen_retry_at_ = now_ms() + WINDOW_UPDATE_RETRY_MS;
+				send_ack();
+				continue;
+			}
 			// 等待数据包，5000ms没有收到新的数据包则认为是超时，收到的是坏包也会继续等待
-			if (!wait_for_packet(p, from, DATA_TIMEOUT_MS)) {
+			int wait_ms = window_limited ? STORAGE_POLL_MS : reopen_pending_ ? WINDOW_UPDATE_RETRY_MS : DATA_TIMEOUT_MS;
+			if (!loop_.wait_for(wait_ms)) {
+				if (window_limited || reopen_pending_) {
+					continue;
+				}
 				// 连续超时检测
 				consecutive_timeouts_++;
 				if (consecutive_timeouts_ >= MAX_CONSECUTIVE_TIMEOUTS) {
@@ -379,29 +460,47 @@ namespace rtp {
 				}
 				continue;
 			}
-			consecutive_timeouts_ = 0;	// 收到包后重置计数
 
-			// 确认包来自已连接的客户端
-			if (!same_endpoint(from, client_)) {
-				continue;
-			}
+			// 一次读出已到达的全部数据包，逐个处理，ACK 在本批处理完后一起发送
+			size_t count = recv_batch_.receive(sock_);
+			for (size_t i = 0; i < count && !closing; ++i) {
+				PacketView p{};
+				// 检验校验和并将数据包解析到 p（负载指向接收缓冲），坏包直接丢弃
+				if (!parse_packet(recv_batch_.data(i), recv_batch_.size(i), p)) {
+					continue;
+				}
+				consecutive_timeouts_ = 0;	// 收到包后重置计数
 
-			// 处理RST段（sender强制断开）
-			if (p.header.flags & FLAG_RST) {
-				cerr << "[RST] Received RST from sender, connection reset" << endl;
-				break;
-			}
+				// 确认包来自已连接的客户端，且校验方式与协商结果一致
+				if (!same_endpoint(recv_batch_.from(i), client_) || (p.header.flags & FLAG_CRC) != integrity_) {
+					continue;
+				}
 
-			// 处理FIN包（连接关闭）
-			if (p.header.flags & FLAG_FIN) {
-				handle_fin(p.header.seq);
-				break;
-			}
+				// 处理RST段（sender强制断开）
+				if (p.header.flags & FLAG_RST) {
+					cerr << "[RST] Received RST from sender, connection reset" << endl;
+					closing = true;
+					break;
+				}
 
-			// 处理数据包
-			if (p.header.flags & FLAG_DATA) {
-				process_data_packet(p, out);
+				// 处理FIN包（连接关闭）：先发出已排队的ACK，保持与数据包的先后顺序
+				if (p.header.flags & FLAG_FIN) {
+					flush_acks();
+					handle_fin(p.header.seq);
+					closing = true;
+					break;
+				}
+
+				// 处理数据包
+				if (p.header.flags & FLAG_DATA) {
+					reopen_pending_ = false;
+					process_data_packet(p);
+				} else if (p.header.flags & FLAG_ACK) {
+					// 零窗口探测（只有ACK、不带数据）：回复当前窗口。窗口更新的ACK丢失时，发送端靠探测得知窗口已恢复
+					queue_ack();
+				}
 			}
+			flush_acks();
 		}
 
 		// 非FIN关闭连接，记录时间
@@ -409,6 +508,14 @@ namespace rtp {
 			stats_.set_end_time(now_ms());
 		}
 
+		// 等待写盘线程写完，文件截断到按序收齐的长度：传输中断时不保留预分配的空白和窗口内的乱序段
+		if (!output_.finish(bytes_written_)) {
+			cerr << "[WARN] Failed to write output file" << endl;
+		}
+		if (storage_drops_ > 0) {
+			cout << "[WARN] " << storage_drops_ << " packets dropped while the disk writer was behind" << endl;
+		}
+
 		// 打印统计信息
 		stats_.print_receiver_stats(bytes_written_, total_packets_received_, out_of_order_packets_, duplicate_packets_);
 
@@ -9,8 +9,9 @@ using namespace std;
 static constexpr uint16_t DEFAULT_WINDOW_SIZE = 32;
 
 static void usage(const char* prog) {
-	cout << "Usage: " << prog << " <listen_port> <output_file> [window_size]" << endl;
+	cout << "Usage: " << prog << " [--offload] <listen_port> <output_file> [window_size]" << endl;
 	cout << "  window_size: Optional. Defaults to " << DEFAULT_WINDOW_SIZE << endl;
+	cout << "  --offload: Optional. Use UDP GRO/GSO for the data path when the kernel supports it" << endl;
 }
 
 int main(int argc, char** argv) {
@@ -20,8 +21,16 @@ int main(int argc, char** argv) {
 		cerr << "Logger init failed: " << ex.what() << endl;
 	}
 
+	// 可选开关放在位置参数之前
+	const char* prog = argv[0];
+	bool offload = false;
+	if (argc >= 2 && string(argv[1]) == "--offload") {
+		offload = true;
+		--argc;
+		++argv;
+	}
 	if (argc < 3) {
-		usage(argv[0]);
+		usage(prog);
 		return 1;
 	}
 	uint16_t port = static_cast<uint16_t>(stoi(argv[1]));
@@ -32,5 +41,6 @@ int main(int argc, char** argv) {
 	}
 
 	ReliableReceiver receiver(port, out_path, window_size);
+	receiver.set_offload(offload);
 	return receiver.run();
 }
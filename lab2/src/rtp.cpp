@@ -1,9 +1,12 @@
 #include "rtp.h"
 
+#include <cstddef>
 #include <cstring>
 #include <iostream>
 #include <random>
 
+#include "checksum.h"
+
 namespace rtp {
 	using std::cerr;
 	using std::size_t;
@@ -32,27 +35,17 @@ namespace rtp {
 
 	// 校验和计算
 	uint16_t compute_checksum(const uint8_t* data, size_t len) {
-		uint32_t sum = 0;  // 32 位累加器
-		size_t i = 0;
-		while (i + 1 < len) {
-			// 16 位字加法
-			uint16_t word = static_cast<uint16_t>((data[i] << 8) | data[i + 1]);
-			sum += word;
-			// 处理溢出
-			sum = (sum & 0xFFFF) + (sum >> 16);
-			i += 2;
-		}
-		if (i < len) {
-			// 剩余一个字节，补0处理
-			uint16_t word = static_cast<uint16_t>(data[i] << 8);
-			sum += word;
-			sum = (sum & 0xFFFF) + (sum >> 16);
-		}
 		// 取反得到校验和
-		return static_cast<uint16_t>(~sum);
+		return static_cast<uint16_t>(~ones_complement_sum(0, data, len));
 	}
 
-	vector<uint8_t> serialize_packet(const PacketHeader& header, const vector<uint8_t>& payload) {
+	uint16_t compute_checksum(const uint8_t* head, size_t head_len, const uint8_t* data, size_t len) {
+		// head_len 为偶数时第二段的字边界与拼接后一致，分段累加结果相同
+		uint32_t sum = ones_complement_sum(0, head, head_len);
+		return static_cast<uint16_t>(~ones_complement_sum(sum, data, len));
+	}
+
+	size_t serialize_header(const PacketHeader& header, const uint8_t* payload, size_t payload_len, uint8_t* out) {
 		PacketHeader net = header;
 		// 转换为大端序
 		net.seq = htonl(header.seq);
@@ -63,29 +56,56 @@ namespace rtp {
 		net.sack_mask = htonl(header.sack_mask);
 		// 校验和字段置0以便计算校验和
 		net.checksum = 0;
-		vector<uint8_t> buffer(sizeof(PacketHeader) + payload.size());	// 分配缓冲区
-		memcpy(buffer.data(), &net, sizeof(PacketHeader));				// 复制头部
+		memcpy(out, &net, sizeof(PacketHeader));  // 复制头部
+
+		if (header.flags & FLAG_CRC) {
+			// CRC32C 覆盖包头（校验和字段为 0）与负载，以大端序写在包头之后
+			uint32_t crc = crc32c(crc32c(0, out, sizeof(PacketHeader)), payload, payload_len);
+			uint32_t crc_net = htonl(crc);
+			memcpy(out + sizeof(PacketHeader), &crc_net, sizeof(crc_net));
+			return CRC_TRAILER_SIZE;
+		}
+
+		// 计算包头与负载的校验和并填入头部
+		uint16_t cs = htons(compute_checksum(out, sizeof(PacketHeader), payload, payload_len));
+		memcpy(out + offsetof(PacketHeader, checksum), &cs, sizeof(cs));
+		return 0;
+	}
 
+	size_t serialize_packet(const PacketHeader& header, const uint8_t* payload, size_t payload_len, uint8_t* out) {
+		size_t trailer_len = serialize_header(header, payload, payload_len, out);
+		uint8_t trailer[CRC_TRAILER_SIZE];
+		memcpy(trailer, out + sizeof(PacketHeader), trailer_len);
 		// 如果有有效载荷，复制有效载荷
-		if (!payload.empty()) {
-			memcpy(buffer.data() + sizeof(PacketHeader), payload.data(), payload.size());
+		if (payload_len > 0) {
+			memcpy(out + sizeof(PacketHeader), payload, payload_len);
 		}
-		// 计算校验和并填入头部
-		uint16_t cs = compute_checksum(buffer.data(), buffer.size());
-		auto* hdr = reinterpret_cast<PacketHeader*>(buffer.data());
-		hdr->checksum = htons(cs);
-		return buffer;
+		// CRC 尾部放在负载之后
+		memcpy(out + sizeof(PacketHeader) + payload_len, trailer, trailer_len);
+		return sizeof(PacketHeader) + payload_len + trailer_len;
 	}
 
 	// 校验校验和
-	bool parse_packet(const uint8_t* data, size_t len, Packet& out) {
+	bool parse_packet(const uint8_t* data, size_t len, PacketView& out) {
 		if (len < sizeof(PacketHeader)) {
 			// 数据包长度小于头部长度，非法包
 			return false;
 		}
 		PacketHeader net{};
 		memcpy(&net, data, sizeof(PacketHeader));
-		if (compute_checksum(data, len) != 0) {
+		// 报文自带校验方式：FLAG_CRC 位被破坏时总长与长度字段对不上，下面的长度检查会拒绝
+		size_t trailer_len = (ntohs(net.flags) & FLAG_CRC) ? CRC_TRAILER_SIZE : 0;
+		if (trailer_len > 0) {
+			if (len < sizeof(PacketHeader) + trailer_len) {
+				return false;
+			}
+			uint32_t crc_net = 0;
+			memcpy(&crc_net, data + len - trailer_len, sizeof(crc_net));
+			if (crc32c(0, data, len - trailer_len) != ntohl(crc_net)) {
+				// CRC32C 不一致，校验失败
+				return false;
+			}
+		} else if (compute_checksum(data, len) != 0) {
 			// 计算的校验和不为0，校验失败
 			return false;
 		}
@@ -99,17 +119,40 @@ namespace rtp {
 		out.header.sack_mask = ntohl(net.sack_mask);
 		out.header.checksum = ntohs(net.checksum);
 
-		if (out.header.len + sizeof(PacketHeader) != len) {
+		if (out.header.len + sizeof(PacketHeader) + trailer_len != len) {
 			// 长度字段与实际长度不符，非法包
 			return false;
 		}
 
-		// 提取有效载荷
-		out.payload.clear();
-		if (out.header.len > 0) {
-			// 复制有效载荷数据
-			// 从data偏移 sizeof(PacketHeader)开始，到偏移len结束
-			out.payload.insert(out.payload.end(), data + sizeof(PacketHeader), data + len);
+		// 有效载荷从data偏移 sizeof(PacketHeader)开始，到偏移len结束
+		out.payload = data + sizeof(PacketHeader);
+		return true;
+	}
+
+	bool parse_packet(const uint8_t* data, size_t len, Packet& out) {
+		PacketView view{};
+		if (!parse_packet(data, len, view)) {
+			return false;
+		}
+		out.header = view.header;
+		// 复制有效载荷数据
+		out.payload.assign(view.payload, view.payload + view.header.len);
+		return true;
+	}
+
+	void encode_file_size(uint64_t size, uint8_t* out) {
+		for (size_t i = 0; i < SYN_PAYLOAD_LEN; ++i) {
+			out[i] = static_cast<uint8_t>(size >> (8 * (SYN_PAYLOAD_LEN - 1 - i)));
+		}
+	}
+
+	bool decode_file_size(const vector<uint8_t>& payload, uint64_t& size) {
+		if (payload.size() != SYN_PAYLOAD_LEN) {
+			return false;
+		}
+		size = 0;
+		for (uint8_t b : payload) {
+			size = (size << 8) | b;
 		}
 		return true;
 	}
@@ -133,6 +176,15 @@ namespace rtp {
 		return hash + counter;
 	}
 
+	bool init_sockets() {
+#ifdef _WIN32
+		WSADATA wsa;  // WSA 2.2 版本
+		return WSAStartup(MAKEWORD(2, 2), &wsa) == 0;
+#else
+		return true;
+#endif
+	}
+
 	uint64_t now_ms() {
 		using namespace std::chrono;
 		return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
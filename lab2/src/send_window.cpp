@@ -6,50 +6,65 @@
 namespace rtp {
 	using std::size_t;
 
-	SendWindow::SendWindow() : total_segments_(0), base_seq_(1), next_seq_(1) {}
+	SendWindow::SendWindow()
+		: ring_(RING_SIZE), total_segments_(0), base_seq_(1), next_seq_(1) {}
 
 	void SendWindow::initialize(uint64_t file_size_bytes) {
 		total_segments_ = static_cast<uint32_t>((file_size_bytes + MAX_PAYLOAD - 1) / MAX_PAYLOAD);
-		segments_.clear();
+		for (auto& slot : ring_) {
+			slot.used = false;
+		}
 		base_seq_ = 1;
 		next_seq_ = 1;
 	}
 
+	SendWindow::Slot* SendWindow::find(uint32_t seq) {
+		Slot& slot = ring_[seq % RING_SIZE];
+		return slot.used && slot.seq == seq ? &slot : nullptr;
+	}
+
 	void SendWindow::mark_acked(uint32_t seq) {
 		if (seq == 0 || seq > total_segments_) {
 			// 序号无效，忽略
 			return;
 		}
-		auto it = segments_.find(seq);
-		if (it == segments_.end()) {
+		Slot* slot = find(seq);
+		if (slot == nullptr) {
 			return;
 		}
-		auto& seg = it->second;
+		auto& seg = slot->info;
 		if (seg.acked) {
 			return;
 		}
 		seg.acked = true;
 		seg.last_sack_retx = 0;
-		seg.data.clear();
+		seg.size = 0;
 		seg.data_loaded = false;
 	}
 
 	SendWindow::SegmentInfo& SendWindow::get_segment(uint32_t seq) {
-		auto it = segments_.find(seq);
-		if (it != segments_.end()) {
-			return it->second;
+		Slot* found = find(seq);
+		if (found != nullptr) {
+			return found->info;
 		}
-		auto [ins_it, _] = segments_.emplace(seq, SegmentInfo{});
-		return ins_it->second;
+		// 占用该位置的旧段早已滑出窗口，重置为新段
+		Slot& slot = ring_[seq % RING_SIZE];
+		slot.seq = seq;
+		slot.used = true;
+		slot.info = SegmentInfo{};
+		return slot.info;
+	}
+
+	SendWindow::SegmentInfo* SendWindow::find_segment(uint32_t seq) {
+		Slot* slot = find(seq);
+		return slot != nullptr ? &slot->info : nullptr;
 	}
 
 	void SendWindow::set_base_seq(uint32_t seq) {
 		base_seq_ = seq;
-		for (auto it = segments_.begin(); it != segments_.end();) {
-			if (it->first < base_seq_) {
-				it = segments_.erase(it);
-			} else {
-				++it;
+		for (auto& slot : ring_) {
+			if (slot.used && slot.seq < base_seq_) {
+				slot.used = false;
 			}
 		}
 	}
@@ -69,14 +84,14 @@ namespace rtp {
 
 	void SendWindow::advance_base_seq() {
 		while (base_seq_ <= total_segments_) {
-			auto it = segments_.find(base_seq_);
-			if (it == segments_.end()) {
+			Slot* slot = find(base_seq_);
+			if (slot == nullptr) {
 				return;
 			}
-			if (!it->second.acked) {
+			if (!slot->info.acked) {
 				return;
 			}
-			segments_.erase(it);
+			slot->used = false;
 			++base_seq_;
 		}
 	}
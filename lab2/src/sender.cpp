@@ -3,7 +3,6 @@
 #include <algorithm>
 #include <cmath>
 #include <cstdio>
-#include <fstream>
 #include <iostream>
 
 namespace rtp {
@@ -29,6 +28,10 @@ namespace rtp {
 		constexpr int MAX_RETRANSMITS = 15;
 		// 全局无响应超时（30秒）
 		constexpr int GLOBAL_TIMEOUT_MS = 300000;
+		// 预读窗口：后台线程最多领先发送位置的字节数
+		constexpr uint64_t READAHEAD_BYTES = 8 << 20;
+		// 新数据段等待预读时的轮询间隔
+		constexpr int READAHEAD_POLL_MS = 1;
 	}  // namespace
 
 	ReliableSender::ReliableSender(string dest_ip, uint16_t dest_port, string file_path, uint16_t window_size,
@@ -52,31 +55,22 @@ namespace rtp {
 	}
 
 	bool ReliableSender::wait_for_packet(Packet& pkt, sockaddr_in& from, int timeout_ms) {
-		fd_set rfds;  // 声明读文件描述符集合
-		FD_ZERO(&rfds);
-		FD_SET(sock_, &rfds);
-		timeval tv{};  // 超时结构体
-		if (timeout_ms >= 0) {
-			tv.tv_sec = timeout_ms / 1000;
-			tv.tv_usec = (timeout_ms % 1000) * 1000;
-		}
 		// 等待数据可读或超时
-		int rv = select(0, &rfds, nullptr, nullptr, timeout_ms >= 0 ? &tv : nullptr);
-		if (rv <= 0) {
-			// 超时或出错
-			return false;
-		}
+		return loop_.wait_for(timeout_ms) && receive_packet(pkt, from);
+	}
+
+	bool ReliableSender::receive_packet(Packet& pkt, sockaddr_in& from) {
 		sockaddr_in peer{};	 // 发送方地址
 		socklen_t len = sizeof(peer);
-		vector<uint8_t> buf(2048);
-		int n = recvfrom(sock_, reinterpret_cast<char*>(buf.data()), static_cast<int>(buf.size()), 0,
+		uint8_t buf[MAX_DATAGRAM];
+		int n = recvfrom(sock_, reinterpret_cast<char*>(buf), static_cast<int>(sizeof(buf)), 0,
 						 reinterpret_cast<sockaddr*>(&peer), &len);
 		if (n <= 0) {
 			// 接收失败
 			return false;
 		}
 		// 检验校验和并	将数据包解析到 pkt
-		if (!parse_packet(buf.data(), static_cast<size_t>(n), pkt)) {
+		if (!parse_packet(buf, static_cast<size_t>(n), pkt)) {
 			return false;
 		}
 		// 返回发送方地址
@@ -84,13 +78,31 @@ namespace rtp {
 		return true;
 	}
 
-	int ReliableSender::send_raw(const PacketHeader& hdr, const vector<uint8_t>& payload) {
-		// 序列化并发送数据包
-		auto buffer = serialize_packet(hdr, payload);
-		return sendto(sock_, reinterpret_cast<const char*>(buffer.data()), static_cast<int>(buffer.size()), 0,
+	int ReliableSender::send_raw(const PacketHeader& hdr, const uint8_t* payload, size_t payload_len) {
+		// 按协商的校验方式序列化到栈上缓冲并发送数据包
+		PacketHeader out = hdr;
+		out.flags |= integrity_;
+		uint8_t buffer[MAX_PACKET];
+		size_t n = serialize_packet(out, payload, payload_len, buffer);
+		return sendto(sock_, reinterpret_cast<const char*>(buffer), static_cast<int>(n), 0,
 					  reinterpret_cast<const sockaddr*>(&remote_), sizeof(remote_));
 	}
 
+	void ReliableSender::queue_raw(const PacketHeader& hdr, const uint8_t* payload, size_t payload_len) {
+		PacketHeader out = hdr;
+		out.flags |= integrity_;
+		send_batch_.push(out, payload, payload_len);
+		if (send_batch_.full()) {
+			flush_sends();
+		}
+	}
+
+	void ReliableSender::flush_sends() {
+		if (!send_batch_.empty()) {
+			send_batch_.flush(sock_, remote_);
+		}
+	}
+
 	/**
 	 * 发送RST段，强制终止连接
 	 * 用于握手失败、校验错误、状态异常等场景
@@ -105,7 +117,7 @@ namespace rtp {
 		rst.len = 0;
 		rst.sack_mask = 0;
 		// 发送RST包
-		send_raw(rst, {});
+		send_raw(rst);
 		cout << "[RST] Sent RST segment to reset connection" << endl;
 	}
 
@@ -120,14 +132,16 @@ namespace rtp {
 		syn.seq = isn_;
 		syn.ack = 0;
 		syn.wnd = window_size_;
-		syn.len = 0;
+		syn.len = static_cast<uint16_t>(SYN_PAYLOAD_LEN);  // 负载为文件大小，接收端据此预分配输出文件
 		syn.flags = FLAG_SYN;
 		syn.sack_mask = 0;
+		uint8_t size_buf[SYN_PAYLOAD_LEN];
+		encode_file_size(file_size_, size_buf);
 
 		// 主动发送SYN包，等待SYN+ACK响应，最多5次重试
 		for (int attempt = 0; attempt < MAX_HANDSHAKE_RETRIES; ++attempt) {
 			cout << "[DEBUG] Sending SYN (attempt " << (attempt + 1) << "/" << MAX_HANDSHAKE_RETRIES << ")" << endl;
-			send_raw(syn, {});	// 发送SYN包
+			send_raw(syn, size_buf, sizeof(size_buf));	// 发送SYN包
 			Packet pkt{};
 			sockaddr_in from{};
 
@@ -153,7 +167,10 @@ namespace rtp {
 				// 记录对端ISN和窗口大小
 				peer_isn_ = pkt.header.seq;
 				peer_wnd_ = pkt.header.wnd;
-				cout << "[DEBUG] Received SYN+ACK, peer window size: " << peer_wnd_ << endl;
+				// SYN 以 CRC32C 发出时，接收端以同样方式回复即表示同意，否则退回反码校验和
+				integrity_ = pkt.header.flags & FLAG_CRC;
+				cout << "[DEBUG] Received SYN+ACK, peer window size: " << peer_wnd_
+					 << ", integrity: " << (integrity_ ? "crc32c" : "checksum") << endl;
 				// 发送ACK包完成握手
 				PacketHeader ack{};
 				ack.seq = isn_ + 1;
@@ -162,7 +179,7 @@ namespace rtp {
 				ack.wnd = window_size_;
 				ack.len = 0;
 				ack.sack_mask = 0;
-				send_raw(ack, {});
+				send_raw(ack);
 				cout << "[DEBUG] Handshake completed successfully" << endl;
 				return true;
 			}
@@ -182,11 +199,9 @@ namespace rtp {
 		// 获取段信息
 		auto& seg = window_.get_segment(seq);
 		if (!seg.data_loaded) {
-			if (!load_segment_payload(seq, seg.data)) {
-				cerr << "[ERROR] Failed to read payload for seq=" << seq << endl;
-				send_rst();
-				return;
-			}
+			// 段数据直接指向输入文件映射，首次发送与重传都不读文件、不复制
+			seg.size = payload_len_for_seq(seq);
+			seg.data = segment_payload(seq);
 			seg.data_loaded = true;
 		}
 		bool is_retransmit = seg.sent;	// 已发送过则为重传
@@ -213,7 +228,7 @@ namespace rtp {
 		hdr.ack = 0;			// 单向发送，无需ACK
 		hdr.flags = FLAG_DATA;	// 数据段
 		hdr.wnd = window_size_;
-		hdr.len = static_cast<uint16_t>(seg.data.size());
+		hdr.len = static_cast<uint16_t>(seg.size);
 		hdr.sack_mask = 0;
 
 		// 记录第一个数据包发送时间，作为全局的传输开始时间
@@ -221,8 +236,8 @@ namespace rtp {
 			stats_.set_start_time(now_ms());
 		}
 
-		// 发送数据包
-		send_raw(hdr, seg.data);
+		// 放入发送批次，进入等待前统一发出；负载留在文件映射中，由内核从原处聚集发送
+		queue_raw(hdr, seg.data, seg.size);
 		seg.sent = true;  // 标记为已发送
 		seg.last_send = now_ms();
 
@@ -237,8 +252,9 @@ namespace rtp {
 		if (seq == 0 || seq > window_.total_segments()) {
 			return;
 		}
-		auto& seg = window_.get_segment(seq);
-		if (!seg.acked) {
+		// 只统计仍在环中的段：不在环中的段已确认滑出，按需新建会占用在途段的位置
+		auto* seg = window_.find_segment(seq);
+		if (seg != nullptr && !seg->acked) {
 			bytes_acked_ += payload_len_for_seq(seq);
 		}
 	}
@@ -254,21 +270,12 @@ namespace rtp {
 		return static_cast<size_t>(std::min<uint64_t>(MAX_PAYLOAD, file_size_ - offset));
 	}
 
-	bool ReliableSender::load_segment_payload(uint32_t seq, vector<uint8_t>& out) {
-		size_t len = payload_len_for_seq(seq);
-		out.assign(len, 0);
-		if (len == 0) {
-			return true;
+	const uint8_t* ReliableSender::segment_payload(uint32_t seq) const {
+		if (payload_len_for_seq(seq) == 0) {
+			return nullptr;
 		}
 		uint64_t offset = static_cast<uint64_t>(seq - 1) * static_cast<uint64_t>(MAX_PAYLOAD);
-
-		input_.clear();
-		input_.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
-		if (!input_) {
-			return false;
-		}
-		input_.read(reinterpret_cast<char*>(out.data()), static_cast<std::streamsize>(len));
-		return input_.gcount() == static_cast<std::streamsize>(len);
+		return input_.data() + offset;
 	}
 
 	void ReliableSender::report_progress(bool force) {
@@ -349,8 +356,7 @@ namespace rtp {
 		hdr.sack_mask = 0;
 		hdr.checksum = 0;
 
-		vector<uint8_t> empty_payload;
-		send_raw(hdr, empty_payload);
+		send_raw(hdr);
 		probe_seq_ = hdr.seq;
 		cout << "[探测] 发送窗口探测包 seq=" << hdr.seq << " backoff=" << persist_backoff_ << endl;
 	}
@@ -455,8 +461,12 @@ namespace rtp {
 				// 超出总段数，停止检查
 				break;
 			}
-			// 获取段信息
-			auto& seg = window_.get_segment(seq);
+			// 获取段信息：只看环中的段，不为缺口新建位置（新建会覆盖序号相差 64 的在途段）
+			auto* found = window_.find_segment(seq);
+			if (found == nullptr) {
+				continue;
+			}
+			auto& seg = *found;
 			if (seg.sent && !seg.acked && !(mask & (1u << i))) {
 				// 该段已发送但未确认，且不在SACK中 -> 缺口
 				uint64_t last_gap = seg.last_sack_retx ? seg.last_sack_retx : seg.last_send;  // 上次发送时间
@@ -473,7 +483,7 @@ namespace rtp {
 		}
 	}
 
-	void ReliableSender::handle_ack(const Packet& pkt) {
+	void ReliableSender::handle_ack(const PacketView& pkt) {
 		// 更新最后收到ACK的时间（用于全局超时检测）
 		last_ack_time_ = now_ms();
 		// 获取接收方窗口大小，拥塞控制时会更新min(对端窗口, 位宽)
@@ -504,6 +514,8 @@ namespace rtp {
 		}
 		// 转换为相对序号
 		uint32_t ack = ack_abs - isn_;
+		// 乱序到达的旧ACK（低于窗口左边界）：其SACK信息已过时，扫描范围也超出环能区分的序号
+		bool stale = ack < window_.get_base_seq();
 		if (ack > window_.get_base_seq()) {
 			// 新ACK，推进窗口
 			handle_new_ack(ack);
@@ -513,10 +525,14 @@ namespace rtp {
 		}
 
 		// 处理SACK掩码
-		handle_sack(ack, pkt.header.sack_mask);
+		if (!stale) {
+			handle_sack(ack, pkt.header.sack_mask);
+		}
 		// 现在窗口的位置应该是当前ack序号
 		// 滑动窗口：将窗口左边界推进到第一个未确认段
 		window_.advance_base_seq();
+		// 已确认的数据不会再发送，释放其映射页
+		input_.discard_before(static_cast<uint64_t>(window_.get_base_seq() - 1) * MAX_PAYLOAD);
 		report_progress();
 	}
 
@@ -578,9 +594,17 @@ namespace rtp {
 		// 计算实际窗口大小 = min(本地窗口, 对端窗口, floor(cwnd), SACK位宽)
 		size_t window_cap = window_.calculate_window_size(window_size_, peer_wnd_, congestion_.get_cwnd(), SACK_BITS);
 
-		// 连续发送新数据段，直到窗口满或无新数据
+		// 连续发送新数据段，直到窗口满、无新数据或数据尚未读入
+		waiting_for_disk_ = false;
 		while (window_.get_next_seq() <= window_.total_segments() &&
 			   window_.get_next_seq() < window_.get_base_seq() + window_cap) {
+			// 只发送预读线程已读入的数据，否则先回到主循环处理ACK，稍后再试
+			uint64_t offset = static_cast<uint64_t>(window_.get_next_seq() - 1) * MAX_PAYLOAD;
+			read_ahead_.consume(offset);
+			if (offset + payload_len_for_seq(window_.get_next_seq()) > read_ahead_.ready()) {
+				waiting_for_disk_ = true;
+				break;
+			}
 			// 获取下一个数据段并发送
 			auto& seg = window_.get_segment(window_.get_next_seq());  // 获得数据段信息
 			if (!seg.sent) {
@@ -617,7 +641,7 @@ namespace rtp {
 			fin.wnd = window_size_;
 			fin.len = 0;
 			fin.sack_mask = 0;
-			send_raw(fin, {});
+			send_raw(fin);
 			// 记录FIN发送状态
 			fin_sent_ = true;
 			fin_last_send_ = now;
@@ -635,7 +659,7 @@ namespace rtp {
 			fin.wnd = window_size_;
 			fin.len = 0;
 			fin.sack_mask = 0;
-			send_raw(fin, {});
+			send_raw(fin);
 			// 更新重传状态
 			fin_last_send_ = now;
 			fin_retry_count_++;
@@ -652,23 +676,66 @@ namespace rtp {
 		final_ack.wnd = window_size_;
 		final_ack.len = 0;
 		final_ack.sack_mask = 0;
-		send_raw(final_ack, {});
+		send_raw(final_ack);
 
 		// 标记断开连接完成
 		fin_complete_ = true;
 		cout << "[DEBUG] Received FIN+ACK, sent final ACK, connection closed" << endl;
 	}
 
-	// 处理网络事件（接收ACK等）50ms超时
+	/**
+	 * 计算主循环的下一个截止时间
+	 * 取在途段的重传超时、持续计时器、FIN重传与全局无响应超时中最早的一个，
+	 * 判定条件与 handle_timeouts 等处一致（严格大于时才到期的加 1）
+	 */
+	uint64_t ReliableSender::next_deadline() {
+		if (!fin_sent_ && window_.all_acked()) {
+			// 数据已全部确认（或文件为空）而FIN尚未发出：不等待，本轮就发FIN
+			return now_ms();
+		}
+		uint64_t deadline = last_ack_time_ + GLOBAL_TIMEOUT_MS + 1;
+		// 仅扫描在途段：[base, next_seq)
+		uint32_t scan_end_exclusive = std::min(window_.get_next_seq(), window_.total_segments() + 1);
+		for (uint32_t i = window_.get_base_seq(); i < scan_end_exclusive; ++i) {
+			auto& seg = window_.get_segment(i);
+			if (seg.sent && !seg.acked) {
+				deadline = std::min<uint64_t>(deadline, seg.last_send + rto_ + 1);
+			}
+		}
+		if (zero_window_) {
+			deadline = std::min(deadline, persist_timer_);
+		}
+		if (fin_sent_ && !fin_complete_) {
+			deadline = std::min<uint64_t>(deadline, fin_last_send_ + HANDSHAKE_TIMEOUT_MS + 1);
+		}
+		if (waiting_for_disk_) {
+			deadline = std::min<uint64_t>(deadline, now_ms() + READAHEAD_POLL_MS);
+		}
+		return deadline;
+	}
+
+	// 处理网络事件（接收ACK等），直到收到数据包或最早的计时器到期
 	void ReliableSender::process_network() {
-		Packet pkt{};
-		sockaddr_in from{};
-		// 非阻塞接收数据包，等待50ms
-		if (wait_for_packet(pkt, from, 50)) {
-			// 一旦接收到数据，处理数据包
-			if (!same_endpoint(from, remote_)) {
+		// 本轮排队的数据段（新数据与重传）在睡眠前一次发出
+		flush_sends();
+		// 有数据包时立即返回，否则睡到下一个截止时间，不再固定间隔轮询
+		if (!loop_.wait_until(next_deadline())) {
+			return;
+		}
+		// 一次读出已到达的全部ACK，逐个处理
+		size_t count = recv_batch_.receive(sock_);
+		for (size_t i = 0; i < count; ++i) {
+			PacketView pkt{};
+			if (!parse_packet(recv_batch_.data(i), recv_batch_.size(i), pkt)) {
+				continue;
+			}
+			if (!same_endpoint(recv_batch_.from(i), remote_)) {
 				// 非预期地址，忽略
-				return;
+				continue;
+			}
+			if ((pkt.header.flags & FLAG_CRC) != integrity_) {
+				// 校验方式与协商结果不符，丢弃
+				continue;
 			}
 			if ((pkt.header.flags & FLAG_FIN) && (pkt.header.flags & FLAG_ACK)) {
 				// 处理FIN+ACK包，完成连接关闭
@@ -683,9 +750,7 @@ namespace rtp {
 	}
 
 	int ReliableSender::run() {
-		WSADATA wsa;  // WSA
-		// 2.2 版本
-		if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+		if (!init_sockets()) {
 			cerr << "WSAStartup failed" << endl;
 			return -1;
 		}
@@ -707,6 +772,10 @@ namespace rtp {
 			return 1;
 		}
 		cout << "[DEBUG] Bound to local port " << local_port_ << endl;
+		if (!loop_.open(sock_)) {
+			cerr << "Failed to create event loop" << endl;
+			return 1;
+		}
 
 		//	 设置要发送的目标地址
 		remote_.sin_addr.s_addr = inet_addr(dest_ip_.c_str());
@@ -718,26 +787,27 @@ namespace rtp {
 		// 生成初始序列号
 		isn_ = generate_isn(local_addr, remote_);
 
+		// 只读映射整个输入文件，段负载直接引用映射；握手前打开，以便在 SYN 中通告文件大小
+		if (!input_.open(file_path_)) {
+			cerr << "Cannot open input file" << endl;
+			return 1;
+		}
+		file_size_ = input_.size();
+		// 后台线程提前读入即将发送的数据，读盘不阻塞主循环（与握手同时进行）
+		read_ahead_.start(input_.data(), file_size_, READAHEAD_BYTES);
+
 		// 执行三次握手
 		if (!handshake()) {
 			// 握手失败，报错退出
 			cerr << "Handshake failed" << endl;
 			return 1;
 		}
-
-		input_.open(file_path_, std::ios::binary);
-		if (!input_) {
-			cerr << "Cannot open input file" << endl;
-			return 1;
+		if (offload_) {
+			// 握手完成后再开启：数据段经 GSO 成段发出，ACK 可能被 GRO 合并后一次读出
+			bool gso = send_batch_.enable_gso(sock_);
+			bool gro = recv_batch_.enable_gro(sock_);
+			cout << "[DEBUG] UDP offload - GSO: " << (gso ? "on" : "off") << ", GRO: " << (gro ? "on" : "off") << endl;
 		}
-		input_.seekg(0, std::ios::end);
-		std::streampos end_pos = input_.tellg();
-		if (end_pos < 0) {
-			cerr << "Failed to determine input file size" << endl;
-			return 1;
-		}
-		file_size_ = static_cast<uint64_t>(end_pos);
-		input_.seekg(0, std::ios::beg);
 
 		bytes_acked_ = 0;				  // 已确认字节数清零
 		last_progress_percent_ = -1;	  // 进度百分比初始化
@@ -781,7 +851,10 @@ namespace rtp {
 
 			// 记录数据传输时间点
 			if (!data_timing_recorded_ && window_.all_acked()) {
-				// 如果全部都确认，记录结束时间
+				// 如果全部都确认，记录结束时间（空文件没有发过数据段，起止时间相同）
+				if (stats_.get_start_time() == 0) {
+					stats_.set_start_time(now_ms());
+				}
 				stats_.set_end_time(now_ms());
 				data_timing_recorded_ = true;
 			}
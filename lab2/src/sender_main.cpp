@@ -7,8 +7,11 @@ using namespace rtp;
 using namespace std;
 // 显示用法信息
 static void usage(const char* prog) {
-	cout << "Usage: " << prog << " <receiver_ip> <receiver_port> <input_file> <window_size> [local_port]" << endl;
+	cout << "Usage: " << prog
+		 << " [--offload] [--crc32c] <receiver_ip> <receiver_port> <input_file> <window_size> [local_port]" << endl;
 	cout << "  local_port: Optional. Bind to specific local port (default: 9000)" << endl;
+	cout << "  --offload: Optional. Use UDP GSO/GRO for the data path when the kernel supports it" << endl;
+	cout << "  --crc32c: Optional. Propose CRC32C instead of the 16-bit checksum for every packet" << endl;
 }
 
 static constexpr uint16_t DEFAULT_LOCAL_PORT = 9000;
@@ -19,8 +22,25 @@ int main(int argc, char** argv) {
 		std::cerr << "Logger init failed: " << ex.what() << std::endl;
 	}
 
+	// 可选开关放在位置参数之前
+	const char* prog = argv[0];
+	bool offload = false;
+	bool crc32c = false;
+	while (argc >= 2 && string(argv[1]).rfind("--", 0) == 0) {
+		string option = argv[1];
+		if (option == "--offload") {
+			offload = true;
+		} else if (option == "--crc32c") {
+			crc32c = true;
+		} else {
+			usage(prog);
+			return 1;
+		}
+		--argc;
+		++argv;
+	}
 	if (argc < 5) {
-		usage(argv[0]);
+		usage(prog);
 		return 1;
 	}
 	string ip = argv[1];
@@ -34,5 +54,7 @@ int main(int argc, char** argv) {
 
 	// 创建并运行发送器
 	ReliableSender sender(ip, port, file_path, window_size, local_port);
+	sender.set_offload(offload);
+	sender.set_crc32c(crc32c);
 	return sender.run();
 }